@@ -0,0 +1,37 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <CFile.hpp>
+#include <MemoryInputStream.hpp>
+#include <OutputArchive.hpp>
+
+#include "ImageFixtures.hpp"
+
+
+namespace {
+
+constexpr unsigned short TAR_FILE_PERMISSIONS = 0644;
+
+void BM_OutputArchiveAddFile(benchmark::State & state)
+{
+    auto const file_size = static_cast<std::size_t>(state.range(0));
+    std::vector<std::byte> const contents(file_size, std::byte {0x5a});
+
+    TemporaryFile const output("littlefs-bench.tar", 0);
+
+    // NOLINTNEXTLINE(hicpp-signed-bitwise): There are unsigned literals
+    OutputArchive archive(CFile(output.path(), "wb"), ARCHIVE_FORMAT_TAR_PAX_RESTRICTED);
+    for (auto _ : state)
+    {
+        MemoryInputStream stream(contents);
+        archive.add_file("file", stream, TAR_FILE_PERMISSIONS);
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(file_size));
+}
+BENCHMARK(BM_OutputArchiveAddFile)->Arg(4 * 1024)->Arg(64 * 1024)->Arg(1024 * 1024);
+
+}  // namespace
@@ -0,0 +1,90 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <FileBlockDevice.hpp>
+
+#include "ImageFixtures.hpp"
+
+
+namespace {
+
+constexpr std::uint64_t IMAGE_SIZE =
+    static_cast<std::uint64_t>(BENCH_BLOCK_SIZE) * BENCH_BLOCK_COUNT;
+
+// Walks the device sequentially in steps of `size`, wrapping around at the end
+class Cursor
+{
+private:
+    std::uint32_t _size;
+    std::uint32_t _block;
+    std::uint32_t _offset;
+
+public:
+    explicit Cursor(std::uint32_t const size) : _size(size), _block(0), _offset(0)
+    {
+    }
+
+    [[nodiscard]] std::uint32_t block() const noexcept
+    {
+        return _block;
+    }
+
+    [[nodiscard]] std::uint32_t offset() const noexcept
+    {
+        return _offset;
+    }
+
+    void advance() noexcept
+    {
+        _offset += _size;
+        if (_offset + _size > BENCH_BLOCK_SIZE)
+        {
+            _offset = 0;
+            _block = (_block + 1) % BENCH_BLOCK_COUNT;
+        }
+    }
+};
+
+void BM_FileBlockDeviceRead(benchmark::State & state)
+{
+    auto const size = static_cast<std::uint32_t>(state.range(0));
+
+    TemporaryFile const image("littlefs-bench-read.img", IMAGE_SIZE);
+    FileBlockDevice device(image.path(), false, BENCH_BLOCK_SIZE, BENCH_BLOCK_COUNT);
+
+    std::vector<std::byte> buffer(size);
+    Cursor cursor(size);
+    for (auto _ : state)
+    {
+        device.read(cursor.block(), cursor.offset(), buffer.data(), size);
+        cursor.advance();
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(size));
+}
+BENCHMARK(BM_FileBlockDeviceRead)->RangeMultiplier(4)->Range(16, BENCH_BLOCK_SIZE);
+
+void BM_FileBlockDeviceProgram(benchmark::State & state)
+{
+    auto const size = static_cast<std::uint32_t>(state.range(0));
+
+    TemporaryFile const image("littlefs-bench-program.img", IMAGE_SIZE);
+    FileBlockDevice device(image.path(), true, BENCH_BLOCK_SIZE, BENCH_BLOCK_COUNT);
+
+    std::vector<std::byte> const buffer(size, std::byte {0x5a});
+    Cursor cursor(size);
+    for (auto _ : state)
+    {
+        device.program(cursor.block(), cursor.offset(), buffer.data(), size);
+        cursor.advance();
+    }
+    device.sync();
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(size));
+}
+BENCHMARK(BM_FileBlockDeviceProgram)->RangeMultiplier(4)->Range(16, BENCH_BLOCK_SIZE);
+
+}  // namespace
@@ -0,0 +1,91 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <LittleFS1.hpp>
+#include <LittleFS2.hpp>
+
+#include "ImageFixtures.hpp"
+
+
+namespace {
+
+// 6 x 6 x 6 directories with 8 small files each
+constexpr TreeShape WALK_TREE {3, 6, 8, 64};
+
+template <typename FS>
+void BM_Mount(benchmark::State & state)
+{
+    auto const image = make_image<FS>(WALK_TREE);
+
+    for (auto _ : state)
+    {
+        auto const filesystem = mount_view<FS>(*image);
+        benchmark::DoNotOptimize(filesystem.get());
+    }
+}
+BENCHMARK_TEMPLATE(BM_Mount, LittleFS1);
+BENCHMARK_TEMPLATE(BM_Mount, LittleFS2);
+
+template <typename FS>
+void BM_ListDirectory(benchmark::State & state)
+{
+    auto const entries = static_cast<std::uint32_t>(state.range(0));
+    auto const image = make_image<FS>({0, 0, entries, 16});
+    auto const filesystem = mount_view<FS>(*image);
+
+    for (auto _ : state)
+    {
+        auto const listing = filesystem->list_directory("/");
+        benchmark::DoNotOptimize(listing.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(entries));
+}
+BENCHMARK_TEMPLATE(BM_ListDirectory, LittleFS1)->Arg(16)->Arg(128)->Arg(512);
+BENCHMARK_TEMPLATE(BM_ListDirectory, LittleFS2)->Arg(16)->Arg(128)->Arg(512);
+
+template <typename FS>
+void BM_RecursiveDirlist(benchmark::State & state)
+{
+    auto const image = make_image<FS>(WALK_TREE);
+    auto const filesystem = mount_view<FS>(*image);
+
+    std::size_t files = 0;
+    for (auto _ : state)
+    {
+        auto const listing = filesystem->recursive_dirlist("/");
+        files = listing.size();
+        benchmark::DoNotOptimize(listing.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(files));
+}
+BENCHMARK_TEMPLATE(BM_RecursiveDirlist, LittleFS1)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RecursiveDirlist, LittleFS2)->Unit(benchmark::kMillisecond);
+
+template <typename FS>
+void BM_LittleFileRead(benchmark::State & state)
+{
+    auto const file_size = static_cast<std::uint32_t>(state.range(0));
+    auto const image = make_image<FS>({0, 0, 1, file_size});
+    auto const filesystem = mount_view<FS>(*image);
+
+    std::vector<std::byte> buffer(BENCH_BLOCK_SIZE);
+    for (auto _ : state)
+    {
+        auto const file = filesystem->open_file("/file_000000", LittleFS::OpenFlags::Read);
+        while (file->read(buffer) > 0)
+        {
+            benchmark::DoNotOptimize(buffer.data());
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(file_size));
+}
+BENCHMARK_TEMPLATE(BM_LittleFileRead, LittleFS1)->Arg(64 * 1024)->Arg(1024 * 1024);
+BENCHMARK_TEMPLATE(BM_LittleFileRead, LittleFS2)->Arg(64 * 1024)->Arg(1024 * 1024);
+
+}  // namespace
@@ -0,0 +1,75 @@
+#include "ImageFixtures.hpp"
+
+#include <cstddef>
+#include <fstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+
+namespace fs = boost::filesystem;
+
+
+namespace {
+
+void populate_directory(LittleFS & filesystem,
+                        std::string const & path,
+                        std::uint32_t const depth,
+                        TreeShape const & shape,
+                        std::vector<std::byte> const & contents)
+{
+    if (depth < shape.depth)
+    {
+        for (std::uint32_t index = 0; index < shape.fan_out; ++index)
+        {
+            auto const child = fmt::format("{}/directory_{:04}", path, index);
+            filesystem.make_directory(child);
+            populate_directory(filesystem, child, depth + 1, shape, contents);
+        }
+        return;
+    }
+
+    for (std::uint32_t index = 0; index < shape.files_per_directory; ++index)
+    {
+        auto const file = filesystem.open_file(
+            fmt::format("{}/file_{:06}", path, index),
+            LittleFS::OpenFlags::Write | LittleFS::OpenFlags::CreateIfNotExists
+                | LittleFS::OpenFlags::Truncate);
+        file->write(contents);
+    }
+}
+
+}  // namespace
+
+
+void populate(LittleFS & filesystem, TreeShape const & shape)
+{
+    std::vector<std::byte> contents(shape.file_size);
+    for (std::size_t index = 0; index < contents.size(); ++index)
+    {
+        contents[index] = static_cast<std::byte>(index * 31);
+    }
+
+    populate_directory(filesystem, "", 0, shape, contents);
+}
+
+TemporaryFile::TemporaryFile(std::string const & name, std::uint64_t const size) :
+    _path((fs::temp_directory_path() / fs::unique_path("%%%%%%%%-" + name)).string())
+{
+    std::ofstream file(_path, std::ios_base::binary | std::ios_base::trunc);
+    file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+
+    std::vector<char> const chunk(BENCH_BLOCK_SIZE);
+    for (std::uint64_t written = 0; written < size; written += chunk.size())
+    {
+        file.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+}
+
+TemporaryFile::~TemporaryFile()
+{
+    boost::system::error_code error {};
+    fs::remove(_path, error);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <BlockDeviceView.hpp>
+#include <LittleFS.hpp>
+#include <MemoryBlockDevice.hpp>
+
+
+constexpr std::uint32_t BENCH_BLOCK_SIZE = 4096;
+constexpr std::uint32_t BENCH_BLOCK_COUNT = 4096;
+constexpr std::uint32_t BENCH_READ_SIZE = 64;
+constexpr std::uint32_t BENCH_PROG_SIZE = 64;
+
+// Directories above `depth` hold `fan_out` subdirectories each; directories
+// at `depth` hold `files_per_directory` files of `file_size` bytes each.
+struct TreeShape
+{
+    std::uint32_t depth;
+    std::uint32_t fan_out;
+    std::uint32_t files_per_directory;
+    std::uint32_t file_size;
+};
+
+void populate(LittleFS & filesystem, TreeShape const & shape);
+
+// Mounts without taking ownership of the device
+template <typename FS>
+std::unique_ptr<LittleFS> mount_view(IBlockDevice & block_device)
+{
+    return std::make_unique<FS>(
+        std::make_unique<BlockDeviceView>(block_device), BENCH_READ_SIZE, BENCH_PROG_SIZE);
+}
+
+template <typename FS>
+std::unique_ptr<MemoryBlockDevice> make_image(TreeShape const & shape)
+{
+    auto image = std::make_unique<MemoryBlockDevice>(BENCH_BLOCK_SIZE, BENCH_BLOCK_COUNT);
+    FS::format(*image, BENCH_READ_SIZE, BENCH_PROG_SIZE);
+
+    auto const filesystem = mount_view<FS>(*image);
+    populate(*filesystem, shape);
+
+    return image;
+}
+
+// A scratch file in the system's temporary directory, named after `name` plus
+// a random prefix so that concurrent runs do not collide. It is removed on
+// destruction.
+class TemporaryFile final
+{
+private:
+    std::string _path;
+
+public:
+    TemporaryFile(std::string const & name, std::uint64_t size);
+    ~TemporaryFile();
+
+    TemporaryFile(TemporaryFile const &) = delete;
+    TemporaryFile & operator=(TemporaryFile const &) = delete;
+
+    [[nodiscard]] std::string const & path() const noexcept
+    {
+        return _path;
+    }
+};
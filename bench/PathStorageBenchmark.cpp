@@ -0,0 +1,89 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <FileTree.hpp>
+#include <LittleFS.hpp>
+
+#include "SyntheticLittleFS.hpp"
+
+
+namespace {
+
+// 10 x 10 x 10 directories with 1000 files each: one million files
+constexpr std::uint32_t TREE_DEPTH = 3;
+constexpr std::uint32_t TREE_FAN_OUT = 10;
+constexpr std::uint32_t FILES_PER_DIRECTORY = 1000;
+
+std::size_t memory_usage(std::vector<LittleFS::FileInfo> const & files)
+{
+    // Strings that don't fit the small buffer own a separate allocation
+    std::string const empty {};
+
+    auto total = files.capacity() * sizeof(LittleFS::FileInfo);
+    for (auto const & file : files)
+    {
+        if (file.path.capacity() > empty.capacity())
+        {
+            total += file.path.capacity() + 1;
+        }
+    }
+    return total;
+}
+
+void BM_RecursiveDirlist(benchmark::State & state)
+{
+    SyntheticLittleFS filesystem(TREE_DEPTH, TREE_FAN_OUT, FILES_PER_DIRECTORY);
+
+    std::size_t bytes = 0;
+    for (auto _ : state)
+    {
+        auto const files = filesystem.recursive_dirlist("/");
+        bytes = memory_usage(files);
+        benchmark::DoNotOptimize(files.data());
+    }
+
+    state.counters["files"] = static_cast<double>(filesystem.file_count());
+    state.counters["bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_RecursiveDirlist)->Unit(benchmark::kMillisecond);
+
+void BM_FileTree(benchmark::State & state)
+{
+    SyntheticLittleFS filesystem(TREE_DEPTH, TREE_FAN_OUT, FILES_PER_DIRECTORY);
+
+    std::size_t bytes = 0;
+    for (auto _ : state)
+    {
+        auto const tree = filesystem.file_tree("/");
+        bytes = tree.memory_usage();
+        benchmark::DoNotOptimize(tree.nodes().data());
+    }
+
+    state.counters["files"] = static_cast<double>(filesystem.file_count());
+    state.counters["bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_FileTree)->Unit(benchmark::kMillisecond);
+
+void BM_FileTreePaths(benchmark::State & state)
+{
+    SyntheticLittleFS filesystem(TREE_DEPTH, TREE_FAN_OUT, FILES_PER_DIRECTORY);
+    auto const tree = filesystem.file_tree("/");
+    auto const node_count = static_cast<std::uint32_t>(tree.nodes().size());
+
+    std::string path {};
+    for (auto _ : state)
+    {
+        for (std::uint32_t index = 0; index < node_count; ++index)
+        {
+            benchmark::DoNotOptimize(tree.path(index, path).data());
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * node_count);
+}
+BENCHMARK(BM_FileTreePaths)->Unit(benchmark::kMillisecond);
+
+}  // namespace
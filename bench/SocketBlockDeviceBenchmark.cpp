@@ -0,0 +1,113 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <BlockServer.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <SocketBlockDevice.hpp>
+
+#include "ImageFixtures.hpp"
+
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+namespace {
+
+constexpr char SOCKET_PATH[] = "littlefs-bench.sock";
+
+// Serves a memory device to a single client on a Unix socket, from a thread
+class LocalServer final
+{
+private:
+    MemoryBlockDevice _image;
+    boost::asio::io_context _context;
+    block_protocol::Acceptor _acceptor;
+    std::thread _thread;
+
+public:
+    LocalServer() :
+        _image(BENCH_BLOCK_SIZE, BENCH_BLOCK_COUNT),
+        _context(),
+        _acceptor(block_protocol::listen(_context, endpoint())),
+        _thread([this]() {
+            block_protocol::Socket socket(_context);
+            _acceptor.accept(socket);
+            serve_block_device(socket, _image, false);
+        })
+    {
+    }
+
+    ~LocalServer()
+    {
+        _thread.join();
+        std::remove(SOCKET_PATH);
+    }
+
+    LocalServer(LocalServer const &) = delete;
+    LocalServer & operator=(LocalServer const &) = delete;
+
+    static std::string endpoint()
+    {
+        return std::string("unix:") + SOCKET_PATH;
+    }
+};
+
+// Reads the device sequentially in littlefs-sized pieces, as a mount and
+// file read would. Argument 0 is the cache size in blocks.
+void BM_SocketBlockDeviceRead(benchmark::State & state)
+{
+    LocalServer server {};
+
+    SocketBlockDeviceOptions options {};
+    options.cache_blocks = static_cast<std::size_t>(state.range(0));
+    SocketBlockDevice device(LocalServer::endpoint(), options);
+
+    std::vector<std::byte> buffer(BENCH_READ_SIZE);
+    std::uint32_t block = 0;
+    std::uint32_t offset = 0;
+    for (auto _ : state)
+    {
+        device.read(block, offset, buffer.data(), BENCH_READ_SIZE);
+        offset += BENCH_READ_SIZE;
+        if (offset == BENCH_BLOCK_SIZE)
+        {
+            offset = 0;
+            block = (block + 1) % BENCH_BLOCK_COUNT;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(BENCH_READ_SIZE));
+}
+BENCHMARK(BM_SocketBlockDeviceRead)->Arg(0)->Arg(256);
+
+// Erases and programs whole blocks in prog-size pieces, which the device
+// merges and pipelines
+void BM_SocketBlockDeviceProgram(benchmark::State & state)
+{
+    LocalServer server {};
+    SocketBlockDevice device(LocalServer::endpoint());
+
+    std::vector<std::byte> const buffer(BENCH_PROG_SIZE, std::byte {0x5a});
+    std::uint32_t block = 0;
+    for (auto _ : state)
+    {
+        device.erase(block);
+        for (std::uint32_t offset = 0; offset < BENCH_BLOCK_SIZE; offset += BENCH_PROG_SIZE)
+        {
+            device.program(block, offset, buffer.data(), BENCH_PROG_SIZE);
+        }
+        block = (block + 1) % BENCH_BLOCK_COUNT;
+    }
+    device.sync();
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(BENCH_BLOCK_SIZE));
+}
+BENCHMARK(BM_SocketBlockDeviceProgram);
+
+}  // namespace
+
+#endif
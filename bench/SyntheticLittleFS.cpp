@@ -0,0 +1,74 @@
+#include "SyntheticLittleFS.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+
+SyntheticLittleFS::SyntheticLittleFS(std::uint32_t const depth,
+                                     std::uint32_t const directory_fan_out,
+                                     std::uint32_t const files_per_directory) :
+    _depth(depth),
+    _directory_fan_out(directory_fan_out),
+    _files_per_directory(files_per_directory)
+{
+}
+
+std::vector<LittleFS::DirectoryEntry> SyntheticLittleFS::list_directory(std::string const & path)
+{
+    auto const depth = static_cast<std::uint32_t>(std::count(path.cbegin(), path.cend(), '/'));
+
+    std::vector<LittleFS::DirectoryEntry> output {{".", true, 0}, {"..", true, 0}};
+    if (depth < _depth)
+    {
+        for (std::uint32_t index = 0; index < _directory_fan_out; ++index)
+        {
+            output.push_back({fmt::format("directory_{:04}", index), true, 0});
+        }
+    }
+    else
+    {
+        for (std::uint32_t index = 0; index < _files_per_directory; ++index)
+        {
+            output.push_back({fmt::format("file_{:06}.bin", index), false, 4096 + index});
+        }
+    }
+
+    return output;
+}
+
+std::unique_ptr<LittleFile> SyntheticLittleFS::open_file(std::string const &, OpenFlags)
+{
+    throw std::logic_error("Synthetic files have no contents");
+}
+
+void SyntheticLittleFS::make_directory(std::string const &)
+{
+    throw std::logic_error("Synthetic filesystems are read-only");
+}
+
+void SyntheticLittleFS::remove(std::string const &)
+{
+    throw std::logic_error("Synthetic filesystems are read-only");
+}
+
+void SyntheticLittleFS::traverse(std::function<void(std::uint32_t)> const &)
+{
+    throw std::logic_error("Synthetic filesystems have no blocks");
+}
+
+std::vector<std::uint32_t> SyntheticLittleFS::directory_blocks(std::string const &)
+{
+    throw std::logic_error("Synthetic filesystems have no blocks");
+}
+
+std::uint64_t SyntheticLittleFS::file_count() const noexcept
+{
+    std::uint64_t directories = 1;
+    for (std::uint32_t level = 0; level < _depth; ++level)
+    {
+        directories *= _directory_fan_out;
+    }
+    return directories * _files_per_directory;
+}
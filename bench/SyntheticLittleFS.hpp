@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <LittleFS.hpp>
+
+
+// A LittleFS that makes up a regular directory tree on the fly instead of
+// reading an image: every directory above `depth` holds `directory_fan_out`
+// subdirectories, and every directory at `depth` holds `files_per_directory`
+// files. Useful for exercising tree walks at sizes no real image would reach
+// in a reasonable time.
+class SyntheticLittleFS : public LittleFS
+{
+private:
+    std::uint32_t _depth;
+    std::uint32_t _directory_fan_out;
+    std::uint32_t _files_per_directory;
+
+public:
+    SyntheticLittleFS(std::uint32_t depth,
+                      std::uint32_t directory_fan_out,
+                      std::uint32_t files_per_directory);
+
+    std::vector<LittleFS::DirectoryEntry> list_directory(std::string const & path) override;
+    std::unique_ptr<LittleFile> open_file(std::string const & path, OpenFlags flags) override;
+    void make_directory(std::string const & path) override;
+    void remove(std::string const & path) override;
+    void traverse(std::function<void(std::uint32_t)> const & callback) override;
+    std::vector<std::uint32_t> directory_blocks(std::string const & path) override;
+
+    [[nodiscard]] std::uint64_t file_count() const noexcept;
+};
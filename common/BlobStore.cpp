@@ -0,0 +1,125 @@
+#include "BlobStore.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gsl/gsl>
+
+#include "CFile.hpp"
+
+#if defined(_MSC_VER)
+    #include "Unicode.hpp"
+#endif
+
+
+namespace fs = boost::filesystem;
+
+
+namespace {
+
+constexpr std::size_t COPY_BUFFER_SIZE = 1024 * 1024;
+
+fs::path to_path(std::string const & path)
+{
+#if defined(_MSC_VER)
+    return fs::path(utf8_to_wide_char(path));
+#else
+    return fs::path(path);
+#endif
+}
+
+}  // namespace
+
+
+BlobStore::BlobStore(std::string root) :
+    _root(std::move(root)), _mutex(), _settled(), _blobs()
+{
+    fs::create_directories(to_path(_root));
+}
+
+bool BlobStore::add(std::string const & digest, IInputStream & contents)
+{
+    if (digest.size() < 3)
+    {
+        throw std::invalid_argument("Digest too short for a blob name");
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _settled.wait(lock, [this, &digest]() {
+            auto const blob = _blobs.find(digest);
+            return _blobs.cend() == blob || blob->second;
+        });
+        if (!_blobs.emplace(digest, false).second)
+        {
+            return false;
+        }
+    }
+
+    auto const settle = [this, &digest](bool const stored) {
+        {
+            std::lock_guard<std::mutex> const lock(_mutex);
+            if (stored)
+            {
+                _blobs[digest] = true;
+            }
+            else
+            {
+                _blobs.erase(digest);
+            }
+        }
+        _settled.notify_all();
+    };
+
+    auto const blob_path = path(digest);
+    // Written aside and renamed, so that a blob is never seen half-written
+    auto const temporary_path = blob_path + fs::unique_path(".%%%%%%%%%%%%%%%%.tmp").string();
+    try
+    {
+        if (fs::exists(to_path(blob_path)))
+        {
+            settle(true);
+            return false;
+        }
+        fs::create_directories(to_path(blob_path).parent_path());
+
+        {
+            CFile file(temporary_path, "wb");
+            std::vector<std::byte> buffer(COPY_BUFFER_SIZE);
+            for (;;)
+            {
+                auto const count = contents.read(buffer);
+                if (0 == count)
+                {
+                    break;
+                }
+
+                auto const data =
+                    gsl::span<std::byte const>(buffer).first(static_cast<std::ptrdiff_t>(count));
+                if (file.write(data) != count)
+                {
+                    throw std::runtime_error("Failed writing blob");
+                }
+            }
+        }
+        fs::rename(to_path(temporary_path), to_path(blob_path));
+    }
+    catch (...)
+    {
+        boost::system::error_code ignored {};
+        fs::remove(to_path(temporary_path), ignored);
+        settle(false);
+        throw;
+    }
+
+    settle(true);
+    return true;
+}
+
+std::string BlobStore::path(std::string const & digest) const
+{
+    return _root + "/" + digest.substr(0, 2) + "/" + digest;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "IInputStream.hpp"
+
+
+// A directory of files named by the digest of their contents, so that each
+// distinct content is stored once however many images hold it. Blobs live
+// under a two-character fan-out directory, as in `ab/abcdef...`.
+//
+// One store may be shared by threads extracting different images.
+class BlobStore final
+{
+private:
+    std::string _root;
+    std::mutex _mutex;
+    std::condition_variable _settled;
+    // Digests in the store, or being written by this process: false until the
+    // blob is complete
+    std::unordered_map<std::string, bool> _blobs;
+
+public:
+    // Creates the directory if needed
+    explicit BlobStore(std::string root);
+
+    BlobStore(BlobStore const &) = delete;
+    BlobStore & operator=(BlobStore const &) = delete;
+
+    // Writes `contents` as the blob for `digest`, unless the store already has
+    // it. Returns whether anything was written. While another thread writes the
+    // same blob, waits for it to succeed, or to fail and leave the write to
+    // this call.
+    //
+    // Each write goes to a uniquely named temporary file first, so that
+    // processes sharing a store do not overwrite each other's.
+    bool add(std::string const & digest, IInputStream & contents);
+
+    [[nodiscard]] std::string path(std::string const & digest) const;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include <IBlockDevice.hpp>
+
+
+// Forwards every operation to a device owned by someone else, so that it can
+// be handed to a LittleFS while remaining usable after the LittleFS is gone.
+class BlockDeviceView : public IBlockDevice
+{
+private:
+    IBlockDevice & _block_device;
+
+public:
+    explicit BlockDeviceView(IBlockDevice & block_device) : _block_device(block_device)
+    {
+    }
+
+    void read(std::uint32_t block, std::uint32_t offset, void * buffer, std::uint32_t size) override
+    {
+        _block_device.read(block, offset, buffer, size);
+    }
+
+    void program(std::uint32_t block,
+                 std::uint32_t offset,
+                 void const * buffer,
+                 std::uint32_t size) override
+    {
+        _block_device.program(block, offset, buffer, size);
+    }
+
+    void erase(std::uint32_t block) override
+    {
+        _block_device.erase(block);
+    }
+
+    void sync() override
+    {
+        _block_device.sync();
+    }
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept override
+    {
+        return _block_device.block_size();
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept override
+    {
+        return _block_device.block_count();
+    }
+};
@@ -0,0 +1,55 @@
+#include "BlockHash.hpp"
+
+#include <algorithm>
+#include <future>
+
+#include <xxhash.h>
+
+#include "ThreadPool.hpp"
+
+
+namespace {
+
+// Hashing a block takes well under a microsecond, so tasks cover many blocks
+constexpr std::size_t MIN_CHUNK_BLOCKS = 256;
+constexpr std::size_t CHUNKS_PER_THREAD = 4;
+
+}  // namespace
+
+
+std::uint64_t block_hash(gsl::span<std::byte const> const block) noexcept
+{
+    return XXH3_64bits(block.data(), static_cast<std::size_t>(block.size()));
+}
+
+std::vector<std::uint64_t> hash_blocks(gsl::span<std::byte const> const image,
+                                       std::uint32_t const block_size,
+                                       unsigned const thread_count)
+{
+    auto const block_count = static_cast<std::size_t>(image.size()) / block_size;
+    std::vector<std::uint64_t> hashes(block_count);
+
+    ThreadPool pool(thread_count);
+    auto const chunk_size =
+        std::max(MIN_CHUNK_BLOCKS, block_count / (pool.size() * CHUNKS_PER_THREAD));
+
+    std::vector<std::future<void>> pending {};
+    for (std::size_t first = 0; first < block_count; first += chunk_size)
+    {
+        auto const last = std::min(block_count, first + chunk_size);
+        pending.push_back(pool.submit([&, first, last]() {
+            for (auto block = first; block < last; ++block)
+            {
+                auto const offset = static_cast<std::ptrdiff_t>(block * block_size);
+                hashes[block] = block_hash(image.subspan(offset, block_size));
+            }
+        }));
+    }
+
+    for (auto & future : pending)
+    {
+        future.get();
+    }
+
+    return hashes;
+}
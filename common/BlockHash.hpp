@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gsl/gsl>
+
+
+// XXH3 of a block's contents. Fast, but not meant to resist deliberate collisions.
+[[nodiscard]] std::uint64_t block_hash(gsl::span<std::byte const> block) noexcept;
+
+// Hashes every block of an in-memory image on a thread pool. A thread count of
+// 0 uses one thread per hardware thread.
+[[nodiscard]] std::vector<std::uint64_t>
+    hash_blocks(gsl::span<std::byte const> image, std::uint32_t block_size, unsigned thread_count);
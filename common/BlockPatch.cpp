@@ -0,0 +1,223 @@
+#include "BlockPatch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include "BlockHash.hpp"
+#include "CFile.hpp"
+#include "MappedFile.hpp"
+
+
+namespace {
+
+constexpr char PATCH_MAGIC[8] = {'L', 'F', 'S', 'P', 'A', 'T', 'C', 'H'};
+constexpr std::uint32_t PATCH_FORMAT_VERSION = 1;
+constexpr std::uint32_t PATCH_BYTE_ORDER = 0x01020304;
+
+constexpr std::byte ERASED_VALUE {0xff};
+
+bool is_erased(gsl::span<std::byte const> const block) noexcept
+{
+    return std::all_of(
+        block.cbegin(), block.cend(), [](std::byte const value) { return ERASED_VALUE == value; });
+}
+
+template <typename T>
+void write_array(CFile & file, gsl::span<T const> const values)
+{
+    if (file.write(values) != static_cast<std::size_t>(values.size()))
+    {
+        throw std::runtime_error("Failed writing block patch");
+    }
+}
+
+}  // namespace
+
+
+BlockPatch::BlockPatch(std::uint32_t const block_size, std::uint32_t const block_count) noexcept :
+    _block_size(block_size), _block_count(block_count), _records(), _data()
+{
+}
+
+BlockPatch BlockPatch::load(std::string const & path)
+{
+    MappedFile const mapping(path);
+    auto const data = mapping.data();
+
+    Header header {};
+    if (static_cast<std::size_t>(data.size()) < sizeof(header))
+    {
+        throw std::runtime_error("Not a block patch");
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (!std::equal(std::begin(PATCH_MAGIC), std::end(PATCH_MAGIC), std::begin(header.magic)))
+    {
+        throw std::runtime_error("Not a block patch");
+    }
+    if (header.format_version != PATCH_FORMAT_VERSION || header.byte_order != PATCH_BYTE_ORDER)
+    {
+        throw std::runtime_error("Unsupported block patch version");
+    }
+
+    auto const records_size = static_cast<std::size_t>(header.record_count) * sizeof(Record);
+    if (static_cast<std::size_t>(data.size()) != sizeof(header) + records_size + header.data_size)
+    {
+        throw std::runtime_error("Truncated block patch");
+    }
+
+    BlockPatch patch(header.block_size, header.block_count);
+    patch._records.resize(header.record_count);
+    std::memcpy(patch._records.data(), data.data() + sizeof(header), records_size);
+    auto const contents = data.subspan(static_cast<std::ptrdiff_t>(sizeof(header) + records_size));
+    patch._data.assign(contents.cbegin(), contents.cend());
+
+    std::uint64_t data_size = 0;
+    for (auto const & record : patch._records)
+    {
+        if (record.block >= patch._block_count || record.offset > patch._block_size
+            || record.size > patch._block_size - record.offset)
+        {
+            throw std::runtime_error("Corrupt block patch");
+        }
+        data_size += record.size;
+    }
+    if (data_size != header.data_size)
+    {
+        throw std::runtime_error("Corrupt block patch");
+    }
+
+    return patch;
+}
+
+void BlockPatch::save(std::string const & path) const
+{
+    Header header {};
+    std::copy(std::begin(PATCH_MAGIC), std::end(PATCH_MAGIC), std::begin(header.magic));
+    header.format_version = PATCH_FORMAT_VERSION;
+    header.byte_order = PATCH_BYTE_ORDER;
+    header.block_size = _block_size;
+    header.block_count = _block_count;
+    header.record_count = static_cast<std::uint32_t>(_records.size());
+    header.data_size = _data.size();
+
+    CFile file(path, "wb");
+    write_array(file, gsl::span<Header const>(&header, 1));
+    write_array(file, gsl::span<Record const>(_records));
+    write_array(file, gsl::span<std::byte const>(_data));
+}
+
+void BlockPatch::add(std::uint32_t const block,
+                     gsl::span<std::byte const> const base,
+                     std::uint64_t const base_hash,
+                     gsl::span<std::byte const> const result,
+                     std::uint64_t const result_hash)
+{
+    Record record {block, 0, 0, 0, base_hash, result_hash};
+
+    if (is_erased(result))
+    {
+        record.flags = FLAG_ERASED;
+    }
+    else
+    {
+        // littlefs mostly appends to metadata logs and rewrites whole data
+        // blocks, so the bytes that changed are usually one contiguous range
+        auto const first = std::mismatch(base.cbegin(), base.cend(), result.cbegin()).first;
+        if (first == base.cend())
+        {
+            throw std::logic_error("Block is unchanged");
+        }
+        auto const last = std::mismatch(std::make_reverse_iterator(base.cend()),
+                                        std::make_reverse_iterator(first),
+                                        std::make_reverse_iterator(result.cend()))
+                              .first.base();
+
+        auto const offset = first - base.cbegin();
+        auto const size = last - first;
+        record.offset = static_cast<std::uint32_t>(offset);
+        record.size = static_cast<std::uint32_t>(size);
+
+        auto const changed = result.subspan(offset, size);
+        _data.insert(_data.end(), changed.cbegin(), changed.cend());
+    }
+
+    _records.push_back(record);
+}
+
+BlockPatch::ApplyResult BlockPatch::apply(IBlockDevice & block_device) const
+{
+    if (block_device.block_size() != _block_size || block_device.block_count() != _block_count)
+    {
+        throw std::runtime_error("Device geometry does not match the patch");
+    }
+
+    std::vector<std::byte> buffer(_block_size);
+    auto const read_hash = [&](std::uint32_t const block) {
+        block_device.read(block, 0, buffer.data(), _block_size);
+        return block_hash(buffer);
+    };
+
+    std::vector<bool> pending(_records.size(), false);
+    for (std::size_t index = 0; index < _records.size(); ++index)
+    {
+        auto const & record = _records[index];
+        auto const hash = read_hash(record.block);
+        if (hash == record.base_hash)
+        {
+            pending[index] = true;
+        }
+        else if (hash != record.result_hash)
+        {
+            throw std::runtime_error(
+                fmt::format("Block {} matches neither the base nor the patched image",
+                            record.block));
+        }
+    }
+
+    ApplyResult result {};
+    std::size_t data_offset = 0;
+    for (std::size_t index = 0; index < _records.size(); ++index)
+    {
+        auto const & record = _records[index];
+        auto const data_size = record.size;
+        auto const data_position = data_offset;
+        data_offset += data_size;
+
+        if (!pending[index])
+        {
+            ++result.already_applied;
+            continue;
+        }
+
+        if (0 == (record.flags & FLAG_ERASED))
+        {
+            block_device.read(record.block, 0, buffer.data(), _block_size);
+            std::copy_n(_data.cbegin() + static_cast<std::ptrdiff_t>(data_position),
+                        data_size,
+                        buffer.begin() + record.offset);
+        }
+        else
+        {
+            // Devices differ in what an erased block reads as (FileBlockDevice
+            // erases to zeros), so the erased contents are programmed explicitly
+            std::fill(buffer.begin(), buffer.end(), ERASED_VALUE);
+        }
+
+        block_device.erase(record.block);
+        block_device.program(record.block, 0, buffer.data(), _block_size);
+        ++result.written;
+    }
+    block_device.sync();
+
+    return result;
+}
+
+std::uint64_t BlockPatch::size() const noexcept
+{
+    return sizeof(Header) + _records.size() * sizeof(Record) + _data.size();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+
+
+// The blocks that differ between two images of the same geometry, stored as
+// the changed byte range of each block. Every record carries the hash of the
+// block before and after the change, so applying a patch refuses to touch a
+// device that is not the base image, and re-applying an interrupted patch
+// only rewrites the blocks it had not reached.
+class BlockPatch
+{
+public:
+    struct Record
+    {
+        std::uint32_t block;
+        std::uint32_t flags;
+        // Range of the block replaced by the record's data
+        std::uint32_t offset;
+        std::uint32_t size;
+        std::uint64_t base_hash;
+        std::uint64_t result_hash;
+    };
+
+    // The block ends up erased and has no data
+    static constexpr std::uint32_t FLAG_ERASED = 1;
+
+    struct ApplyResult
+    {
+        std::uint32_t written {};
+        std::uint32_t already_applied {};
+    };
+
+private:
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t format_version;
+        std::uint32_t byte_order;
+        std::uint32_t block_size;
+        std::uint32_t block_count;
+        std::uint32_t record_count;
+        std::uint32_t reserved;
+        std::uint64_t data_size;
+    };
+
+    std::uint32_t _block_size;
+    std::uint32_t _block_count;
+    std::vector<Record> _records;
+    std::vector<std::byte> _data;
+
+public:
+    BlockPatch(std::uint32_t block_size, std::uint32_t block_count) noexcept;
+
+    // Throws if the file is not a patch written by this version of the format
+    static BlockPatch load(std::string const & path);
+
+    void save(std::string const & path) const;
+
+    // Records the change of `block` from `base` to `result`, which must differ.
+    void add(std::uint32_t block,
+             gsl::span<std::byte const> base,
+             std::uint64_t base_hash,
+             gsl::span<std::byte const> result,
+             std::uint64_t result_hash);
+
+    // Checks every block before writing any, then erases and reprograms the
+    // blocks still holding their base contents.
+    ApplyResult apply(IBlockDevice & block_device) const;
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept
+    {
+        return _block_size;
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept
+    {
+        return _block_count;
+    }
+
+    [[nodiscard]] gsl::span<Record const> records() const noexcept
+    {
+        return _records;
+    }
+
+    // Size of the patch file
+    [[nodiscard]] std::uint64_t size() const noexcept;
+};
@@ -0,0 +1,194 @@
+#include "BlockProtocol.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+
+namespace asio = boost::asio;
+
+using GenericEndpoint = asio::generic::stream_protocol::endpoint;
+
+
+namespace {
+
+constexpr char UNIX_PREFIX[] = "unix:";
+constexpr char TCP_PREFIX[] = "tcp:";
+
+void store_u32(gsl::span<std::byte> const data, std::uint32_t const value) noexcept
+{
+    for (std::ptrdiff_t index = 0; index < 4; ++index)
+    {
+        auto const shift = 8U * static_cast<unsigned>(index);
+        data[index] = static_cast<std::byte>((value >> shift) & 0xffU);
+    }
+}
+
+std::uint32_t load_u32(gsl::span<std::byte const> const data) noexcept
+{
+    std::uint32_t value = 0;
+    for (std::ptrdiff_t index = 0; index < 4; ++index)
+    {
+        value |= std::to_integer<std::uint32_t>(data[index]) << (8U * static_cast<unsigned>(index));
+    }
+    return value;
+}
+
+bool starts_with(std::string const & text, char const * prefix)
+{
+    return text.rfind(prefix, 0) == 0;
+}
+
+asio::ip::tcp::endpoint resolve_tcp(asio::io_context & context, std::string const & address)
+{
+    auto const separator = address.rfind(':');
+    if (separator == std::string::npos)
+    {
+        throw std::invalid_argument(fmt::format("Missing port in {}", address));
+    }
+
+    asio::ip::tcp::resolver resolver(context);
+    auto const results =
+        resolver.resolve(address.substr(0, separator), address.substr(separator + 1));
+    return results.begin()->endpoint();
+}
+
+}  // namespace
+
+
+namespace block_protocol {
+
+std::array<std::byte, REQUEST_SIZE> encode(Request const & request) noexcept
+{
+    std::array<std::byte, REQUEST_SIZE> data {};
+    gsl::span<std::byte> const span(data);
+
+    data[0] = static_cast<std::byte>(request.operation);
+    store_u32(span.subspan(4), request.block);
+    store_u32(span.subspan(8), request.offset);
+    store_u32(span.subspan(12), request.size);
+    return data;
+}
+
+std::array<std::byte, RESPONSE_SIZE> encode(Response const & response) noexcept
+{
+    std::array<std::byte, RESPONSE_SIZE> data {};
+    gsl::span<std::byte> const span(data);
+
+    store_u32(span, static_cast<std::uint32_t>(response.status));
+    store_u32(span.subspan(4), response.size);
+    return data;
+}
+
+std::array<std::byte, INFO_SIZE> encode(Info const & info) noexcept
+{
+    std::array<std::byte, INFO_SIZE> data {};
+    gsl::span<std::byte> const span(data);
+
+    store_u32(span, info.block_size);
+    store_u32(span.subspan(4), info.block_count);
+    return data;
+}
+
+Request decode_request(std::array<std::byte, REQUEST_SIZE> const & data)
+{
+    gsl::span<std::byte const> const span(data);
+
+    auto const operation = std::to_integer<std::uint8_t>(data[0]);
+    if (operation < static_cast<std::uint8_t>(Operation::Info)
+        || operation > static_cast<std::uint8_t>(Operation::Sync))
+    {
+        throw std::runtime_error(fmt::format("Unknown block protocol operation {}", operation));
+    }
+
+    return {static_cast<Operation>(operation),
+            load_u32(span.subspan(4)),
+            load_u32(span.subspan(8)),
+            load_u32(span.subspan(12))};
+}
+
+Response decode_response(std::array<std::byte, RESPONSE_SIZE> const & data)
+{
+    gsl::span<std::byte const> const span(data);
+    return {static_cast<Status>(load_u32(span)), load_u32(span.subspan(4))};
+}
+
+Info decode_info(std::array<std::byte, INFO_SIZE> const & data) noexcept
+{
+    gsl::span<std::byte const> const span(data);
+    return {load_u32(span), load_u32(span.subspan(4))};
+}
+
+char const * status_name(Status const status) noexcept
+{
+    switch (status)
+    {
+    case Status::Ok:
+        return "ok";
+    case Status::InvalidRequest:
+        return "invalid request";
+    case Status::OutOfRange:
+        return "out of range";
+    case Status::ReadOnly:
+        return "read-only device";
+    case Status::DeviceError:
+        return "device error";
+    }
+    return "unknown";
+}
+
+Socket connect(asio::io_context & context, std::string const & endpoint)
+{
+    Socket socket(context);
+
+    if (starts_with(endpoint, UNIX_PREFIX))
+    {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        socket.connect(GenericEndpoint(
+            asio::local::stream_protocol::endpoint(endpoint.substr(sizeof(UNIX_PREFIX) - 1))));
+#else
+        throw std::invalid_argument("Unix sockets are not supported on this platform");
+#endif
+    }
+    else if (starts_with(endpoint, TCP_PREFIX))
+    {
+        socket.connect(
+            GenericEndpoint(resolve_tcp(context, endpoint.substr(sizeof(TCP_PREFIX) - 1))));
+        // Requests are small and pipelined; there is nothing to gain by holding them back
+        socket.set_option(asio::ip::tcp::no_delay(true));
+    }
+    else
+    {
+        throw std::invalid_argument(
+            fmt::format("Invalid endpoint {}, expected unix:PATH or tcp:HOST:PORT", endpoint));
+    }
+
+    return socket;
+}
+
+Acceptor listen(asio::io_context & context, std::string const & endpoint)
+{
+    if (starts_with(endpoint, UNIX_PREFIX))
+    {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        auto const path = endpoint.substr(sizeof(UNIX_PREFIX) - 1);
+        std::remove(path.c_str());
+        return Acceptor(context, GenericEndpoint(asio::local::stream_protocol::endpoint(path)));
+#else
+        throw std::invalid_argument("Unix sockets are not supported on this platform");
+#endif
+    }
+    if (starts_with(endpoint, TCP_PREFIX))
+    {
+        return Acceptor(
+            context,
+            GenericEndpoint(resolve_tcp(context, endpoint.substr(sizeof(TCP_PREFIX) - 1))));
+    }
+
+    throw std::invalid_argument(
+        fmt::format("Invalid endpoint {}, expected unix:PATH or tcp:HOST:PORT", endpoint));
+}
+
+}  // namespace block_protocol
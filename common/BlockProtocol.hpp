@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <boost/asio.hpp>
+
+
+// Request/response protocol between SocketBlockDevice and a block server, over
+// a Unix or TCP stream socket. All integers are little-endian.
+//
+// A request is a 16-byte header, followed for Program by `size` bytes of data:
+//
+//     u8 operation, u8[3] reserved, u32 block, u32 offset, u32 size
+//
+// Read and Program cover `size` bytes from `offset` in `block`, and may run on
+// into the blocks that follow. Erase erases `size` blocks from `block`.
+//
+// Each request gets one response, in request order, so a client may send many
+// requests before reading any response. A response is an 8-byte header,
+// followed by `size` bytes of data for Read and Info:
+//
+//     i32 status, u32 size
+//
+// Info returns the geometry as u32 block size, u32 block count.
+namespace block_protocol {
+
+using Socket = boost::asio::generic::stream_protocol::socket;
+using Acceptor = boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol>;
+
+enum class Operation : std::uint8_t
+{
+    Info = 1,
+    Read = 2,
+    Program = 3,
+    Erase = 4,
+    Sync = 5,
+};
+
+enum class Status : std::int32_t
+{
+    Ok = 0,
+    InvalidRequest = 1,
+    OutOfRange = 2,
+    ReadOnly = 3,
+    DeviceError = 4,
+};
+
+struct Request
+{
+    Operation operation {};
+    std::uint32_t block {};
+    std::uint32_t offset {};
+    std::uint32_t size {};
+};
+
+struct Response
+{
+    Status status {};
+    std::uint32_t size {};
+};
+
+struct Info
+{
+    std::uint32_t block_size {};
+    std::uint32_t block_count {};
+};
+
+constexpr std::size_t REQUEST_SIZE = 16;
+constexpr std::size_t RESPONSE_SIZE = 8;
+constexpr std::size_t INFO_SIZE = 8;
+
+// Largest Read or Program a server accepts
+constexpr std::uint32_t MAX_TRANSFER_SIZE = 64 * 1024 * 1024;
+
+[[nodiscard]] std::array<std::byte, REQUEST_SIZE> encode(Request const & request) noexcept;
+[[nodiscard]] std::array<std::byte, RESPONSE_SIZE> encode(Response const & response) noexcept;
+[[nodiscard]] std::array<std::byte, INFO_SIZE> encode(Info const & info) noexcept;
+
+// Throws if the operation is unknown
+[[nodiscard]] Request decode_request(std::array<std::byte, REQUEST_SIZE> const & data);
+[[nodiscard]] Response decode_response(std::array<std::byte, RESPONSE_SIZE> const & data);
+[[nodiscard]] Info decode_info(std::array<std::byte, INFO_SIZE> const & data) noexcept;
+
+[[nodiscard]] char const * status_name(Status status) noexcept;
+
+// Endpoints are written "unix:PATH" or "tcp:HOST:PORT"
+[[nodiscard]] Socket connect(boost::asio::io_context & context, std::string const & endpoint);
+
+// For Unix sockets, replaces a stale socket file left at PATH
+[[nodiscard]] Acceptor listen(boost::asio::io_context & context, std::string const & endpoint);
+
+}  // namespace block_protocol
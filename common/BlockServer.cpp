@@ -0,0 +1,229 @@
+#include "BlockServer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+#include <gsl/gsl>
+
+
+namespace asio = boost::asio;
+using namespace block_protocol;
+
+
+namespace {
+
+// Responses are held back up to this size while more requests are waiting
+constexpr std::size_t MAX_PENDING_OUTPUT = 1024 * 1024;
+
+// Whether `request` stays within the device, for byte ranges
+bool in_range(IBlockDevice const & block_device, Request const & request) noexcept
+{
+    auto const device_size =
+        static_cast<std::uint64_t>(block_device.block_size()) * block_device.block_count();
+    auto const start =
+        static_cast<std::uint64_t>(request.block) * block_device.block_size() + request.offset;
+    return request.block < block_device.block_count() && start + request.size <= device_size;
+}
+
+// Calls `operation(block, offset, position, size)` for each block a byte range covers
+template <typename Operation>
+void for_each_block(IBlockDevice const & block_device,
+                    Request const & request,
+                    Operation const & operation)
+{
+    auto const block_size = block_device.block_size();
+    auto block = request.block + request.offset / block_size;
+    auto offset = request.offset % block_size;
+
+    std::uint32_t position = 0;
+    while (position < request.size)
+    {
+        auto const size = std::min(block_size - offset, request.size - position);
+        operation(block, offset, position, size);
+
+        position += size;
+        ++block;
+        offset = 0;
+    }
+}
+
+class Session
+{
+private:
+    Socket & _socket;
+    IBlockDevice & _block_device;
+    bool _read_only;
+    std::vector<std::byte> _data;
+    std::vector<std::byte> _output;
+
+public:
+    Session(Socket & socket, IBlockDevice & block_device, bool const read_only) :
+        _socket(socket), _block_device(block_device), _read_only(read_only), _data(), _output()
+    {
+    }
+
+    void run()
+    {
+        std::array<std::byte, REQUEST_SIZE> header {};
+        for (;;)
+        {
+            boost::system::error_code error {};
+            asio::read(_socket, asio::buffer(header), error);
+            if (error == asio::error::eof || error == asio::error::connection_reset)
+            {
+                break;
+            }
+            if (error)
+            {
+                throw boost::system::system_error(error);
+            }
+
+            handle(decode_request(header));
+
+            if (_output.size() >= MAX_PENDING_OUTPUT || 0 == _socket.available())
+            {
+                flush();
+            }
+        }
+        flush();
+    }
+
+private:
+    void flush()
+    {
+        if (!_output.empty())
+        {
+            asio::write(_socket, asio::buffer(_output));
+            _output.clear();
+        }
+    }
+
+    void respond(Status const status, gsl::span<std::byte const> const data = {})
+    {
+        auto const header = encode(Response {status, static_cast<std::uint32_t>(data.size())});
+        _output.insert(_output.end(), header.cbegin(), header.cend());
+        _output.insert(_output.end(), data.cbegin(), data.cend());
+    }
+
+    void handle(Request const & request)
+    {
+        if (Operation::Program == request.operation)
+        {
+            // The data has to be consumed even when the request is refused
+            if (request.size > MAX_TRANSFER_SIZE)
+            {
+                throw std::runtime_error("Program request too large");
+            }
+            _data.resize(request.size);
+            asio::read(_socket, asio::buffer(_data));
+        }
+
+        try
+        {
+            execute(request);
+        }
+        catch (std::exception const &)
+        {
+            respond(Status::DeviceError);
+        }
+    }
+
+    void execute(Request const & request)
+    {
+        switch (request.operation)
+        {
+        case Operation::Info:
+            respond(Status::Ok,
+                    encode(Info {_block_device.block_size(), _block_device.block_count()}));
+            return;
+
+        case Operation::Read:
+            if (request.size > MAX_TRANSFER_SIZE)
+            {
+                respond(Status::InvalidRequest);
+                return;
+            }
+            if (!in_range(_block_device, request))
+            {
+                respond(Status::OutOfRange);
+                return;
+            }
+
+            _data.resize(request.size);
+            for_each_block(_block_device, request, [this](auto... range) { read(range...); });
+            respond(Status::Ok, _data);
+            return;
+
+        case Operation::Program:
+            if (_read_only)
+            {
+                respond(Status::ReadOnly);
+                return;
+            }
+            if (!in_range(_block_device, request))
+            {
+                respond(Status::OutOfRange);
+                return;
+            }
+
+            for_each_block(_block_device, request, [this](auto... range) { program(range...); });
+            respond(Status::Ok);
+            return;
+
+        case Operation::Erase:
+            if (_read_only)
+            {
+                respond(Status::ReadOnly);
+                return;
+            }
+            if (request.block >= _block_device.block_count()
+                || request.size > _block_device.block_count() - request.block)
+            {
+                respond(Status::OutOfRange);
+                return;
+            }
+
+            for (std::uint32_t index = 0; index < request.size; ++index)
+            {
+                _block_device.erase(request.block + index);
+            }
+            respond(Status::Ok);
+            return;
+
+        case Operation::Sync:
+            _block_device.sync();
+            respond(Status::Ok);
+            return;
+        }
+
+        respond(Status::InvalidRequest);
+    }
+
+    void read(std::uint32_t const block,
+              std::uint32_t const offset,
+              std::uint32_t const position,
+              std::uint32_t const size)
+    {
+        _block_device.read(block, offset, _data.data() + position, size);
+    }
+
+    void program(std::uint32_t const block,
+                 std::uint32_t const offset,
+                 std::uint32_t const position,
+                 std::uint32_t const size)
+    {
+        _block_device.program(block, offset, _data.data() + position, size);
+    }
+};
+
+}  // namespace
+
+
+void serve_block_device(Socket & socket, IBlockDevice & block_device, bool const read_only)
+{
+    Session(socket, block_device, read_only).run();
+}
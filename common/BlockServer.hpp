@@ -0,0 +1,13 @@
+#pragma once
+
+#include <IBlockDevice.hpp>
+
+#include "BlockProtocol.hpp"
+
+
+// Answers block protocol requests from one client on `block_device`, until the
+// client disconnects. Responses are written in batches, whenever no further
+// request is already waiting, so that pipelined requests cost one write.
+void serve_block_device(block_protocol::Socket & socket,
+                        IBlockDevice & block_device,
+                        bool read_only);
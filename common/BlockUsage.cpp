@@ -0,0 +1,235 @@
+#include "BlockUsage.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include <gsl/gsl>
+
+#include <Ctz.hpp>
+#include <DiskFormat1.hpp>
+#include <DiskFormat2.hpp>
+
+
+namespace {
+
+std::uint32_t count_extents(std::vector<std::uint32_t> const & blocks) noexcept
+{
+    if (blocks.empty())
+    {
+        return 0;
+    }
+
+    std::uint32_t extents = 1;
+    for (std::size_t index = 1; index < blocks.size(); ++index)
+    {
+        if (blocks[index] != blocks[index - 1] + 1)
+        {
+            ++extents;
+        }
+    }
+    return extents;
+}
+
+// Bucket of the free-space histogram for a run, by power of two
+std::size_t run_bucket(std::uint32_t length) noexcept
+{
+    std::size_t bucket = 0;
+    while (length > 1)
+    {
+        length >>= 1U;
+        ++bucket;
+    }
+    return bucket;
+}
+
+class UsageBuilder
+{
+private:
+    LittleFS & _filesystem;
+    IBlockDevice & _block_device;
+    std::uint32_t _littlefs_version;
+    std::vector<std::byte> _buffer;
+    BlockUsage _usage;
+
+public:
+    UsageBuilder(LittleFS & filesystem,
+                 IBlockDevice & block_device,
+                 std::uint32_t const littlefs_version) :
+        _filesystem(filesystem),
+        _block_device(block_device),
+        _littlefs_version(littlefs_version),
+        _buffer(block_device.block_size()),
+        _usage()
+    {
+        _usage.owners.assign(block_device.block_count(), BlockOwner::Free);
+    }
+
+    BlockUsage build()
+    {
+        claim(0, BlockOwner::Superblock);
+        claim(1, BlockOwner::Superblock);
+
+        add_pairs("/", _filesystem.directory_blocks(""));
+
+        auto const tree = _filesystem.file_tree("/");
+        auto const nodes = tree.nodes();
+        std::string path {};
+        for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
+        {
+            tree.path(index, path);
+            if (0 != nodes[index].is_directory)
+            {
+                add_pairs(path, _filesystem.directory_blocks(path));
+            }
+            else
+            {
+                add_file(path);
+            }
+        }
+
+        auto & owners = _usage.owners;
+        _filesystem.traverse([&owners](std::uint32_t const block) {
+            if (block < owners.size() && BlockOwner::Free == owners[block])
+            {
+                owners[block] = BlockOwner::Orphan;
+            }
+        });
+
+        return std::move(_usage);
+    }
+
+private:
+    void claim(std::uint32_t const block, BlockOwner const owner) noexcept
+    {
+        if (block < _usage.owners.size() && BlockOwner::Free == _usage.owners[block])
+        {
+            _usage.owners[block] = owner;
+        }
+    }
+
+    MetadataLog read_log(std::uint32_t const block)
+    {
+        if (block >= _block_device.block_count())
+        {
+            return {};
+        }
+
+        _block_device.read(block, 0, _buffer.data(), _block_device.block_size());
+        return 1 == _littlefs_version ? read_metadata_log1(_buffer) : read_metadata_log2(_buffer);
+    }
+
+    void add_pairs(std::string const & path, std::vector<std::uint32_t> const & blocks)
+    {
+        for (std::size_t index = 0; index + 1 < blocks.size(); index += 2)
+        {
+            MetadataPairState state {path, {blocks[index], blocks[index + 1]}, {}};
+
+            auto const first = read_log(state.blocks[0]);
+            auto const second = read_log(state.blocks[1]);
+            auto const second_is_newer =
+                second.commits > 0
+                && (0 == first.commits
+                    || static_cast<std::int32_t>(second.revision - first.revision) > 0);
+            state.log = second_is_newer ? second : first;
+
+            claim(state.blocks[0], BlockOwner::Metadata);
+            claim(state.blocks[1], BlockOwner::Metadata);
+
+            _usage.pairs.push_back(std::move(state));
+        }
+    }
+
+    void add_file(std::string path)
+    {
+        auto const file = _filesystem.open_file(path, LittleFS::OpenFlags::Read);
+        auto const layout = file->layout();
+
+        FileFragmentation fragmentation {std::move(path), layout.size, 0, 0};
+        if (layout.is_inline)
+        {
+            _usage.inline_bytes += layout.size;
+        }
+        else
+        {
+            auto const blocks = ctz_blocks(_block_device, layout.head, layout.size);
+            for (auto const block : blocks)
+            {
+                claim(block, BlockOwner::Data);
+            }
+
+            fragmentation.blocks = static_cast<std::uint32_t>(blocks.size());
+            fragmentation.extents = count_extents(blocks);
+        }
+
+        _usage.files.push_back(std::move(fragmentation));
+    }
+};
+
+}  // namespace
+
+
+char const * block_owner_name(BlockOwner const owner) noexcept
+{
+    switch (owner)
+    {
+    case BlockOwner::Free:
+        return "free";
+    case BlockOwner::Superblock:
+        return "superblock";
+    case BlockOwner::Metadata:
+        return "metadata";
+    case BlockOwner::Data:
+        return "data";
+    case BlockOwner::Orphan:
+        return "orphan";
+    }
+    return "unknown";
+}
+
+BlockUsage analyze_block_usage(LittleFS & filesystem,
+                               IBlockDevice & block_device,
+                               std::uint32_t const littlefs_version)
+{
+    return UsageBuilder(filesystem, block_device, littlefs_version).build();
+}
+
+FreeSpace free_space(std::vector<BlockOwner> const & owners)
+{
+    FreeSpace result {};
+
+    std::uint32_t run = 0;
+    auto const end_run = [&result, &run]() {
+        if (0 == run)
+        {
+            return;
+        }
+
+        auto const bucket = run_bucket(run);
+        if (result.run_histogram.size() <= bucket)
+        {
+            result.run_histogram.resize(bucket + 1);
+        }
+        ++result.run_histogram[bucket];
+
+        ++result.runs;
+        result.largest_run = std::max(result.largest_run, run);
+        run = 0;
+    };
+
+    for (auto const owner : owners)
+    {
+        if (BlockOwner::Free == owner)
+        {
+            ++result.blocks;
+            ++run;
+        }
+        else
+        {
+            end_run();
+        }
+    }
+    end_run();
+
+    return result;
+}
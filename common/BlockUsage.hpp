@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <IBlockDevice.hpp>
+#include <LittleFS.hpp>
+#include <MetadataLog.hpp>
+
+
+enum class BlockOwner : std::uint8_t
+{
+    Free,
+    Superblock,
+    Metadata,
+    Data,
+    // In use according to littlefs, but not reachable from the root directory
+    Orphan,
+};
+
+// Short, stable name of an owner, as used in reports
+[[nodiscard]] char const * block_owner_name(BlockOwner owner) noexcept;
+
+struct FileFragmentation
+{
+    std::string path {};
+    std::uint32_t size {};
+    // Both are zero for inline files
+    std::uint32_t blocks {};
+    // Runs of consecutive, ascending blocks
+    std::uint32_t extents {};
+};
+
+struct MetadataPairState
+{
+    std::string path {};
+    std::array<std::uint32_t, 2> blocks {};
+    // The log of the block littlefs reads, which is the one with the newest revision
+    MetadataLog log {};
+};
+
+struct FreeSpace
+{
+    std::uint32_t blocks {};
+    std::uint32_t runs {};
+    std::uint32_t largest_run {};
+    // Number of runs of 1, 2-3, 4-7, ... blocks
+    std::vector<std::uint32_t> run_histogram {};
+};
+
+struct BlockUsage
+{
+    std::vector<BlockOwner> owners {};
+    std::vector<FileFragmentation> files {};
+    std::vector<MetadataPairState> pairs {};
+    std::uint64_t inline_bytes {};
+};
+
+// Builds the ownership map of every block of a mounted filesystem, along with
+// the extents of each file and the state of each directory's metadata log.
+// `block_device` must be the device the filesystem is mounted on.
+[[nodiscard]] BlockUsage analyze_block_usage(LittleFS & filesystem,
+                                             IBlockDevice & block_device,
+                                             std::uint32_t littlefs_version);
+
+[[nodiscard]] FreeSpace free_space(std::vector<BlockOwner> const & owners);
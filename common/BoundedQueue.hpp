@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+
+// A blocking queue of limited capacity between producer and consumer threads.
+// Closing it wakes every waiting thread: pushes are dropped from then on, and
+// pops drain what is left before returning nothing.
+template <typename T>
+class BoundedQueue final
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    std::deque<T> _items;
+    std::size_t _capacity;
+    bool _closed;
+
+public:
+    explicit BoundedQueue(std::size_t const capacity) :
+        _mutex(), _not_empty(), _not_full(), _items(), _capacity(capacity), _closed(false)
+    {
+    }
+
+    BoundedQueue(BoundedQueue const &) = delete;
+    BoundedQueue & operator=(BoundedQueue const &) = delete;
+
+    // Returns false if the queue was closed
+    bool push(T item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_full.wait(lock, [this]() { return _closed || _items.size() < _capacity; });
+            if (_closed)
+            {
+                return false;
+            }
+            _items.push_back(std::move(item));
+        }
+        _not_empty.notify_one();
+
+        return true;
+    }
+
+    std::optional<T> pop()
+    {
+        std::optional<T> item {};
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_empty.wait(lock, [this]() { return _closed || !_items.empty(); });
+            if (_items.empty())
+            {
+                return {};
+            }
+            item.emplace(std::move(_items.front()));
+            _items.pop_front();
+        }
+        _not_full.notify_one();
+
+        return item;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> const lock(_mutex);
+            _closed = true;
+        }
+        _not_empty.notify_all();
+        _not_full.notify_all();
+    }
+};
@@ -19,13 +19,19 @@ class CFile final
     template <typename T, typename = std::enable_if_t<std::is_trivially_copyable_v<T>>>
     std::size_t read(gsl::span<T> buffer) noexcept
     {
-        return std::fread(buffer.data(), sizeof(T), buffer.size(), _handle);
+        return std::fread(buffer.data(),
+                          sizeof(T),
+                          static_cast<std::size_t>(buffer.size()),
+                          _handle.get());
     }
 
     template <typename T, typename = std::enable_if_t<std::is_trivially_copyable_v<T>>>
     std::size_t write(gsl::span<T> buffer) noexcept
     {
-        return std::fwrite(buffer.data(), sizeof(T), buffer.size(), _handle);
+        return std::fwrite(buffer.data(),
+                           sizeof(T),
+                           static_cast<std::size_t>(buffer.size()),
+                           _handle.get());
     }
 
     [[nodiscard]] std::FILE * handle() const noexcept;
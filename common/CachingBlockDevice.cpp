@@ -0,0 +1,67 @@
+#include "CachingBlockDevice.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+
+CachingBlockDevice::CachingBlockDevice(std::unique_ptr<IBlockDevice> block_device) :
+    _block_device(std::move(block_device)),
+    _cache()
+{
+}
+
+void CachingBlockDevice::read(std::uint32_t block,
+                              std::uint32_t offset,
+                              void * buffer,
+                              std::uint32_t size)
+{
+    auto const cached = _cache.find(block);
+    if (cached == _cache.end())
+    {
+        _block_device->read(block, offset, buffer, size);
+        return;
+    }
+
+    if (offset + size > cached->second.size())
+    {
+        throw std::range_error("Invalid read range");
+    }
+
+    std::memcpy(buffer, cached->second.data() + offset, size);
+}
+
+void CachingBlockDevice::program(std::uint32_t block,
+                                 std::uint32_t offset,
+                                 void const * buffer,
+                                 std::uint32_t size)
+{
+    _cache.erase(block);
+    _block_device->program(block, offset, buffer, size);
+}
+
+void CachingBlockDevice::erase(std::uint32_t block)
+{
+    _cache.erase(block);
+    _block_device->erase(block);
+}
+
+void CachingBlockDevice::sync()
+{
+    _block_device->sync();
+}
+
+void CachingBlockDevice::insert(std::uint32_t block, gsl::span<std::byte const> contents)
+{
+    if (block >= block_count())
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    if (static_cast<std::size_t>(contents.size()) != block_size())
+    {
+        throw std::length_error("Cached contents must span a whole block");
+    }
+
+    _cache[block].assign(contents.begin(), contents.end());
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+
+
+// Serves reads of selected blocks from memory, forwarding everything else to
+// the wrapped device. Writes go through and drop the affected block from the cache.
+class CachingBlockDevice : public IBlockDevice
+{
+private:
+    std::unique_ptr<IBlockDevice> _block_device;
+    std::unordered_map<std::uint32_t, std::vector<std::byte>> _cache;
+
+public:
+    explicit CachingBlockDevice(std::unique_ptr<IBlockDevice> block_device);
+    ~CachingBlockDevice() override = default;
+
+    CachingBlockDevice(CachingBlockDevice const &) = delete;
+    CachingBlockDevice & operator=(CachingBlockDevice const &) = delete;
+
+    void
+        read(std::uint32_t block, std::uint32_t offset, void * buffer, std::uint32_t size) override;
+    void program(std::uint32_t block,
+                 std::uint32_t offset,
+                 void const * buffer,
+                 std::uint32_t size) override;
+    void erase(std::uint32_t block) override;
+    void sync() override;
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept override
+    {
+        return _block_device->block_size();
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept override
+    {
+        return _block_device->block_count();
+    }
+
+    void insert(std::uint32_t block, gsl::span<std::byte const> contents);
+
+    [[nodiscard]] std::size_t cached_blocks() const noexcept
+    {
+        return _cache.size();
+    }
+
+    [[nodiscard]] IBlockDevice & underlying() const noexcept
+    {
+        return *_block_device;
+    }
+};
@@ -0,0 +1,92 @@
+#include "CowBlockDevice.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "MemoryBlockDevice.hpp"
+
+
+CowBlockDevice::CowBlockDevice(gsl::span<std::byte const> const base,
+                               std::uint32_t const block_size) :
+    _base(base),
+    _block_size(block_size),
+    _block_count(static_cast<std::uint32_t>(static_cast<std::size_t>(base.size()) / block_size)),
+    _overlay()
+{
+    if (static_cast<std::size_t>(base.size()) % block_size != 0)
+    {
+        throw std::invalid_argument("Base image is not a whole number of blocks");
+    }
+}
+
+void CowBlockDevice::read(std::uint32_t block,
+                          std::uint32_t offset,
+                          void * buffer,
+                          std::uint32_t size)
+{
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid read range");
+    }
+
+    std::memcpy(buffer, this->block(block).data() + offset, size);
+}
+
+void CowBlockDevice::program(std::uint32_t block,
+                             std::uint32_t offset,
+                             void const * buffer,
+                             std::uint32_t size)
+{
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid write range");
+    }
+
+    std::memcpy(writable_block(block).data() + offset, buffer, size);
+}
+
+void CowBlockDevice::erase(std::uint32_t block)
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    // No need to copy what is about to be wiped
+    auto & contents = _overlay[block];
+    contents.assign(_block_size, MemoryBlockDevice::ERASED_VALUE);
+}
+
+void CowBlockDevice::sync()
+{
+}
+
+gsl::span<std::byte const> CowBlockDevice::block(std::uint32_t const block) const
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    auto const modified = _overlay.find(block);
+    if (_overlay.end() != modified)
+    {
+        return modified->second;
+    }
+
+    return _base.subspan(static_cast<std::ptrdiff_t>(block) * _block_size, _block_size);
+}
+
+std::vector<std::byte> & CowBlockDevice::writable_block(std::uint32_t const block)
+{
+    auto const modified = _overlay.find(block);
+    if (_overlay.end() != modified)
+    {
+        return modified->second;
+    }
+
+    auto const original = this->block(block);
+    return _overlay.emplace(block, std::vector<std::byte>(original.begin(), original.end()))
+        .first->second;
+}
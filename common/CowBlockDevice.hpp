@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+
+
+// A writable view of a read-only base image. A block is copied into a private
+// overlay the first time it is programmed or erased, so that any number of
+// devices, on any number of threads, can share one base.
+class CowBlockDevice : public IBlockDevice
+{
+private:
+    gsl::span<std::byte const> _base;
+    std::uint32_t _block_size;
+    std::uint32_t _block_count;
+    std::unordered_map<std::uint32_t, std::vector<std::byte>> _overlay;
+
+public:
+    // The base must outlive the device
+    CowBlockDevice(gsl::span<std::byte const> base, std::uint32_t block_size);
+    ~CowBlockDevice() override = default;
+
+    CowBlockDevice(CowBlockDevice const &) = delete;
+    CowBlockDevice & operator=(CowBlockDevice const &) = delete;
+
+    void
+        read(std::uint32_t block, std::uint32_t offset, void * buffer, std::uint32_t size) override;
+    void program(std::uint32_t block,
+                 std::uint32_t offset,
+                 void const * buffer,
+                 std::uint32_t size) override;
+    void erase(std::uint32_t block) override;
+    void sync() override;
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept override
+    {
+        return _block_size;
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept override
+    {
+        return _block_count;
+    }
+
+    // Current contents of a block, from the overlay or the base
+    [[nodiscard]] gsl::span<std::byte const> block(std::uint32_t block) const;
+
+    [[nodiscard]] std::size_t modified_blocks() const noexcept
+    {
+        return _overlay.size();
+    }
+
+private:
+    std::vector<std::byte> & writable_block(std::uint32_t block);
+};
@@ -0,0 +1,40 @@
+#include "CtzInputStream.hpp"
+
+#include <algorithm>
+
+#include <Ctz.hpp>
+
+
+CtzInputStream::CtzInputStream(IBlockDevice & block_device,
+                               std::uint32_t const head,
+                               std::uint32_t const size) :
+    _block_device(block_device),
+    _blocks(ctz_blocks(block_device, head, size)),
+    _size(size),
+    _position(0)
+{
+}
+
+std::size_t CtzInputStream::read(gsl::span<std::byte> buffer)
+{
+    auto const block_size = _block_device.block_size();
+
+    std::size_t total = 0;
+    while (total < static_cast<std::size_t>(buffer.size()) && _position < _size)
+    {
+        auto offset = _position;
+        auto const index = ctz_index(block_size, offset);
+
+        auto const chunk = static_cast<std::uint32_t>(
+            std::min<std::size_t>({static_cast<std::size_t>(buffer.size()) - total,
+                                   block_size - offset,
+                                   _size - _position}));
+
+        _block_device.read(_blocks.at(index), offset, buffer.data() + total, chunk);
+
+        total += chunk;
+        _position += chunk;
+    }
+
+    return total;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+
+#include "IInputStream.hpp"
+
+
+// Reads a file's contents straight from its CTZ skip-list, without going
+// through a mounted filesystem.
+class CtzInputStream : public IInputStream
+{
+private:
+    IBlockDevice & _block_device;
+    std::vector<std::uint32_t> _blocks;
+    std::uint32_t _size;
+    std::uint32_t _position;
+
+public:
+    CtzInputStream(IBlockDevice & block_device, std::uint32_t head, std::uint32_t size);
+
+    std::size_t read(gsl::span<std::byte> buffer) override;
+
+    [[nodiscard]] std::size_t remaining() const override
+    {
+        return _size - _position;
+    }
+};
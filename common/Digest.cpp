@@ -0,0 +1,103 @@
+#include "Digest.hpp"
+
+#include <new>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <xxhash.h>
+
+#include "Sha256.hpp"
+
+
+namespace {
+
+class Xxh3Digest final : public IDigest
+{
+private:
+    std::unique_ptr<XXH3_state_t, decltype(&XXH3_freeState)> _state;
+
+public:
+    Xxh3Digest() : _state(XXH3_createState(), &XXH3_freeState)
+    {
+        if (nullptr == _state)
+        {
+            throw std::bad_alloc();
+        }
+        XXH3_128bits_reset(_state.get());
+    }
+
+    void update(gsl::span<std::byte const> const data) override
+    {
+        XXH3_128bits_update(_state.get(), data.data(), static_cast<std::size_t>(data.size()));
+    }
+
+    std::string finish() override
+    {
+        auto const digest = XXH3_128bits_digest(_state.get());
+        return fmt::format("{:016x}{:016x}", digest.high64, digest.low64);
+    }
+};
+
+class Sha256Digest final : public IDigest
+{
+private:
+    Sha256 _sha256;
+
+public:
+    void update(gsl::span<std::byte const> const data) override
+    {
+        _sha256.update(data);
+    }
+
+    std::string finish() override
+    {
+        std::string output {};
+        output.reserve(2 * sizeof(Sha256::Digest));
+        for (auto const byte : _sha256.finish())
+        {
+            output += fmt::format("{:02x}", byte);
+        }
+        return output;
+    }
+};
+
+}  // namespace
+
+
+char const * digest_algorithm_name(DigestAlgorithm const algorithm) noexcept
+{
+    switch (algorithm)
+    {
+    case DigestAlgorithm::Xxh3:
+        return "xxh3";
+    case DigestAlgorithm::Sha256:
+        return "sha256";
+    }
+    return "unknown";
+}
+
+DigestAlgorithm parse_digest_algorithm(std::string const & name)
+{
+    for (auto const algorithm : {DigestAlgorithm::Xxh3, DigestAlgorithm::Sha256})
+    {
+        if (name == digest_algorithm_name(algorithm))
+        {
+            return algorithm;
+        }
+    }
+
+    throw std::invalid_argument(fmt::format("Unknown digest algorithm: {}", name));
+}
+
+std::unique_ptr<IDigest> create_digest(DigestAlgorithm const algorithm)
+{
+    switch (algorithm)
+    {
+    case DigestAlgorithm::Xxh3:
+        return std::make_unique<Xxh3Digest>();
+    case DigestAlgorithm::Sha256:
+        return std::make_unique<Sha256Digest>();
+    }
+
+    throw std::invalid_argument("Invalid digest algorithm");
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <gsl/gsl>
+
+
+enum class DigestAlgorithm
+{
+    // XXH3, 128 bits. Fast, but not meant to resist deliberate collisions.
+    Xxh3,
+    Sha256,
+};
+
+// Short, stable name of an algorithm, as used on the command line and in manifests
+[[nodiscard]] char const * digest_algorithm_name(DigestAlgorithm algorithm) noexcept;
+
+// Throws std::invalid_argument for unknown names
+[[nodiscard]] DigestAlgorithm parse_digest_algorithm(std::string const & name);
+
+class IDigest
+{
+public:
+    virtual ~IDigest() = default;
+
+    virtual void update(gsl::span<std::byte const> data) = 0;
+
+    // Lowercase hexadecimal. The digest must not be updated afterwards.
+    [[nodiscard]] virtual std::string finish() = 0;
+};
+
+[[nodiscard]] std::unique_ptr<IDigest> create_digest(DigestAlgorithm algorithm);
@@ -0,0 +1,301 @@
+#include "DirectoryIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include <xxhash.h>
+
+#include <LittleFile.hpp>
+
+#include "CFile.hpp"
+
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'L', 'F', 'S', 'I', 'N', 'D', 'E', 'X'};
+constexpr std::uint32_t INDEX_FORMAT_VERSION = 1;
+constexpr std::uint32_t INDEX_BYTE_ORDER = 0x01020304;
+
+std::uint64_t fingerprint_blocks(IBlockDevice & block_device,
+                                 gsl::span<std::uint32_t const> blocks,
+                                 std::uint32_t littlefs_version)
+{
+    std::unique_ptr<XXH3_state_t, decltype(&XXH3_freeState)> state(XXH3_createState(),
+                                                                   &XXH3_freeState);
+    if (nullptr == state)
+    {
+        throw std::bad_alloc();
+    }
+    XXH3_64bits_reset(state.get());
+
+    std::uint32_t const geometry[] = {
+        littlefs_version, block_device.block_size(), block_device.block_count()};
+    XXH3_64bits_update(state.get(), geometry, sizeof(geometry));
+
+    std::vector<std::byte> buffer(block_device.block_size());
+    for (auto const block : blocks)
+    {
+        block_device.read(block, 0, buffer.data(), block_device.block_size());
+        XXH3_64bits_update(state.get(), &block, sizeof(block));
+        XXH3_64bits_update(state.get(), buffer.data(), buffer.size());
+    }
+
+    return XXH3_64bits_digest(state.get());
+}
+
+template <typename T>
+void append_bytes(std::vector<std::byte> & output, gsl::span<T const> const values)
+{
+    auto const bytes = gsl::as_bytes(values);
+    output.insert(output.end(), bytes.begin(), bytes.end());
+}
+
+template <typename T>
+gsl::span<T const> view_array(gsl::span<std::byte const> const data,
+                              std::size_t & offset,
+                              std::size_t const count)
+{
+    if (count > (static_cast<std::size_t>(data.size()) - offset) / sizeof(T))
+    {
+        throw std::runtime_error("Truncated directory index");
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): The index is laid out for this
+    auto const * const first = reinterpret_cast<T const *>(data.data() + offset);
+    offset += count * sizeof(T);
+    return {first, static_cast<std::ptrdiff_t>(count)};
+}
+
+}  // namespace
+
+
+DirectoryIndex DirectoryIndex::build(LittleFS & filesystem,
+                                     RecordingBlockDevice & block_device,
+                                     std::uint32_t const littlefs_version)
+{
+    auto const tree = filesystem.file_tree("/");
+    auto const nodes = tree.nodes();
+
+    std::vector<Entry> entries {};
+    entries.reserve(static_cast<std::size_t>(nodes.size()));
+    std::string strings {};
+    std::string path {};
+
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
+    {
+        auto const & node = nodes[index];
+        auto const name = tree.name(node);
+
+        Entry entry {node.parent,
+                     static_cast<std::uint32_t>(strings.size()),
+                     static_cast<std::uint32_t>(name.size()),
+                     0,
+                     0,
+                     0};
+        strings += name;
+
+        if (0 != node.is_directory)
+        {
+            entry.flags = FLAG_DIRECTORY;
+        }
+        else
+        {
+            auto const file =
+                filesystem.open_file(tree.path(index, path), LittleFS::OpenFlags::Read);
+            auto const layout = file->layout();
+
+            entry.size = node.size;
+            if (layout.is_inline)
+            {
+                // Inline contents live in the metadata, so reading them is free
+                std::string contents(layout.size, '\0');
+                file->read(gsl::as_writeable_bytes(gsl::span<char>(contents)));
+
+                entry.flags = FLAG_INLINE;
+                entry.head = static_cast<std::uint32_t>(strings.size());
+                strings += contents;
+            }
+            else
+            {
+                entry.head = layout.head;
+            }
+        }
+
+        entries.push_back(entry);
+    }
+
+    auto const metadata_blocks = block_device.read_blocks();
+
+    Header header {};
+    std::copy(std::begin(INDEX_MAGIC), std::end(INDEX_MAGIC), std::begin(header.magic));
+    header.format_version = INDEX_FORMAT_VERSION;
+    header.byte_order = INDEX_BYTE_ORDER;
+    header.littlefs_version = littlefs_version;
+    header.block_size = block_device.block_size();
+    header.block_count = block_device.block_count();
+    header.metadata_block_count = static_cast<std::uint32_t>(metadata_blocks.size());
+    header.fingerprint = fingerprint_blocks(block_device, metadata_blocks, littlefs_version);
+    header.entry_count = static_cast<std::uint32_t>(entries.size());
+    header.strings_size = strings.size();
+
+    DirectoryIndex index {};
+    append_bytes(index._storage, gsl::span<Header const>(&header, 1));
+    append_bytes(index._storage, gsl::span<std::uint32_t const>(metadata_blocks));
+    append_bytes(index._storage, gsl::span<Entry const>(entries));
+    append_bytes(index._storage, gsl::span<char const>(strings));
+
+    index.parse(index._storage);
+    return index;
+}
+
+std::optional<DirectoryIndex> DirectoryIndex::load(std::string const & path)
+{
+    if (!std::ifstream(path).good())
+    {
+        return {};
+    }
+
+    DirectoryIndex index {};
+    index._mapping.emplace(path);
+
+    auto const data = index._mapping->data();
+    if (static_cast<std::size_t>(data.size()) < sizeof(Header))
+    {
+        return {};
+    }
+
+    Header header {};
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (!std::equal(std::begin(INDEX_MAGIC), std::end(INDEX_MAGIC), std::begin(header.magic))
+        || header.format_version != INDEX_FORMAT_VERSION
+        || header.byte_order != INDEX_BYTE_ORDER)
+    {
+        return {};
+    }
+
+    if (!is_complete(header, static_cast<std::size_t>(data.size())))
+    {
+        return {};
+    }
+
+    index.parse(data);
+    if (!index.has_valid_entries())
+    {
+        return {};
+    }
+    return index;
+}
+
+void DirectoryIndex::save(std::string const & path) const
+{
+    auto const data = _mapping ? _mapping->data() : gsl::span<std::byte const>(_storage);
+
+    CFile file(path, "wb");
+    if (file.write(data) != static_cast<std::size_t>(data.size()))
+    {
+        throw std::runtime_error("Failed writing directory index");
+    }
+}
+
+bool DirectoryIndex::matches(IBlockDevice & block_device,
+                             std::uint32_t const littlefs_version) const
+{
+    if (_header.littlefs_version != littlefs_version
+        || _header.block_size != block_device.block_size()
+        || _header.block_count != block_device.block_count())
+    {
+        return false;
+    }
+
+    if (std::any_of(_metadata_blocks.cbegin(),
+                    _metadata_blocks.cend(),
+                    [&](std::uint32_t const block) { return block >= _header.block_count; }))
+    {
+        return false;
+    }
+
+    return fingerprint_blocks(block_device, _metadata_blocks, littlefs_version)
+           == _header.fingerprint;
+}
+
+std::string_view DirectoryIndex::name(Entry const & entry) const
+{
+    if (static_cast<std::size_t>(entry.name_offset) + entry.name_size
+        > static_cast<std::size_t>(_strings.size()))
+    {
+        throw std::runtime_error("Corrupt directory index");
+    }
+
+    return {_strings.data() + entry.name_offset, entry.name_size};
+}
+
+gsl::span<std::byte const> DirectoryIndex::inline_data(Entry const & entry) const
+{
+    if (0 == (entry.flags & FLAG_INLINE)
+        || static_cast<std::size_t>(entry.head) + entry.size
+               > static_cast<std::size_t>(_strings.size()))
+    {
+        throw std::runtime_error("Corrupt directory index");
+    }
+
+    return gsl::as_bytes(_strings.subspan(entry.head, entry.size));
+}
+
+std::string const & DirectoryIndex::path(std::uint32_t const index, std::string & buffer) const
+{
+    return rebuild_path(
+        index,
+        buffer,
+        [this](std::uint32_t const entry) { return _entries.at(entry).parent; },
+        [this](std::uint32_t const entry) { return name(_entries.at(entry)); });
+}
+
+bool DirectoryIndex::is_complete(Header const & header, std::size_t const size) noexcept
+{
+    auto remaining = size - sizeof(Header);
+    auto const take = [&remaining](std::uint64_t const count, std::size_t const element_size) {
+        if (count > remaining / element_size)
+        {
+            return false;
+        }
+        remaining -= static_cast<std::size_t>(count) * element_size;
+        return true;
+    };
+
+    return take(header.metadata_block_count, sizeof(std::uint32_t))
+           && take(header.entry_count, sizeof(Entry)) && take(header.strings_size, sizeof(char))
+           && 0 == remaining;
+}
+
+void DirectoryIndex::parse(gsl::span<std::byte const> const data)
+{
+    std::memcpy(&_header, data.data(), sizeof(_header));
+
+    std::size_t offset = sizeof(Header);
+    _metadata_blocks = view_array<std::uint32_t>(data, offset, _header.metadata_block_count);
+    _entries = view_array<Entry>(data, offset, _header.entry_count);
+    _strings = view_array<char>(data, offset, _header.strings_size);
+}
+
+bool DirectoryIndex::has_valid_entries() const noexcept
+{
+    auto const strings_size = static_cast<std::uint64_t>(_strings.size());
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(_entries.size()); ++index)
+    {
+        auto const & entry = _entries[index];
+        auto const is_inline = 0 != (entry.flags & FLAG_INLINE);
+
+        if ((NO_PARENT != entry.parent && entry.parent >= index)
+            || static_cast<std::uint64_t>(entry.name_offset) + entry.name_size > strings_size
+            || (is_inline && static_cast<std::uint64_t>(entry.head) + entry.size > strings_size))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+#include <LittleFS.hpp>
+
+#include "MappedFile.hpp"
+#include "RecordingBlockDevice.hpp"
+
+
+// A snapshot of an image's directory tree, file sizes and data extents that
+// can be saved next to the image and memory-mapped back on later runs.
+//
+// The index is keyed by a fingerprint of every block read while walking the
+// metadata. Any change to the tree rewrites at least one of those blocks,
+// so a matching fingerprint means the snapshot is still accurate.
+class DirectoryIndex
+{
+public:
+    struct Entry
+    {
+        std::uint32_t parent;
+        std::uint32_t name_offset;
+        std::uint32_t name_size;
+        std::uint32_t flags;
+        std::uint32_t size;
+        // CTZ head for regular files, offset of the contents for inline files
+        std::uint32_t head;
+    };
+
+    static constexpr std::uint32_t NO_PARENT = FileTree::NO_PARENT;
+    static constexpr std::uint32_t FLAG_DIRECTORY = 1;
+    static constexpr std::uint32_t FLAG_INLINE = 2;
+
+private:
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t format_version;
+        std::uint32_t byte_order;
+        std::uint32_t littlefs_version;
+        std::uint32_t block_size;
+        std::uint32_t block_count;
+        std::uint32_t metadata_block_count;
+        std::uint64_t fingerprint;
+        std::uint32_t entry_count;
+        std::uint32_t reserved;
+        std::uint64_t strings_size;
+    };
+
+    std::optional<MappedFile> _mapping;
+    std::vector<std::byte> _storage;
+    Header _header;
+    gsl::span<std::uint32_t const> _metadata_blocks;
+    gsl::span<Entry const> _entries;
+    gsl::span<char const> _strings;
+
+public:
+    DirectoryIndex(DirectoryIndex &&) = default;
+    DirectoryIndex & operator=(DirectoryIndex &&) = default;
+
+    // The views point into the storage, so copies are not allowed
+    DirectoryIndex(DirectoryIndex const &) = delete;
+    DirectoryIndex & operator=(DirectoryIndex const &) = delete;
+
+    ~DirectoryIndex() = default;
+
+    // Walks the mounted filesystem. `block_device` must be the device the
+    // filesystem was mounted on, and must have seen every read since the mount.
+    static DirectoryIndex build(LittleFS & filesystem,
+                                RecordingBlockDevice & block_device,
+                                std::uint32_t littlefs_version);
+
+    // Returns nothing if the file does not exist, was written by an
+    // incompatible version of the index format, or is truncated or corrupt,
+    // for instance after an interrupted save. The index is then rebuilt.
+    static std::optional<DirectoryIndex> load(std::string const & path);
+
+    void save(std::string const & path) const;
+
+    // Re-reads the fingerprinted blocks and checks they are unchanged.
+    [[nodiscard]] bool matches(IBlockDevice & block_device, std::uint32_t littlefs_version) const;
+
+    [[nodiscard]] gsl::span<Entry const> entries() const noexcept
+    {
+        return _entries;
+    }
+
+    [[nodiscard]] std::string_view name(Entry const & entry) const;
+    [[nodiscard]] gsl::span<std::byte const> inline_data(Entry const & entry) const;
+
+    // Same as FileTree::path, for an entry of the index
+    std::string const & path(std::uint32_t index, std::string & buffer) const;
+
+private:
+    DirectoryIndex() = default;
+
+    // Whether `size` bytes hold exactly the arrays the header announces
+    static bool is_complete(Header const & header, std::size_t size) noexcept;
+
+    void parse(gsl::span<std::byte const> data);
+
+    // Whether every entry refers to an earlier parent and to strings in range
+    [[nodiscard]] bool has_valid_entries() const noexcept;
+};
@@ -0,0 +1,175 @@
+#include "FileDigester.hpp"
+
+#include <algorithm>
+#include <utility>
+
+
+namespace {
+
+// Data is handed to the workers in chunks of this size, or smaller at the end of a file
+constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+
+}  // namespace
+
+
+FileDigester::FileDigester(DigestAlgorithm const algorithm,
+                           unsigned const thread_count,
+                           std::size_t const max_pending_bytes) :
+    _algorithm(algorithm),
+    _max_pending_bytes(max_pending_bytes),
+    _mutex(),
+    _hashed(),
+    _pending_bytes(0),
+    _digests(),
+    _tasks(),
+    _file(),
+    _chunk(),
+    _pool(thread_count)
+{
+}
+
+void FileDigester::begin_file(std::string const & path)
+{
+    _file = std::make_shared<PendingFile>();
+    _file->digest = create_digest(_algorithm);
+    _chunk.clear();
+
+    std::lock_guard<std::mutex> const lock(_mutex);
+    _file->index = _digests.size();
+    _digests.push_back({path, 0, {}});
+}
+
+void FileDigester::update(gsl::span<std::byte const> data)
+{
+    _file->size += static_cast<std::uint64_t>(data.size());
+
+    while (!data.empty())
+    {
+        auto const count =
+            std::min(CHUNK_SIZE - _chunk.size(), static_cast<std::size_t>(data.size()));
+        auto const piece = data.first(static_cast<std::ptrdiff_t>(count));
+        _chunk.insert(_chunk.end(), piece.cbegin(), piece.cend());
+        data = data.subspan(static_cast<std::ptrdiff_t>(count));
+
+        if (CHUNK_SIZE == _chunk.size())
+        {
+            submit_chunk();
+        }
+    }
+}
+
+void FileDigester::end_file()
+{
+    if (!_chunk.empty())
+    {
+        submit_chunk();
+    }
+
+    {
+        std::lock_guard<std::mutex> const lock(_mutex);
+        _digests[_file->index].size = _file->size;
+        _file->ended = true;
+    }
+    schedule();
+
+    _file.reset();
+}
+
+std::vector<FileDigest> FileDigester::finish()
+{
+    for (auto & task : _tasks)
+    {
+        task.get();
+    }
+    _tasks.clear();
+
+    std::lock_guard<std::mutex> const lock(_mutex);
+    return std::move(_digests);
+}
+
+void FileDigester::submit_chunk()
+{
+    auto chunk = std::move(_chunk);
+    _chunk = {};
+    _chunk.reserve(CHUNK_SIZE);
+
+    {
+        // A chunk larger than the cap waits until nothing else is pending
+        std::unique_lock<std::mutex> lock(_mutex);
+        _hashed.wait(lock, [this, size = chunk.size()]() {
+            return 0 == _pending_bytes || _pending_bytes + size <= _max_pending_bytes;
+        });
+
+        if (_file->failed)
+        {
+            return;
+        }
+
+        _pending_bytes += chunk.size();
+        _file->chunks.push_back(std::move(chunk));
+    }
+    schedule();
+}
+
+void FileDigester::schedule()
+{
+    {
+        std::lock_guard<std::mutex> const lock(_mutex);
+        if (_file->scheduled)
+        {
+            return;
+        }
+        _file->scheduled = true;
+    }
+
+    _tasks.push_back(_pool.submit([this, file = _file]() { hash_chunks(*file); }));
+}
+
+// Runs until no chunk is left. The writer schedules it again for the chunks
+// that arrive later, and once more when the file ends.
+void FileDigester::hash_chunks(PendingFile & file)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    try
+    {
+        while (!file.chunks.empty())
+        {
+            auto const chunk = std::move(file.chunks.front());
+            file.chunks.pop_front();
+
+            lock.unlock();
+            auto const release = gsl::finally([this, &lock, size = chunk.size()]() {
+                lock.lock();
+                _pending_bytes -= size;
+                _hashed.notify_all();
+            });
+            file.digest->update(chunk);
+        }
+
+        if (file.ended)
+        {
+            lock.unlock();
+            auto digest = file.digest->finish();
+            lock.lock();
+            _digests[file.index].digest = std::move(digest);
+        }
+        file.scheduled = false;
+    }
+    catch (...)
+    {
+        // Even a failed file must release its share of the cap. It stays
+        // scheduled, so that no worker hashes it again.
+        if (!lock.owns_lock())
+        {
+            lock.lock();
+        }
+        file.failed = true;
+        for (auto const & chunk : file.chunks)
+        {
+            _pending_bytes -= chunk.size();
+        }
+        file.chunks.clear();
+        _hashed.notify_all();
+        throw;
+    }
+}
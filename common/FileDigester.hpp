@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include "Digest.hpp"
+#include "ThreadPool.hpp"
+
+
+struct FileDigest
+{
+    std::string path {};
+    std::uint64_t size {};
+    std::string digest {};
+};
+
+// Hashes the files an archive writes, in the background. The writer hands over
+// each file's data as it goes, in chunks, and a worker pool hashes them while
+// the writer moves on. The chunks of one file are hashed in order by one worker
+// at a time, and different files in parallel. Data waiting to be hashed is
+// capped, and the writer blocks when it would exceed the cap.
+class FileDigester final
+{
+private:
+    struct PendingFile
+    {
+        std::size_t index {};
+        std::unique_ptr<IDigest> digest {};
+        std::uint64_t size {};
+        // The members below are guarded by the digester's mutex
+        std::deque<std::vector<std::byte>> chunks {};
+        // A worker is hashing the chunks, and finishes the digest once the
+        // file has ended
+        bool scheduled {};
+        bool ended {};
+        // Hashing failed; later chunks are dropped
+        bool failed {};
+    };
+
+    DigestAlgorithm _algorithm;
+    std::size_t _max_pending_bytes;
+
+    std::mutex _mutex;
+    std::condition_variable _hashed;
+    std::size_t _pending_bytes;
+    std::vector<FileDigest> _digests;
+    std::vector<std::future<void>> _tasks;
+
+    std::shared_ptr<PendingFile> _file;
+    std::vector<std::byte> _chunk;
+
+    // Last, so that its workers are joined before anything they use goes away
+    ThreadPool _pool;
+
+public:
+    static constexpr std::size_t DEFAULT_MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
+    // A thread count of 0 uses one thread per hardware thread
+    FileDigester(DigestAlgorithm algorithm,
+                 unsigned thread_count,
+                 std::size_t max_pending_bytes = DEFAULT_MAX_PENDING_BYTES);
+
+    FileDigester(FileDigester const &) = delete;
+    FileDigester & operator=(FileDigester const &) = delete;
+
+    void begin_file(std::string const & path);
+    void update(gsl::span<std::byte const> data);
+    void end_file();
+
+    // Waits for every file, and returns their digests in the order they were added
+    std::vector<FileDigest> finish();
+
+    [[nodiscard]] DigestAlgorithm algorithm() const noexcept
+    {
+        return _algorithm;
+    }
+
+private:
+    void submit_chunk();
+    void schedule();
+    void hash_chunks(PendingFile & file);
+};
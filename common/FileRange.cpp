@@ -0,0 +1,46 @@
+#include "FileRange.hpp"
+
+#include <algorithm>
+#include <vector>
+
+
+std::uint64_t read_file_range(LittleFS & filesystem,
+                              std::string const & path,
+                              FileRange const & range,
+                              RangeSink const & sink,
+                              std::size_t const buffer_size)
+{
+    auto const file = filesystem.open_file(path, LittleFS::OpenFlags::Read);
+    auto const size = static_cast<std::uint64_t>(file->size());
+
+    auto const offset = std::min(range.offset, size);
+    auto const start = range.from_end ? size - offset : offset;
+
+    auto remaining = std::min(range.length.value_or(size), size - start);
+    if (0 == remaining)
+    {
+        return 0;
+    }
+
+    file->seek(static_cast<std::size_t>(start));
+
+    std::vector<std::byte> buffer(static_cast<std::size_t>(
+        std::min(static_cast<std::uint64_t>(buffer_size), remaining)));
+    std::uint64_t total = 0;
+    while (remaining > 0)
+    {
+        auto const chunk = gsl::span<std::byte>(buffer).first(static_cast<std::ptrdiff_t>(
+            std::min(static_cast<std::uint64_t>(buffer.size()), remaining)));
+        auto const count = file->read(chunk);
+        if (0 == count)
+        {
+            break;
+        }
+
+        sink(gsl::span<std::byte const>(chunk).first(static_cast<std::ptrdiff_t>(count)));
+        total += count;
+        remaining -= count;
+    }
+
+    return total;
+}
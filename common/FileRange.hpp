@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
+#include <gsl/gsl>
+
+#include <LittleFS.hpp>
+
+
+// Part of a file. With `from_end` set, the offset counts back from the end of
+// the file, so an offset of 0 starts at the end. A missing length runs to the
+// end. Both are clamped to the file.
+struct FileRange
+{
+    std::uint64_t offset {};
+    bool from_end {};
+    std::optional<std::uint64_t> length {};
+};
+
+using RangeSink = std::function<void(gsl::span<std::byte const>)>;
+
+constexpr std::size_t DEFAULT_RANGE_BUFFER_SIZE = 1024 * 1024;
+
+// Opens the file at `path`, seeks straight to the start of `range` and hands
+// its bytes to `sink`, in chunks of at most `buffer_size` bytes. Nothing
+// before the range is read, and no directory is walked. Returns the number of
+// bytes read.
+std::uint64_t read_file_range(LittleFS & filesystem,
+                              std::string const & path,
+                              FileRange const & range,
+                              RangeSink const & sink,
+                              std::size_t buffer_size = DEFAULT_RANGE_BUFFER_SIZE);
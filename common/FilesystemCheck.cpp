@@ -0,0 +1,415 @@
+#include "FilesystemCheck.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <Ctz.hpp>
+#include <DiskFormat1.hpp>
+#include <DiskFormat2.hpp>
+
+#include "CowBlockDevice.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace {
+
+// Owner markers for blocks that do not belong to a file
+constexpr std::uint32_t UNOWNED = std::numeric_limits<std::uint32_t>::max();
+constexpr std::uint32_t METADATA = UNOWNED - 1;
+
+constexpr std::size_t READ_BUFFER_SIZE = 64 * 1024;
+
+struct TreeWalk
+{
+    std::uint64_t directories {};
+    std::vector<LittleFS::FileInfo> files {};
+    // Each directory with the blocks of its metadata pairs
+    std::vector<std::pair<std::string, std::vector<std::uint32_t>>> pairs {};
+};
+
+struct FileCheck
+{
+    std::vector<std::uint32_t> blocks {};
+    std::vector<CheckIssue> issues {};
+};
+
+gsl::span<std::byte const> block_data(gsl::span<std::byte const> const image,
+                                      std::uint32_t const block_size,
+                                      std::uint32_t const block)
+{
+    auto const offset = static_cast<std::size_t>(block) * block_size;
+    return image.subspan(static_cast<std::ptrdiff_t>(offset), block_size);
+}
+
+bool is_metadata_block(gsl::span<std::byte const> const block,
+                       std::uint32_t const littlefs_version) noexcept
+{
+    return 1 == littlefs_version ? is_metadata_block1(block) : is_metadata_block2(block);
+}
+
+// A directory that cannot be listed is reported and skipped instead of ending
+// the walk.
+TreeWalk walk_tree(LittleFS & filesystem, std::vector<CheckIssue> & issues)
+{
+    TreeWalk walk {};
+
+    std::unordered_set<std::string> unlisted {};
+    auto const tree = filesystem.file_tree(
+        "/", [&](std::string const & path, std::exception const & exception) {
+            auto display_path = path.empty() ? std::string("/") : path;
+            issues.push_back({CheckIssue::Kind::Directory, display_path, {}, exception.what()});
+            unlisted.insert(std::move(display_path));
+        });
+
+    auto const add_pairs = [&](std::string const & path, std::string const & display_path) {
+        if (0 != unlisted.count(display_path))
+        {
+            return;
+        }
+
+        try
+        {
+            walk.pairs.emplace_back(display_path, filesystem.directory_blocks(path));
+        }
+        catch (std::exception const & exception)
+        {
+            issues.push_back({CheckIssue::Kind::Directory, display_path, {}, exception.what()});
+        }
+    };
+
+    add_pairs("", "/");
+
+    auto const nodes = tree.nodes();
+    std::string path {};
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
+    {
+        tree.path(index, path);
+        if (0 != nodes[index].is_directory)
+        {
+            ++walk.directories;
+            add_pairs(path, path);
+        }
+        else
+        {
+            walk.files.push_back({path, nodes[index].size});
+        }
+    }
+
+    return walk;
+}
+
+FileCheck check_file(LittleFS & filesystem,
+                     IBlockDevice & block_device,
+                     LittleFS::FileInfo const & info,
+                     bool const read_data)
+{
+    FileCheck result {};
+
+    try
+    {
+        auto file = filesystem.open_file(info.path, LittleFS::OpenFlags::Read);
+        auto const layout = file->layout();
+
+        if (!layout.is_inline)
+        {
+            try
+            {
+                result.blocks = ctz_blocks(block_device, layout.head, layout.size);
+            }
+            catch (std::range_error const & exception)
+            {
+                result.issues.push_back(
+                    {CheckIssue::Kind::CtzRange, info.path, layout.head, exception.what()});
+            }
+
+            auto sorted = result.blocks;
+            std::sort(sorted.begin(), sorted.end());
+            auto const repeated = std::adjacent_find(sorted.cbegin(), sorted.cend());
+            if (repeated != sorted.cend())
+            {
+                result.issues.push_back({CheckIssue::Kind::CtzCycle,
+                                         info.path,
+                                         *repeated,
+                                         "CTZ skip-list visits a block twice"});
+            }
+        }
+
+        if (read_data)
+        {
+            std::vector<std::byte> buffer(READ_BUFFER_SIZE);
+            std::size_t total = 0;
+            for (;;)
+            {
+                auto const count = file->read(buffer);
+                if (0 == count)
+                {
+                    break;
+                }
+                total += count;
+            }
+
+            if (total != layout.size)
+            {
+                result.issues.push_back(
+                    {CheckIssue::Kind::Unreadable,
+                     info.path,
+                     {},
+                     fmt::format("read {} of {} bytes", total, layout.size)});
+            }
+        }
+    }
+    catch (std::exception const & exception)
+    {
+        result.issues.push_back({CheckIssue::Kind::Unreadable, info.path, {}, exception.what()});
+    }
+
+    return result;
+}
+
+// Every worker mounts the shared image on its own copy-on-write device and takes
+// every n-th file, so that runs of large files spread over all workers.
+std::vector<FileCheck> check_files(gsl::span<std::byte const> const image,
+                                   std::uint32_t const block_size,
+                                   FilesystemFactory const & mount,
+                                   std::vector<LittleFS::FileInfo> const & files,
+                                   CheckOptions const & options)
+{
+    std::vector<FileCheck> results(files.size());
+
+    ThreadPool pool(options.thread_count);
+    auto const workers = std::min(pool.size(), files.size());
+
+    std::vector<std::future<void>> pending {};
+    for (std::size_t worker = 0; worker < workers; ++worker)
+    {
+        pending.push_back(pool.submit([&, worker]() {
+            auto block_device = std::make_unique<CowBlockDevice>(image, block_size);
+            auto & device = *block_device;
+            auto filesystem = mount(std::move(block_device));
+
+            for (auto index = worker; index < files.size(); index += workers)
+            {
+                results[index] = check_file(*filesystem, device, files[index], options.read_data);
+            }
+        }));
+    }
+
+    for (auto & future : pending)
+    {
+        future.get();
+    }
+
+    return results;
+}
+
+}  // namespace
+
+
+char const * issue_kind_name(CheckIssue::Kind const kind) noexcept
+{
+    switch (kind)
+    {
+    case CheckIssue::Kind::Mount:
+        return "mount";
+    case CheckIssue::Kind::Directory:
+        return "directory";
+    case CheckIssue::Kind::MetadataCrc:
+        return "metadata-crc";
+    case CheckIssue::Kind::BlockRange:
+        return "block-range";
+    case CheckIssue::Kind::CtzRange:
+        return "ctz-range";
+    case CheckIssue::Kind::CtzCycle:
+        return "ctz-cycle";
+    case CheckIssue::Kind::SharedBlock:
+        return "shared-block";
+    case CheckIssue::Kind::Orphan:
+        return "orphan";
+    case CheckIssue::Kind::Traversal:
+        return "traversal";
+    case CheckIssue::Kind::Unreadable:
+        return "unreadable";
+    }
+    return "unknown";
+}
+
+CheckReport check_filesystem(gsl::span<std::byte const> const image,
+                             std::uint32_t const block_size,
+                             FilesystemFactory const & mount,
+                             CheckOptions const & options)
+{
+    CheckReport report {};
+    auto & issues = report.issues;
+
+    auto const block_count =
+        static_cast<std::uint32_t>(static_cast<std::size_t>(image.size()) / block_size);
+
+    std::unique_ptr<LittleFS> filesystem {};
+    try
+    {
+        filesystem = mount(std::make_unique<CowBlockDevice>(image, block_size));
+    }
+    catch (std::exception const & exception)
+    {
+        issues.push_back({CheckIssue::Kind::Mount, {}, {}, exception.what()});
+        return report;
+    }
+    report.mounted = true;
+
+    auto const walk = walk_tree(*filesystem, issues);
+
+    std::vector<std::uint32_t> owners(block_count, UNOWNED);
+    std::vector<bool> shared(block_count, false);
+
+    auto const check_pair = [&](std::string const & path,
+                                std::uint32_t const first,
+                                std::uint32_t const second) {
+        for (auto const block : {first, second})
+        {
+            if (block >= block_count)
+            {
+                issues.push_back({CheckIssue::Kind::BlockRange,
+                                  path,
+                                  block,
+                                  "metadata pair beyond the end of the device"});
+                return;
+            }
+        }
+
+        // In littlefs 2 the superblock pair is also the root directory
+        if (METADATA == owners[first] && METADATA == owners[second])
+        {
+            return;
+        }
+
+        bool valid = false;
+        for (auto const block : {first, second})
+        {
+            if (UNOWNED != owners[block])
+            {
+                issues.push_back({CheckIssue::Kind::SharedBlock,
+                                  path,
+                                  block,
+                                  "block belongs to more than one metadata pair"});
+                shared[block] = true;
+            }
+            owners[block] = METADATA;
+            valid = valid
+                    || is_metadata_block(block_data(image, block_size, block),
+                                         options.littlefs_version);
+        }
+        if (!valid)
+        {
+            issues.push_back({CheckIssue::Kind::MetadataCrc,
+                              path,
+                              first,
+                              "no valid commit in either block of the pair"});
+        }
+    };
+
+    check_pair("/", 0, 1);
+    for (auto const & [path, blocks] : walk.pairs)
+    {
+        for (std::size_t index = 0; index + 1 < blocks.size(); index += 2)
+        {
+            check_pair(path, blocks[index], blocks[index + 1]);
+        }
+    }
+
+    auto const files = check_files(image, block_size, mount, walk.files, options);
+    for (std::size_t index = 0; index < files.size(); ++index)
+    {
+        auto const & path = walk.files[index].path;
+        issues.insert(issues.end(), files[index].issues.cbegin(), files[index].issues.cend());
+
+        auto const owner = static_cast<std::uint32_t>(index);
+        for (auto const block : files[index].blocks)
+        {
+            // ctz_blocks has already checked the range
+            if (UNOWNED == owners[block])
+            {
+                owners[block] = owner;
+            }
+            else if (owner != owners[block])
+            {
+                auto const other = METADATA == owners[block] ? std::string("metadata")
+                                                             : walk.files[owners[block]].path;
+                issues.push_back({CheckIssue::Kind::SharedBlock,
+                                  path,
+                                  block,
+                                  fmt::format("block is also used by {}", other)});
+                shared[block] = true;
+            }
+        }
+
+        ++report.statistics.files;
+        report.statistics.bytes += walk.files[index].size;
+    }
+    report.statistics.directories = walk.directories;
+
+    std::vector<std::uint8_t> references(block_count, 0);
+    try
+    {
+        filesystem->traverse([&](std::uint32_t const block) {
+            if (block >= block_count)
+            {
+                issues.push_back({CheckIssue::Kind::BlockRange,
+                                  {},
+                                  block,
+                                  "traversal reports a block beyond the end of the device"});
+                return;
+            }
+            if (references[block] < std::numeric_limits<std::uint8_t>::max())
+            {
+                ++references[block];
+            }
+        });
+    }
+    catch (std::exception const & exception)
+    {
+        issues.push_back({CheckIssue::Kind::Traversal, {}, {}, exception.what()});
+    }
+
+    for (std::uint32_t block = 0; block < block_count; ++block)
+    {
+        if (METADATA == owners[block])
+        {
+            ++report.statistics.metadata_blocks;
+        }
+        else if (UNOWNED != owners[block])
+        {
+            ++report.statistics.data_blocks;
+        }
+
+        if (0 == references[block])
+        {
+            continue;
+        }
+        ++report.statistics.used_blocks;
+
+        if (UNOWNED == owners[block])
+        {
+            issues.push_back({CheckIssue::Kind::Orphan,
+                              {},
+                              block,
+                              "block in use but not reachable from the root directory"});
+        }
+        else if (references[block] > 1 && !shared[block])
+        {
+            issues.push_back(
+                {CheckIssue::Kind::SharedBlock,
+                 {},
+                 block,
+                 fmt::format("traversal reports the block {} times", references[block])});
+        }
+    }
+
+    return report;
+}
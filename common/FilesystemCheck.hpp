@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+#include <LittleFS.hpp>
+
+
+// One inconsistency found while checking an image
+struct CheckIssue
+{
+    enum class Kind
+    {
+        Mount,          // the image does not mount
+        Directory,      // a directory cannot be listed
+        MetadataCrc,    // neither block of a metadata pair holds a valid commit
+        BlockRange,     // a block number beyond the end of the device
+        CtzRange,       // a CTZ skip-list points outside the device
+        CtzCycle,       // a CTZ skip-list visits the same block twice
+        SharedBlock,    // a block belongs to more than one owner
+        Orphan,         // a block in use that no directory entry reaches
+        Traversal,      // littlefs' own traversal fails
+        Unreadable,     // a file cannot be opened or read to its end
+    };
+
+    Kind kind {};
+    std::string path {};
+    std::optional<std::uint32_t> block {};
+    std::string message {};
+};
+
+// Short, stable name of an issue kind, as used in reports
+[[nodiscard]] char const * issue_kind_name(CheckIssue::Kind kind) noexcept;
+
+struct CheckStatistics
+{
+    std::uint64_t directories {};
+    std::uint64_t files {};
+    std::uint64_t bytes {};
+    std::uint32_t metadata_blocks {};
+    std::uint32_t data_blocks {};
+    std::uint32_t used_blocks {};
+};
+
+struct CheckReport
+{
+    bool mounted {};
+    CheckStatistics statistics {};
+    std::vector<CheckIssue> issues {};
+
+    [[nodiscard]] bool passed() const noexcept
+    {
+        return mounted && issues.empty();
+    }
+};
+
+struct CheckOptions
+{
+    std::uint32_t littlefs_version {};
+    unsigned thread_count {};
+    bool read_data {};
+};
+
+// Mounts a filesystem on the given device, throwing if that fails
+using FilesystemFactory =
+    std::function<std::unique_ptr<LittleFS>(std::unique_ptr<IBlockDevice> block_device)>;
+
+// Checks the consistency of a whole image held in memory.
+//
+// The directory tree is walked once to find every metadata pair and file. The
+// files are then split over a pool of threads, each with its own mount on the
+// shared image, which follow every CTZ skip-list and, with `read_data`, read
+// every file to its end. Finally the blocks reported by littlefs' own traversal
+// are compared with the owners found on the way.
+[[nodiscard]] CheckReport check_filesystem(gsl::span<std::byte const> image,
+                                           std::uint32_t block_size,
+                                           FilesystemFactory const & mount,
+                                           CheckOptions const & options);
@@ -0,0 +1,74 @@
+#include "HostDirectory.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#if defined(_MSC_VER)
+    #include "Unicode.hpp"
+#endif
+
+
+namespace fs = boost::filesystem;
+
+
+namespace {
+
+fs::path to_path(std::string const & path)
+{
+#if defined(_MSC_VER)
+    return fs::path(utf8_to_wide_char(path));
+#else
+    return fs::path(path);
+#endif
+}
+
+std::string to_utf8(fs::path const & path)
+{
+#if defined(_MSC_VER)
+    return wide_char_to_utf8(path.generic_wstring());
+#else
+    return path.generic_string();
+#endif
+}
+
+}  // namespace
+
+
+std::vector<HostEntry> list_host_directory(std::string const & root)
+{
+    auto const root_path = to_path(root);
+
+    std::vector<HostEntry> entries {};
+    for (auto const & item : fs::recursive_directory_iterator(root_path))
+    {
+        auto const status = item.status();
+        if (!fs::is_directory(status) && !fs::is_regular_file(status))
+        {
+            continue;
+        }
+
+        HostEntry entry {};
+        entry.path = to_utf8(fs::relative(item.path(), root_path));
+        entry.host_path = to_utf8(item.path());
+        entry.is_directory = fs::is_directory(status);
+        entry.size = entry.is_directory ? 0 : fs::file_size(item.path());
+
+        entries.push_back(std::move(entry));
+    }
+
+    std::sort(entries.begin(),
+              entries.end(),
+              [](HostEntry const & first, HostEntry const & second) {
+                  return first.path < second.path;
+              });
+
+    return entries;
+}
+
+bool is_host_directory(std::string const & path)
+{
+    return fs::is_directory(to_path(path));
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+struct HostEntry
+{
+    // Relative to the listed directory, with '/' separators and no leading '/'
+    std::string path {};
+    // Full path, usable with CFile and MappedFile
+    std::string host_path {};
+    bool is_directory {};
+    std::uint64_t size {};
+};
+
+// Recursively lists the directories and regular files under `root`, sorted by
+// path so that every directory comes before its contents. Other file types are skipped.
+std::vector<HostEntry> list_host_directory(std::string const & root);
+
+[[nodiscard]] bool is_host_directory(std::string const & path);
@@ -0,0 +1,83 @@
+#include "ImageFile.hpp"
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <LittleFS1.hpp>
+#include <LittleFS2.hpp>
+
+#include "CFile.hpp"
+#include "FileBlockDevice.hpp"
+#include "Util.hpp"
+
+
+std::uint32_t image_block_count(std::string const & path,
+                                std::uint32_t const block_size,
+                                std::optional<std::uint32_t> const block_count)
+{
+    if (block_count)
+    {
+        return *block_count;
+    }
+
+    auto const image_size = file_size(path);
+    if (image_size % block_size != 0)
+    {
+        throw std::runtime_error("Invalid block size");
+    }
+
+    auto const image_blocks = image_size / block_size;
+
+    if (image_blocks > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::runtime_error("Image too large");
+    }
+
+    return static_cast<std::uint32_t>(image_blocks);
+}
+
+std::unique_ptr<MemoryBlockDevice> load_image(std::string const & path,
+                                              std::uint32_t const block_size,
+                                              std::uint32_t const block_count)
+{
+    FileBlockDevice image_file(path, false, block_size, block_count);
+
+    auto image = std::make_unique<MemoryBlockDevice>(block_size, block_count);
+    std::vector<std::byte> buffer(block_size);
+    for (std::uint32_t block = 0; block < block_count; ++block)
+    {
+        image_file.read(block, 0, buffer.data(), block_size);
+        image->program(block, 0, buffer.data(), block_size);
+    }
+
+    return image;
+}
+
+void save_image(gsl::span<std::byte const> const data, std::string const & path)
+{
+    CFile output(path, "wb");
+    if (output.write(data) != static_cast<std::size_t>(data.size()))
+    {
+        throw std::runtime_error("Failed writing the image");
+    }
+}
+
+std::unique_ptr<LittleFS> open_filesystem(std::uint32_t const littlefs_version,
+                                          std::unique_ptr<IBlockDevice> block_device,
+                                          std::uint32_t const read_size,
+                                          std::uint32_t const prog_size)
+{
+    switch (littlefs_version)
+    {
+    case 1:
+        return std::make_unique<LittleFS1>(std::move(block_device), read_size, prog_size);
+
+    case 2:
+        return std::make_unique<LittleFS2>(std::move(block_device), read_size, prog_size);
+
+    default:
+        throw std::runtime_error("Invalid littlefs version specified");
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+#include <LittleFS.hpp>
+
+#include "MemoryBlockDevice.hpp"
+
+
+// `block_count` if given, otherwise the number of blocks in the image file
+[[nodiscard]] std::uint32_t image_block_count(std::string const & path,
+                                              std::uint32_t block_size,
+                                              std::optional<std::uint32_t> block_count);
+
+// Reads a whole image file into memory, sequentially, for tools that then issue
+// many small, scattered reads
+[[nodiscard]] std::unique_ptr<MemoryBlockDevice>
+    load_image(std::string const & path, std::uint32_t block_size, std::uint32_t block_count);
+
+void save_image(gsl::span<std::byte const> data, std::string const & path);
+
+// Mounts a littlefs 1 or 2 filesystem
+[[nodiscard]] std::unique_ptr<LittleFS> open_filesystem(std::uint32_t littlefs_version,
+                                                        std::unique_ptr<IBlockDevice> block_device,
+                                                        std::uint32_t read_size,
+                                                        std::uint32_t prog_size);
@@ -0,0 +1,220 @@
+#include "ImageGenerator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+
+namespace {
+
+// Only the raw engine output is used: the standard distributions are
+// implementation-defined, and images must not depend on the standard library.
+class Random
+{
+private:
+    std::mt19937_64 _engine;
+
+public:
+    explicit Random(std::uint64_t const seed) : _engine(seed)
+    {
+    }
+
+    std::uint64_t next() noexcept
+    {
+        return _engine();
+    }
+
+    // In [0, bound)
+    std::uint64_t below(std::uint64_t const bound) noexcept
+    {
+        return next() % bound;
+    }
+
+    // In [0, 1)
+    double unit() noexcept
+    {
+        constexpr double SCALE = 1.0 / 9007199254740992.0;  // 2^-53
+        return static_cast<double>(next() >> 11U) * SCALE;
+    }
+};
+
+struct GeneratedFile
+{
+    std::string path;
+    std::uint32_t size;
+};
+
+class Generator
+{
+private:
+    LittleFS & _filesystem;
+    GenerationProfile const & _profile;
+    Random _random;
+    std::vector<std::string> _directories;
+    std::vector<GeneratedFile> _files;
+    std::vector<std::byte> _contents;
+    std::uint64_t _next_file_number;
+    GenerationStatistics _statistics;
+
+public:
+    Generator(LittleFS & filesystem, GenerationProfile const & profile) :
+        _filesystem(filesystem),
+        _profile(profile),
+        _random(profile.seed),
+        _directories(),
+        _files(),
+        _contents(profile.max_file_size),
+        _next_file_number(0),
+        _statistics()
+    {
+    }
+
+    GenerationStatistics run()
+    {
+        _directories.emplace_back("");
+        make_directories("", 0);
+
+        _files.reserve(_profile.file_count);
+        for (std::uint32_t index = 0; index < _profile.file_count; ++index)
+        {
+            _files.push_back(create_file());
+        }
+
+        auto const churn_count = static_cast<std::uint64_t>(
+            std::llround(_profile.churn_fraction * static_cast<double>(_files.size())));
+        for (std::uint32_t cycle = 0; cycle < _profile.churn_cycles; ++cycle)
+        {
+            for (std::uint64_t step = 0; step < churn_count && !_files.empty(); ++step)
+            {
+                churn(_files[_random.below(_files.size())]);
+            }
+        }
+
+        return _statistics;
+    }
+
+private:
+    void make_directories(std::string const & path, std::uint32_t const depth)
+    {
+        if (depth >= _profile.depth)
+        {
+            return;
+        }
+
+        for (std::uint32_t index = 0; index < _profile.fan_out; ++index)
+        {
+            auto child = fmt::format("{}/directory_{:04}", path, index);
+            _filesystem.make_directory(child);
+            ++_statistics.directories;
+
+            _directories.push_back(child);
+            make_directories(child, depth + 1);
+        }
+    }
+
+    std::uint32_t next_size() noexcept
+    {
+        auto const minimum = _profile.min_file_size;
+        auto const maximum = _profile.max_file_size;
+
+        switch (_profile.size_distribution)
+        {
+        case SizeDistribution::Fixed:
+            return maximum;
+
+        case SizeDistribution::Uniform:
+            return minimum + static_cast<std::uint32_t>(_random.below(maximum - minimum + 1ULL));
+
+        case SizeDistribution::LogUniform:
+        default:
+        {
+            auto const low = std::log(static_cast<double>(minimum) + 1.0);
+            auto const high = std::log(static_cast<double>(maximum) + 1.0);
+            auto const size = std::exp(low + _random.unit() * (high - low)) - 1.0;
+            return std::min(maximum, static_cast<std::uint32_t>(size));
+        }
+        }
+    }
+
+    void write_contents(std::string const & path, std::uint32_t const size)
+    {
+        // Cheap per-file pattern so that files are not trivially identical
+        auto state = _random.next() | 1U;
+        auto const contents = gsl::span<std::byte>(_contents).first(size);
+        for (auto & byte : contents)
+        {
+            state ^= state << 13U;
+            state ^= state >> 7U;
+            state ^= state << 17U;
+            byte = static_cast<std::byte>(state);
+        }
+
+        auto const file = _filesystem.open_file(path,
+                                                LittleFS::OpenFlags::Write
+                                                    | LittleFS::OpenFlags::CreateIfNotExists
+                                                    | LittleFS::OpenFlags::Truncate);
+        if (file->write(contents) != static_cast<std::size_t>(contents.size()))
+        {
+            throw std::runtime_error(fmt::format("Short write to {}", path));
+        }
+
+        // Only counted once the final commit went through
+        file->close();
+
+        _statistics.bytes += size;
+    }
+
+    GeneratedFile create_file()
+    {
+        auto const & directory = _directories[_random.below(_directories.size())];
+        GeneratedFile file {fmt::format("{}/file_{:06}.bin", directory, _next_file_number++),
+                            next_size()};
+
+        write_contents(file.path, file.size);
+        ++_statistics.files;
+
+        return file;
+    }
+
+    void churn(GeneratedFile & file)
+    {
+        if (0 == (_random.next() & 1U))
+        {
+            _filesystem.remove(file.path);
+            ++_statistics.deletions;
+            --_statistics.files;
+
+            file = create_file();
+        }
+        else
+        {
+            file.size = next_size();
+            write_contents(file.path, file.size);
+            ++_statistics.rewrites;
+        }
+    }
+};
+
+}  // namespace
+
+
+GenerationStatistics generate_image(LittleFS & filesystem, GenerationProfile const & profile)
+{
+    if (profile.min_file_size > profile.max_file_size)
+    {
+        throw std::invalid_argument("Minimum file size exceeds maximum file size");
+    }
+    if (profile.churn_fraction < 0 || profile.churn_fraction > 1)
+    {
+        throw std::invalid_argument("Churn fraction must be between 0 and 1");
+    }
+
+    return Generator(filesystem, profile).run();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include <LittleFS.hpp>
+
+
+enum class SizeDistribution
+{
+    Fixed,
+    Uniform,
+    // Uniform over the logarithm of the size: mostly small files with a long tail of huge ones
+    LogUniform,
+};
+
+// Describes the shape of a generated image. The same profile always produces
+// the same sequence of filesystem operations, and therefore the same image.
+struct GenerationProfile
+{
+    std::uint64_t seed {};
+
+    std::uint32_t file_count {};
+    SizeDistribution size_distribution {SizeDistribution::LogUniform};
+    std::uint32_t min_file_size {};
+    std::uint32_t max_file_size {};
+
+    // Directories above `depth` hold `fan_out` subdirectories each.
+    // Files are spread uniformly over all directories, including the root.
+    std::uint32_t depth {};
+    std::uint32_t fan_out {};
+
+    // Each cycle touches `churn_fraction` of the files, either deleting and
+    // recreating them elsewhere or rewriting them in place with a new size
+    std::uint32_t churn_cycles {};
+    double churn_fraction {};
+};
+
+struct GenerationStatistics
+{
+    std::uint64_t directories {};
+    std::uint64_t files {};
+    std::uint64_t bytes {};
+    std::uint64_t deletions {};
+    std::uint64_t rewrites {};
+};
+
+// Populates an empty, mounted filesystem according to `profile`
+GenerationStatistics generate_image(LittleFS & filesystem, GenerationProfile const & profile);
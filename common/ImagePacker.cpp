@@ -0,0 +1,206 @@
+#include "ImagePacker.hpp"
+
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fmt/core.h>
+#include <gsl/gsl>
+#include <lfs2.h>
+
+#include <Ctz.hpp>
+
+
+namespace {
+
+constexpr std::size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+// Directories take a metadata pair
+constexpr std::uint32_t DIRECTORY_BLOCKS = 2;
+
+// LFS1_ERR_NOSPC has the same value
+bool is_out_of_space(std::system_error const & error) noexcept
+{
+    return error.code().category() == littlefs_category()
+           && LFS2_ERR_NOSPC == error.code().value();
+}
+
+// LFS1_ERR_EXIST has the same value
+bool is_already_existing(std::system_error const & error) noexcept
+{
+    return error.code().category() == littlefs_category()
+           && LFS2_ERR_EXIST == error.code().value();
+}
+
+}  // namespace
+
+
+ImagePacker::ImagePacker(LittleFS & filesystem, PackGeometry const & geometry) :
+    _filesystem(filesystem),
+    _geometry(geometry),
+    _required_blocks(geometry.reserved_blocks),
+    _buffer(WRITE_BUFFER_SIZE),
+    _directories({""}),
+    _statistics()
+{
+}
+
+void ImagePacker::reserve_directory()
+{
+    _required_blocks += DIRECTORY_BLOCKS;
+    check_fits("the directory tree");
+}
+
+void ImagePacker::reserve_file(std::uint64_t const size)
+{
+    if (size > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::length_error("File too large for littlefs");
+    }
+
+    if (size > _geometry.inline_max)
+    {
+        _required_blocks += ctz_block_count(_geometry.block_size, static_cast<std::uint32_t>(size));
+    }
+    check_fits("the files");
+}
+
+void ImagePacker::add_directory(std::string const & path)
+{
+    auto const normalized = normalize_path(path);
+    if (normalized.empty())
+    {
+        return;
+    }
+
+    make_parent_directories(normalized);
+
+    if (_directories.count(normalized) == 0)
+    {
+        make_directory(normalized);
+    }
+}
+
+void ImagePacker::add_file(std::string const & path, IInputStream & stream)
+{
+    auto const normalized = normalize_path(path);
+    make_parent_directories(normalized);
+
+    try
+    {
+        auto const file = _filesystem.open_file(normalized,
+                                                LittleFS::OpenFlags::Write
+                                                    | LittleFS::OpenFlags::CreateIfNotExists
+                                                    | LittleFS::OpenFlags::Truncate);
+
+        for (;;)
+        {
+            auto const bytes_read = stream.read(_buffer);
+            if (0 == bytes_read)
+            {
+                break;
+            }
+
+            auto const chunk = gsl::span<std::byte const>(_buffer).first(
+                static_cast<std::ptrdiff_t>(bytes_read));
+            if (file->write(chunk) != bytes_read)
+            {
+                throw std::runtime_error(fmt::format("Short write to {}", normalized));
+            }
+
+            _statistics.bytes += bytes_read;
+        }
+
+        // The final commit happens here, and may still run out of space
+        file->close();
+    }
+    catch (std::system_error const & error)
+    {
+        if (is_out_of_space(error))
+        {
+            throw ImageFullError(fmt::format(
+                "Image is full: {} does not fit in {} blocks", normalized, _geometry.block_count));
+        }
+        throw;
+    }
+
+    ++_statistics.files;
+}
+
+std::string ImagePacker::normalize_path(std::string const & path)
+{
+    std::string::size_type start = 0;
+    for (;;)
+    {
+        if (0 == path.compare(start, 2, "./"))
+        {
+            start += 2;
+        }
+        else if (start < path.size() && '/' == path[start])
+        {
+            ++start;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    auto const end = path.find_last_not_of('/');
+    if (std::string::npos == end || end < start || 0 == path.compare(start, end - start + 1, "."))
+    {
+        return {};
+    }
+
+    return "/" + path.substr(start, end - start + 1);
+}
+
+void ImagePacker::make_parent_directories(std::string const & path)
+{
+    for (auto separator = path.find('/', 1); std::string::npos != separator;
+         separator = path.find('/', separator + 1))
+    {
+        auto parent = path.substr(0, separator);
+        if (_directories.count(parent) == 0)
+        {
+            make_directory(std::move(parent));
+        }
+    }
+}
+
+void ImagePacker::make_directory(std::string path)
+{
+    // The image may already hold some of the tree, for instance when packing on top of a template
+    try
+    {
+        _filesystem.make_directory(path);
+        ++_statistics.directories;
+    }
+    catch (std::system_error const & error)
+    {
+        if (is_out_of_space(error))
+        {
+            throw ImageFullError(fmt::format(
+                "Image is full: {} does not fit in {} blocks", path, _geometry.block_count));
+        }
+        if (!is_already_existing(error))
+        {
+            throw;
+        }
+    }
+
+    _directories.insert(std::move(path));
+}
+
+void ImagePacker::check_fits(std::string const & what) const
+{
+    if (_required_blocks > _geometry.block_count)
+    {
+        throw ImageFullError(
+            fmt::format("Content does not fit: {} need at least {} blocks, but the image has {}",
+                        what,
+                        _required_blocks,
+                        _geometry.block_count));
+    }
+}
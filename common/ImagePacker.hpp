@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <LittleFS.hpp>
+
+#include "IInputStream.hpp"
+
+
+struct PackStatistics
+{
+    std::uint64_t directories {};
+    std::uint64_t files {};
+    std::uint64_t bytes {};
+};
+
+// Space available to a packed image. The packer keeps a lower bound of the
+// blocks its content needs and fails as soon as that exceeds `block_count`.
+struct PackGeometry
+{
+    std::uint32_t block_size {};
+    std::uint32_t block_count {};
+    // Files up to this size are stored in their metadata pair and need no data blocks
+    std::uint32_t inline_max {};
+    // Blocks used by the superblock and root directory
+    std::uint32_t reserved_blocks {};
+};
+
+// Thrown when content does not fit in the image, as opposed to failing to read
+// or write it
+class ImageFullError : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Writes files into a mounted filesystem with large writes, creating parent
+// directories as needed
+class ImagePacker
+{
+private:
+    LittleFS & _filesystem;
+    PackGeometry _geometry;
+    std::uint64_t _required_blocks;
+    std::vector<std::byte> _buffer;
+    std::unordered_set<std::string> _directories;
+    PackStatistics _statistics;
+
+public:
+    ImagePacker(LittleFS & filesystem, PackGeometry const & geometry);
+
+    ImagePacker(ImagePacker const &) = delete;
+    ImagePacker & operator=(ImagePacker const &) = delete;
+
+    // Accounts for content that will be added later, so that an image that
+    // cannot fit is rejected before anything is written
+    void reserve_directory();
+    void reserve_file(std::uint64_t size);
+
+    void add_directory(std::string const & path);
+    void add_file(std::string const & path, IInputStream & stream);
+
+    [[nodiscard]] PackStatistics const & statistics() const noexcept
+    {
+        return _statistics;
+    }
+
+    // Paths inside the image are absolute, even if the source's paths are not
+    [[nodiscard]] static std::string normalize_path(std::string const & path);
+
+private:
+    void make_parent_directories(std::string const & path);
+    void make_directory(std::string path);
+    void check_fits(std::string const & what) const;
+};
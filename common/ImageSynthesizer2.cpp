@@ -0,0 +1,737 @@
+#include "ImageSynthesizer2.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include <fmt/core.h>
+#include <gsl/gsl>
+#include <lfs2.h>
+#include <lfs2_util.h>
+
+#include <Ctz.hpp>
+
+
+namespace {
+
+constexpr std::uint32_t ROOT = 0;
+constexpr std::uint32_t NO_PARENT = 0xffffffff;
+
+// A freshly compacted pair; the other block of the pair is left erased
+constexpr std::uint32_t REVISION = 1;
+
+constexpr std::uint32_t TYPE_REG = 0x001;
+constexpr std::uint32_t TYPE_DIR = 0x002;
+constexpr std::uint32_t TYPE_SUPERBLOCK = 0x0ff;
+constexpr std::uint32_t TYPE_DIRSTRUCT = 0x200;
+constexpr std::uint32_t TYPE_INLINESTRUCT = 0x201;
+constexpr std::uint32_t TYPE_CTZSTRUCT = 0x202;
+constexpr std::uint32_t TYPE_CRC = 0x500;
+constexpr std::uint32_t TYPE_SOFTTAIL = 0x600;
+constexpr std::uint32_t TYPE_HARDTAIL = 0x601;
+
+constexpr std::uint32_t ID_NONE = 0x3ff;
+constexpr std::uint32_t MAX_PAIR_ENTRIES = 0x3fe;
+constexpr std::uint32_t MAX_TAG_SIZE = 0x3fe;
+
+constexpr std::uint32_t WORD_SIZE = sizeof(std::uint32_t);
+constexpr std::uint32_t MIN_BLOCK_SIZE = 128;
+
+constexpr std::string_view SUPERBLOCK_MAGIC = "littlefs";
+
+// Revision count, tail tag, and the smallest CRC tag
+constexpr std::uint32_t PAIR_OVERHEAD = WORD_SIZE + (WORD_SIZE + 2 * WORD_SIZE) + 2 * WORD_SIZE;
+// Name tag with the magic, then the inline superblock struct
+constexpr std::uint32_t SUPERBLOCK_ENTRY_SIZE = WORD_SIZE + 8 + WORD_SIZE + 6 * WORD_SIZE;
+
+constexpr std::size_t VERIFY_BUFFER_SIZE = 64 * 1024;
+
+std::uint32_t make_tag(std::uint32_t const type, std::uint32_t const id, std::uint32_t const size)
+{
+    return (type << 20U) | (id << 10U) | size;
+}
+
+void store_le32(gsl::span<std::byte> const buffer,
+                std::size_t const offset,
+                std::uint32_t const value) noexcept
+{
+    auto const raw = lfs2_tole32(value);
+    std::memcpy(buffer.data() + offset, &raw, sizeof(raw));
+}
+
+gsl::span<std::byte const> as_bytes(std::string_view const string)
+{
+    return gsl::as_bytes(
+        gsl::span<char const>(string.data(), static_cast<std::ptrdiff_t>(string.size())));
+}
+
+template <std::size_t N>
+gsl::span<std::byte const> words(std::uint32_t const (&values)[N])
+{
+    return gsl::as_bytes(gsl::span<std::uint32_t const>(values));
+}
+
+bool read_exactly(IInputStream & stream, gsl::span<std::byte> buffer)
+{
+    while (!buffer.empty())
+    {
+        auto const bytes_read = stream.read(buffer);
+        if (0 == bytes_read)
+        {
+            return false;
+        }
+        buffer = buffer.subspan(static_cast<std::ptrdiff_t>(bytes_read));
+    }
+    return true;
+}
+
+std::vector<std::string> split_path(std::string const & path)
+{
+    std::vector<std::string> components {};
+
+    std::string::size_type start = 0;
+    while (start <= path.size())
+    {
+        auto end = path.find('/', start);
+        if (std::string::npos == end)
+        {
+            end = path.size();
+        }
+
+        auto component = path.substr(start, end - start);
+        if (".." == component)
+        {
+            throw std::invalid_argument(fmt::format("Invalid path: {}", path));
+        }
+        if (!component.empty() && "." != component)
+        {
+            components.push_back(std::move(component));
+        }
+
+        start = end + 1;
+    }
+
+    return components;
+}
+
+// Writes one metadata commit into a block buffer, keeping the running CRC
+class Commit
+{
+private:
+    gsl::span<std::byte> _block;
+    std::uint32_t _offset;
+    std::uint32_t _previous_tag;
+    std::uint32_t _crc;
+
+public:
+    Commit(gsl::span<std::byte> const block, std::uint32_t const revision) :
+        _block(block),
+        _offset(0),
+        _previous_tag(0xffffffff),
+        _crc(0xffffffff)
+    {
+        auto const raw = lfs2_tole32(revision);
+        program(&raw, sizeof(raw));
+    }
+
+    void add(std::uint32_t const type,
+             std::uint32_t const id,
+             gsl::span<std::byte const> const data)
+    {
+        auto const size = static_cast<std::uint32_t>(data.size());
+
+        // Leave room for the CRC tag
+        if (_offset + WORD_SIZE + size + 2 * WORD_SIZE > static_cast<std::size_t>(_block.size()))
+        {
+            throw std::logic_error("Metadata commit overflows its block");
+        }
+
+        auto const tag = make_tag(type, id, size);
+        auto const raw = lfs2_tobe32(tag ^ _previous_tag);
+        program(&raw, sizeof(raw));
+        program(data.data(), size);
+
+        _previous_tag = tag;
+    }
+
+    // Mirrors lfs2_dir_commitcrc: pads the commit up to the program size with
+    // CRC tags. The padding itself is not covered by the CRC.
+    void finish(std::uint32_t const prog_size)
+    {
+        auto const block_size = static_cast<std::uint32_t>(_block.size());
+
+        auto const end = lfs2_alignup(_offset + 2 * WORD_SIZE, prog_size);
+        if (end > block_size)
+        {
+            throw std::logic_error("Metadata commit overflows its block");
+        }
+
+        while (_offset < end)
+        {
+            auto const data_offset = _offset + WORD_SIZE;
+            auto next_offset = std::min(end - data_offset, MAX_TAG_SIZE) + data_offset;
+            if (next_offset < end)
+            {
+                next_offset = std::min(next_offset, end - 2 * WORD_SIZE);
+            }
+
+            // If whatever follows would read as a valid tag, flip the expected valid bit
+            std::uint32_t next = 0xffffffff;
+            if (next_offset + WORD_SIZE <= block_size)
+            {
+                std::memcpy(&next, _block.data() + next_offset, sizeof(next));
+            }
+            auto const reset = (~lfs2_frombe32(next)) >> 31U;
+
+            auto const tag = make_tag(TYPE_CRC + reset, ID_NONE, next_offset - data_offset);
+            auto const raw = lfs2_tobe32(tag ^ _previous_tag);
+            program(&raw, sizeof(raw));
+            store_le32(_block, _offset, _crc);
+
+            _offset = next_offset;
+            _previous_tag = tag ^ (reset << 31U);
+            _crc = 0xffffffff;
+        }
+    }
+
+private:
+    void program(void const * const data, std::uint32_t const size)
+    {
+        std::memcpy(_block.data() + _offset, data, size);
+        _crc = lfs2_crc(_crc, data, size);
+        _offset += size;
+    }
+};
+
+}  // namespace
+
+
+struct ImageSynthesizer2::Pair
+{
+    std::uint32_t directory {};
+    std::size_t first_child {};
+    std::size_t child_count {};
+    std::uint32_t block {};
+    bool has_superblock {};
+};
+
+// Where everything goes: the metadata pairs first, then the data of every
+// non-inline file, in order
+struct ImageSynthesizer2::Layout
+{
+    std::vector<std::uint32_t> files {};
+    std::vector<Pair> pairs {};
+    std::uint64_t block_count {};
+};
+
+
+ImageSynthesizer2::ImageSynthesizer2(Geometry const & geometry) :
+    _geometry(geometry),
+    _inline_max(0),
+    _nodes(),
+    _paths()
+{
+    if (_geometry.block_size < MIN_BLOCK_SIZE)
+    {
+        throw std::invalid_argument("littlefs needs blocks of at least 128 bytes");
+    }
+    if (0 == _geometry.prog_size || 0 != _geometry.block_size % _geometry.prog_size)
+    {
+        throw std::invalid_argument("Block size must be a multiple of the prog size");
+    }
+    if (0 == _geometry.cache_size)
+    {
+        _geometry.cache_size = _geometry.block_size;
+    }
+
+    // Same threshold lfs2 uses when deciding to move a growing file out of its metadata pair
+    _inline_max = std::min({MAX_TAG_SIZE, _geometry.cache_size, _geometry.block_size / 8});
+
+    Node root {};
+    root.parent = NO_PARENT;
+    root.is_directory = true;
+    _nodes.push_back(std::move(root));
+    _paths.emplace("", ROOT);
+}
+
+void ImageSynthesizer2::add_directory(std::string const & path)
+{
+    directory_for(path);
+}
+
+void ImageSynthesizer2::add_file(std::string const & path,
+                                 std::uint32_t const size,
+                                 ContentSource source)
+{
+    if (size > LFS2_FILE_MAX)
+    {
+        throw std::length_error(fmt::format("File too large: {}", path));
+    }
+
+    auto components = split_path(path);
+    if (components.empty())
+    {
+        throw std::invalid_argument(fmt::format("Invalid file path: {}", path));
+    }
+
+    auto name = std::move(components.back());
+    components.pop_back();
+
+    std::string parent_path {};
+    for (auto const & component : components)
+    {
+        parent_path += (parent_path.empty() ? "" : "/") + component;
+    }
+    auto const parent = directory_for(parent_path);
+
+    auto const key = (parent_path.empty() ? "" : parent_path + "/") + name;
+    auto const existing = _paths.find(key);
+
+    std::uint32_t index = 0;
+    if (_paths.end() == existing)
+    {
+        index = add_node(parent, std::move(name), false);
+        _paths.emplace(key, index);
+    }
+    else
+    {
+        index = existing->second;
+        if (_nodes[index].is_directory)
+        {
+            throw std::invalid_argument(fmt::format("{} is a directory", path));
+        }
+    }
+
+    _nodes[index].size = size;
+    _nodes[index].source = std::move(source);
+}
+
+void ImageSynthesizer2::set_block_count(std::uint32_t const block_count) noexcept
+{
+    _geometry.block_count = block_count;
+}
+
+std::uint32_t ImageSynthesizer2::required_blocks()
+{
+    auto const layout = plan();
+    return static_cast<std::uint32_t>(
+        std::min<std::uint64_t>(layout.block_count, std::numeric_limits<std::uint32_t>::max()));
+}
+
+std::uint32_t ImageSynthesizer2::write(IBlockDevice & block_device)
+{
+    if (block_device.block_size() != _geometry.block_size
+        || block_device.block_count() != _geometry.block_count)
+    {
+        throw std::invalid_argument("Block device geometry does not match");
+    }
+
+    auto const layout = plan();
+    if (layout.block_count > _geometry.block_count)
+    {
+        throw std::runtime_error(
+            fmt::format("Content does not fit: it needs {} blocks, but the image has {}",
+                        layout.block_count,
+                        _geometry.block_count));
+    }
+
+    std::vector<std::byte> buffer(_geometry.block_size);
+    for (std::size_t index = 0; index < layout.pairs.size(); ++index)
+    {
+        write_pair(block_device, layout.pairs, index, buffer);
+    }
+    for (auto const file : layout.files)
+    {
+        write_file(block_device, _nodes[file], buffer);
+    }
+    block_device.sync();
+
+    return static_cast<std::uint32_t>(layout.block_count);
+}
+
+void ImageSynthesizer2::verify(LittleFS & filesystem) const
+{
+    std::vector<std::uint32_t> to_visit {ROOT};
+    while (!to_visit.empty())
+    {
+        auto const current = to_visit.back();
+        to_visit.pop_back();
+
+        auto const directory_path = path(current);
+
+        std::unordered_map<std::string, LittleFS::DirectoryEntry> listing {};
+        for (auto & entry : filesystem.list_directory(directory_path))
+        {
+            if (entry.name != "." && entry.name != "..")
+            {
+                auto name = entry.name;
+                listing.emplace(std::move(name), std::move(entry));
+            }
+        }
+
+        auto const & children = _nodes[current].children;
+        if (listing.size() != children.size())
+        {
+            throw std::runtime_error(
+                fmt::format("Verification failed: {} has {} entries instead of {}",
+                            directory_path,
+                            listing.size(),
+                            children.size()));
+        }
+
+        for (auto const child : children)
+        {
+            auto const & node = _nodes[child];
+
+            auto const entry = listing.find(node.name);
+            if (listing.end() == entry || entry->second.is_directory != node.is_directory
+                || (!node.is_directory && entry->second.size != node.size))
+            {
+                throw std::runtime_error(
+                    fmt::format("Verification failed: {} is missing or differs", path(child)));
+            }
+
+            if (node.is_directory)
+            {
+                to_visit.push_back(child);
+            }
+            else
+            {
+                verify_file(filesystem, child);
+            }
+        }
+    }
+}
+
+std::uint32_t ImageSynthesizer2::directory_for(std::string const & path)
+{
+    auto current = ROOT;
+    std::string key {};
+
+    for (auto & component : split_path(path))
+    {
+        key += (key.empty() ? "" : "/") + component;
+
+        auto const existing = _paths.find(key);
+        if (_paths.end() != existing)
+        {
+            current = existing->second;
+            if (!_nodes[current].is_directory)
+            {
+                throw std::invalid_argument(fmt::format("{} is not a directory", key));
+            }
+            continue;
+        }
+
+        current = add_node(current, std::move(component), true);
+        _paths.emplace(key, current);
+    }
+
+    return current;
+}
+
+std::uint32_t ImageSynthesizer2::add_node(std::uint32_t const parent,
+                                          std::string name,
+                                          bool const is_directory)
+{
+    if (name.size() > LFS2_NAME_MAX)
+    {
+        throw std::length_error(fmt::format("Name too long: {}", name));
+    }
+
+    auto const index = static_cast<std::uint32_t>(_nodes.size());
+
+    Node node {};
+    node.parent = parent;
+    node.name = std::move(name);
+    node.is_directory = is_directory;
+    _nodes.push_back(std::move(node));
+
+    _nodes[parent].children.push_back(index);
+
+    return index;
+}
+
+bool ImageSynthesizer2::is_inline(Node const & node) const noexcept
+{
+    return node.size <= _inline_max;
+}
+
+std::uint32_t ImageSynthesizer2::entry_size(Node const & node) const noexcept
+{
+    auto const name_tag = WORD_SIZE + static_cast<std::uint32_t>(node.name.size());
+    auto const struct_size = (!node.is_directory && is_inline(node)) ? node.size : 2 * WORD_SIZE;
+
+    return name_tag + WORD_SIZE + struct_size;
+}
+
+std::string ImageSynthesizer2::path(std::uint32_t index) const
+{
+    if (ROOT == index)
+    {
+        return "/";
+    }
+
+    std::string result {};
+    for (; ROOT != index; index = _nodes[index].parent)
+    {
+        result.insert(0, "/" + _nodes[index].name);
+    }
+    return result;
+}
+
+ImageSynthesizer2::Layout ImageSynthesizer2::plan()
+{
+    Layout layout {};
+
+    // Pre-order walk with every directory's entries sorted by name, the order
+    // lfs2 keeps them in and lists them
+    std::vector<std::uint32_t> directories {};
+
+    std::vector<std::uint32_t> to_visit {ROOT};
+    while (!to_visit.empty())
+    {
+        auto const current = to_visit.back();
+        to_visit.pop_back();
+        directories.push_back(current);
+
+        auto & children = _nodes[current].children;
+        std::sort(children.begin(),
+                  children.end(),
+                  [this](std::uint32_t const first, std::uint32_t const second) {
+                      return _nodes[first].name < _nodes[second].name;
+                  });
+
+        for (auto const child : children)
+        {
+            if (!_nodes[child].is_directory && !is_inline(_nodes[child]))
+            {
+                layout.files.push_back(child);
+            }
+        }
+        for (auto child = children.rbegin(); child != children.rend(); ++child)
+        {
+            if (_nodes[*child].is_directory)
+            {
+                to_visit.push_back(*child);
+            }
+        }
+    }
+
+    layout.pairs = plan_metadata(directories);
+
+    layout.block_count = static_cast<std::uint64_t>(2 * layout.pairs.size());
+    for (auto const file : layout.files)
+    {
+        _nodes[file].block = static_cast<std::uint32_t>(
+            std::min<std::uint64_t>(layout.block_count, std::numeric_limits<std::uint32_t>::max()));
+        layout.block_count += ctz_block_count(_geometry.block_size, _nodes[file].size);
+    }
+
+    return layout;
+}
+
+std::vector<ImageSynthesizer2::Pair>
+    ImageSynthesizer2::plan_metadata(std::vector<std::uint32_t> const & directories)
+{
+    // lfs2 splits a directory when compacting it would take more than this
+    auto const budget = std::min(_geometry.block_size - 36,
+                                 lfs2_alignup(_geometry.block_size / 2, _geometry.prog_size));
+
+    std::vector<Pair> pairs {};
+    for (auto const directory : directories)
+    {
+        auto const & children = _nodes[directory].children;
+
+        Pair pair {};
+        pair.directory = directory;
+        pair.has_superblock = (ROOT == directory);
+
+        auto used = PAIR_OVERHEAD + (pair.has_superblock ? SUPERBLOCK_ENTRY_SIZE : 0);
+        auto ids = pair.has_superblock ? 1U : 0U;
+
+        for (std::size_t index = 0; index < children.size(); ++index)
+        {
+            auto const size = entry_size(_nodes[children[index]]);
+
+            if (pair.child_count > 0 && (used + size > budget || ids == MAX_PAIR_ENTRIES))
+            {
+                pairs.push_back(pair);
+
+                pair = {};
+                pair.directory = directory;
+                pair.first_child = index;
+                used = PAIR_OVERHEAD;
+                ids = 0;
+            }
+
+            // A single entry still has to fit in a block, padding included
+            if (lfs2_alignup(used + size, _geometry.prog_size) > _geometry.block_size)
+            {
+                throw std::runtime_error(fmt::format(
+                    "{} does not fit in a metadata block", path(children[index])));
+            }
+
+            used += size;
+            ++ids;
+            ++pair.child_count;
+        }
+
+        pairs.push_back(pair);
+    }
+
+    // Pairs occupy consecutive blocks right from the start, so the root lands on {0, 1}
+    for (std::size_t index = 0; index < pairs.size(); ++index)
+    {
+        pairs[index].block = static_cast<std::uint32_t>(2 * index);
+        if (0 == pairs[index].first_child)
+        {
+            _nodes[pairs[index].directory].block = pairs[index].block;
+        }
+    }
+
+    return pairs;
+}
+
+void ImageSynthesizer2::write_pair(IBlockDevice & block_device,
+                                   std::vector<Pair> const & pairs,
+                                   std::size_t const index,
+                                   std::vector<std::byte> & buffer) const
+{
+    auto const & pair = pairs[index];
+
+    std::fill(buffer.begin(), buffer.end(), std::byte {0xff});
+    Commit commit(buffer, REVISION);
+
+    std::uint32_t id = 0;
+    if (pair.has_superblock)
+    {
+        std::uint32_t const superblock[] = {
+            lfs2_tole32(LFS2_DISK_VERSION),
+            lfs2_tole32(_geometry.block_size),
+            lfs2_tole32(_geometry.block_count),
+            lfs2_tole32(LFS2_NAME_MAX),
+            lfs2_tole32(LFS2_FILE_MAX),
+            lfs2_tole32(LFS2_ATTR_MAX),
+        };
+
+        commit.add(TYPE_SUPERBLOCK, id, as_bytes(SUPERBLOCK_MAGIC));
+        commit.add(TYPE_INLINESTRUCT, id, words(superblock));
+        ++id;
+    }
+
+    auto const & children = _nodes[pair.directory].children;
+    std::vector<std::byte> inline_data {};
+    for (auto child = pair.first_child; child < pair.first_child + pair.child_count; ++child)
+    {
+        auto const & node = _nodes[children[child]];
+
+        commit.add(node.is_directory ? TYPE_DIR : TYPE_REG, id, as_bytes(node.name));
+
+        if (node.is_directory)
+        {
+            std::uint32_t const directory_struct[] = {lfs2_tole32(node.block),
+                                                      lfs2_tole32(node.block + 1)};
+            commit.add(TYPE_DIRSTRUCT, id, words(directory_struct));
+        }
+        else if (is_inline(node))
+        {
+            inline_data.resize(node.size);
+            if (node.size > 0 && !read_exactly(*node.source(), inline_data))
+            {
+                throw std::runtime_error(
+                    fmt::format("{} is shorter than expected", path(children[child])));
+            }
+            commit.add(TYPE_INLINESTRUCT, id, inline_data);
+        }
+        else
+        {
+            auto const head = node.block + ctz_block_count(_geometry.block_size, node.size) - 1;
+            std::uint32_t const ctz_struct[] = {lfs2_tole32(head), lfs2_tole32(node.size)};
+            commit.add(TYPE_CTZSTRUCT, id, words(ctz_struct));
+        }
+
+        ++id;
+    }
+
+    // Thread every pair into one list. Splits of the same directory are hard
+    // tails; moving on to the next directory is a soft tail.
+    if (index + 1 < pairs.size())
+    {
+        auto const & next = pairs[index + 1];
+        std::uint32_t const tail[] = {lfs2_tole32(next.block), lfs2_tole32(next.block + 1)};
+        commit.add((next.directory == pair.directory) ? TYPE_HARDTAIL : TYPE_SOFTTAIL,
+                   ID_NONE,
+                   words(tail));
+    }
+
+    commit.finish(_geometry.prog_size);
+
+    block_device.erase(pair.block);
+    block_device.program(pair.block, 0, buffer.data(), _geometry.block_size);
+    block_device.erase(pair.block + 1);
+}
+
+void ImageSynthesizer2::write_file(IBlockDevice & block_device,
+                                   Node const & node,
+                                   std::vector<std::byte> & buffer) const
+{
+    auto const stream = node.source();
+    auto const block_count = ctz_block_count(_geometry.block_size, node.size);
+
+    auto remaining = node.size;
+    for (std::uint32_t index = 0; index < block_count; ++index)
+    {
+        std::fill(buffer.begin(), buffer.end(), std::byte {0xff});
+
+        // Blocks are contiguous, so pointer N simply goes back 2^N blocks
+        auto const data_offset = ctz_data_offset(index);
+        for (std::uint32_t pointer = 0; pointer < data_offset / WORD_SIZE; ++pointer)
+        {
+            store_le32(buffer, pointer * WORD_SIZE, node.block + index - (1U << pointer));
+        }
+
+        auto const chunk = std::min(_geometry.block_size - data_offset, remaining);
+        auto const data = gsl::span<std::byte>(buffer).subspan(data_offset, chunk);
+        if (!read_exactly(*stream, data))
+        {
+            throw std::runtime_error(fmt::format("{} is shorter than expected", node.name));
+        }
+        remaining -= chunk;
+
+        block_device.erase(node.block + index);
+        block_device.program(node.block + index, 0, buffer.data(), _geometry.block_size);
+    }
+}
+
+void ImageSynthesizer2::verify_file(LittleFS & filesystem, std::uint32_t const index) const
+{
+    auto const file_path = path(index);
+
+    auto const file = filesystem.open_file(file_path, LittleFS::OpenFlags::Read);
+    auto const expected = _nodes[index].source();
+
+    std::vector<std::byte> actual_buffer(VERIFY_BUFFER_SIZE);
+    std::vector<std::byte> expected_buffer(VERIFY_BUFFER_SIZE);
+    for (;;)
+    {
+        auto const bytes_read = file->read(actual_buffer);
+        if (0 == bytes_read)
+        {
+            break;
+        }
+
+        auto const expected_data =
+            gsl::span<std::byte>(expected_buffer).first(static_cast<std::ptrdiff_t>(bytes_read));
+        if (!read_exactly(*expected, expected_data)
+            || 0 != std::memcmp(actual_buffer.data(), expected_data.data(), bytes_read))
+        {
+            throw std::runtime_error(
+                fmt::format("Verification failed: contents of {} differ", file_path));
+        }
+    }
+}
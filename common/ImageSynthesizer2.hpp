@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <IBlockDevice.hpp>
+#include <LittleFS.hpp>
+
+#include "IInputStream.hpp"
+
+
+// Compiles a complete file tree straight into a littlefs v2 image, without
+// going through lfs2's commit machinery. Every directory becomes one or more
+// fully compacted metadata pairs, placed right after the superblock. File data
+// follows in contiguous CTZ skip-lists, in directory order. The image is
+// emitted in a single pass over ascending block numbers.
+class ImageSynthesizer2
+{
+public:
+    // Opens a file's contents. Called once when writing, and again when verifying.
+    using ContentSource = std::function<std::unique_ptr<IInputStream>()>;
+
+    struct Geometry
+    {
+        std::uint32_t block_size {};
+        std::uint32_t block_count {};
+        std::uint32_t prog_size {};
+        // 0 means the block size, as in LittleFS2
+        std::uint32_t cache_size {};
+    };
+
+private:
+    struct Node
+    {
+        std::uint32_t parent {};
+        std::string name {};
+        bool is_directory {};
+        std::uint32_t size {};
+        ContentSource source {};
+        std::vector<std::uint32_t> children {};
+        // First metadata block of a directory, or first data block of a file
+        std::uint32_t block {};
+    };
+
+    struct Pair;
+    struct Layout;
+
+    Geometry _geometry;
+    std::uint32_t _inline_max;
+    std::vector<Node> _nodes;
+    std::unordered_map<std::string, std::uint32_t> _paths;
+
+public:
+    explicit ImageSynthesizer2(Geometry const & geometry);
+
+    ImageSynthesizer2(ImageSynthesizer2 const &) = delete;
+    ImageSynthesizer2 & operator=(ImageSynthesizer2 const &) = delete;
+
+    // Missing parent directories are created implicitly. Adding a file twice
+    // replaces its contents.
+    void add_directory(std::string const & path);
+    void add_file(std::string const & path, std::uint32_t size, ContentSource source);
+
+    // The block count recorded in the superblock. Must match the device written to.
+    void set_block_count(std::uint32_t block_count) noexcept;
+
+    // Smallest block count that holds everything added so far
+    [[nodiscard]] std::uint32_t required_blocks();
+
+    // Lays out and writes the whole image. Returns the number of blocks in use.
+    std::uint32_t write(IBlockDevice & block_device);
+
+    // Checks that a mounted image holds exactly the tree that was added
+    void verify(LittleFS & filesystem) const;
+
+private:
+    std::uint32_t directory_for(std::string const & path);
+    std::uint32_t add_node(std::uint32_t parent, std::string name, bool is_directory);
+
+    [[nodiscard]] bool is_inline(Node const & node) const noexcept;
+    [[nodiscard]] std::uint32_t entry_size(Node const & node) const noexcept;
+    [[nodiscard]] std::string path(std::uint32_t index) const;
+
+    Layout plan();
+    std::vector<Pair> plan_metadata(std::vector<std::uint32_t> const & directories);
+    void write_pair(IBlockDevice & block_device,
+                    std::vector<Pair> const & pairs,
+                    std::size_t index,
+                    std::vector<std::byte> & buffer) const;
+    void write_file(IBlockDevice & block_device,
+                    Node const & node,
+                    std::vector<std::byte> & buffer) const;
+    void verify_file(LittleFS & filesystem, std::uint32_t index) const;
+};
@@ -0,0 +1,92 @@
+#include "InputArchive.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+
+namespace {
+
+std::unique_ptr<archive, decltype(&archive_read_free)> create_archive_object()
+{
+    auto const object = archive_read_new();
+    if (nullptr == object)
+    {
+        throw std::runtime_error("archive_read_new");
+    }
+    return {object, &archive_read_free};
+}
+
+}  // namespace
+
+
+InputArchive::InputArchive(CFile file) :
+    _file(std::move(file)),
+    _archive(create_archive_object()),
+    _remaining(0)
+{
+    auto result = archive_read_support_filter_all(_archive.get());
+    if (result < 0)
+    {
+        throw std::runtime_error(archive_error_string(_archive.get()));
+    }
+
+    result = archive_read_support_format_all(_archive.get());
+    if (result < 0)
+    {
+        throw std::runtime_error(archive_error_string(_archive.get()));
+    }
+
+    result = archive_read_open_FILE(_archive.get(), _file.handle());
+    if (result < 0)
+    {
+        throw std::runtime_error(archive_error_string(_archive.get()));
+    }
+}
+
+std::optional<InputArchive::Entry> InputArchive::next_entry()
+{
+    archive_entry * entry = nullptr;
+
+    auto const result = archive_read_next_header(_archive.get(), &entry);
+    if (ARCHIVE_EOF == result)
+    {
+        _remaining = 0;
+        return {};
+    }
+    if (result < ARCHIVE_WARN)
+    {
+        throw std::runtime_error(archive_error_string(_archive.get()));
+    }
+
+    auto const file_type = archive_entry_filetype(entry);
+    auto const size = archive_entry_size_is_set(entry) ? archive_entry_size(entry) : 0;
+
+    Entry output {};
+    output.path = archive_entry_pathname(entry);
+    output.is_directory = (AE_IFDIR == file_type);
+    output.is_regular_file = (AE_IFREG == file_type);
+    output.size = static_cast<std::uint64_t>(size < 0 ? 0 : size);
+
+    _remaining = output.is_regular_file ? output.size : 0;
+
+    return output;
+}
+
+std::size_t InputArchive::read(gsl::span<std::byte> buffer)
+{
+    auto const bytes_read = archive_read_data(
+        _archive.get(), buffer.data(), static_cast<std::size_t>(buffer.size()));
+    if (bytes_read < 0)
+    {
+        throw std::runtime_error(archive_error_string(_archive.get()));
+    }
+
+    auto const result = static_cast<std::size_t>(bytes_read);
+    _remaining -= std::min<std::uint64_t>(_remaining, result);
+    return result;
+}
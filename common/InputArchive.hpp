@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <archive.h>
+#include <gsl/gsl>
+
+#include "CFile.hpp"
+#include "IInputStream.hpp"
+
+
+// Reads an archive in any format libarchive understands. The contents of the
+// current entry are read through the IInputStream interface.
+class InputArchive : public IInputStream
+{
+public:
+    struct Entry
+    {
+        std::string path {};
+        bool is_directory {};
+        bool is_regular_file {};
+        std::uint64_t size {};
+    };
+
+private:
+    CFile _file;
+    std::unique_ptr<archive, decltype(&archive_read_free)> _archive;
+    std::uint64_t _remaining;
+
+public:
+    explicit InputArchive(CFile file);
+
+    ~InputArchive() override = default;
+
+    InputArchive(InputArchive const &) = delete;
+    InputArchive & operator=(InputArchive const &) = delete;
+
+    // Advances to the next entry, skipping whatever is left of the current one
+    std::optional<Entry> next_entry();
+
+    std::size_t read(gsl::span<std::byte> buffer) override;
+
+    [[nodiscard]] std::size_t remaining() const override
+    {
+        return static_cast<std::size_t>(_remaining);
+    }
+};
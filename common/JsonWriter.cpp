@@ -0,0 +1,175 @@
+#include "JsonWriter.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+
+JsonWriter::JsonWriter(std::ostream & stream) : _stream(stream), _has_members(), _after_key(false)
+{
+}
+
+JsonWriter & JsonWriter::begin_object()
+{
+    separate();
+    _stream << '{';
+    _has_members.push_back(false);
+    return *this;
+}
+
+JsonWriter & JsonWriter::end_object()
+{
+    if (_has_members.empty())
+    {
+        throw std::logic_error("Unbalanced JSON object");
+    }
+    _has_members.pop_back();
+    _stream << '}';
+    return *this;
+}
+
+JsonWriter & JsonWriter::begin_array()
+{
+    separate();
+    _stream << '[';
+    _has_members.push_back(false);
+    return *this;
+}
+
+JsonWriter & JsonWriter::end_array()
+{
+    if (_has_members.empty())
+    {
+        throw std::logic_error("Unbalanced JSON array");
+    }
+    _has_members.pop_back();
+    _stream << ']';
+    return *this;
+}
+
+JsonWriter & JsonWriter::key(std::string_view const name)
+{
+    separate();
+    write_string(name);
+    _stream << ':';
+    _after_key = true;
+    return *this;
+}
+
+JsonWriter & JsonWriter::value(std::string_view const text)
+{
+    separate();
+    write_string(text);
+    return *this;
+}
+
+JsonWriter & JsonWriter::value(char const * const text)
+{
+    return value(std::string_view(text));
+}
+
+JsonWriter & JsonWriter::value(bool const flag)
+{
+    separate();
+    _stream << (flag ? "true" : "false");
+    return *this;
+}
+
+JsonWriter & JsonWriter::value(std::uint64_t const number)
+{
+    separate();
+    _stream << number;
+    return *this;
+}
+
+JsonWriter & JsonWriter::value(std::int64_t const number)
+{
+    separate();
+    _stream << number;
+    return *this;
+}
+
+JsonWriter & JsonWriter::value(std::uint32_t const number)
+{
+    return value(static_cast<std::uint64_t>(number));
+}
+
+JsonWriter & JsonWriter::value(double const number)
+{
+    if (!std::isfinite(number))
+    {
+        return null();
+    }
+
+    separate();
+    _stream << fmt::format("{}", number);
+    return *this;
+}
+
+JsonWriter & JsonWriter::null()
+{
+    separate();
+    _stream << "null";
+    return *this;
+}
+
+void JsonWriter::separate()
+{
+    if (_after_key)
+    {
+        _after_key = false;
+        return;
+    }
+
+    if (!_has_members.empty())
+    {
+        if (_has_members.back())
+        {
+            _stream << ',';
+        }
+        _has_members.back() = true;
+    }
+}
+
+void JsonWriter::write_string(std::string_view const text)
+{
+    _stream << '"';
+    for (auto const character : text)
+    {
+        switch (character)
+        {
+        case '"':
+            _stream << "\\\"";
+            break;
+
+        case '\\':
+            _stream << "\\\\";
+            break;
+
+        case '\n':
+            _stream << "\\n";
+            break;
+
+        case '\r':
+            _stream << "\\r";
+            break;
+
+        case '\t':
+            _stream << "\\t";
+            break;
+
+        default:
+            if (static_cast<unsigned char>(character) < 0x20)
+            {
+                _stream << fmt::format("\\u{:04x}", static_cast<unsigned>(character));
+            }
+            else
+            {
+                _stream << character;
+            }
+            break;
+        }
+    }
+    _stream << '"';
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+
+// Streams compact JSON to an output stream. Commas and string escaping are
+// handled here; nesting is the caller's responsibility.
+class JsonWriter final
+{
+private:
+    std::ostream & _stream;
+    std::vector<bool> _has_members;
+    bool _after_key;
+
+public:
+    explicit JsonWriter(std::ostream & stream);
+
+    JsonWriter & begin_object();
+    JsonWriter & end_object();
+    JsonWriter & begin_array();
+    JsonWriter & end_array();
+
+    JsonWriter & key(std::string_view name);
+
+    JsonWriter & value(std::string_view text);
+    JsonWriter & value(char const * text);
+    JsonWriter & value(bool flag);
+    JsonWriter & value(std::uint64_t number);
+    JsonWriter & value(std::int64_t number);
+    JsonWriter & value(std::uint32_t number);
+    JsonWriter & value(double number);
+    JsonWriter & null();
+
+    // Shorthand for key(name).value(content)
+    template <typename T>
+    JsonWriter & member(std::string_view name, T const & content)
+    {
+        return key(name).value(content);
+    }
+
+private:
+    void separate();
+    void write_string(std::string_view text);
+};
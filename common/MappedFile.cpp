@@ -0,0 +1,161 @@
+#include "MappedFile.hpp"
+
+#include <cerrno>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#if defined(_MSC_VER)
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <gsl/gsl>
+
+#if defined(_MSC_VER)
+    #include "Unicode.hpp"
+#endif
+
+
+namespace {
+
+#if defined(_MSC_VER)
+
+std::pair<void *, std::size_t> map_file(std::string const & path)
+{
+    auto const file = CreateFileW(utf8_to_wide_char(path).c_str(),
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL,
+                                  nullptr);
+    if (INVALID_HANDLE_VALUE == file)
+    {
+        throw std::system_error(static_cast<int>(GetLastError()),
+                                std::system_category(),
+                                "CreateFileW");
+    }
+    auto const close_file = gsl::finally([file]() { CloseHandle(file); });
+
+    LARGE_INTEGER size {};
+    if (!GetFileSizeEx(file, &size))
+    {
+        throw std::system_error(static_cast<int>(GetLastError()),
+                                std::system_category(),
+                                "GetFileSizeEx");
+    }
+    if (0 == size.QuadPart)
+    {
+        return {nullptr, 0};
+    }
+
+    auto const mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == mapping)
+    {
+        throw std::system_error(static_cast<int>(GetLastError()),
+                                std::system_category(),
+                                "CreateFileMappingW");
+    }
+    auto const close_mapping = gsl::finally([mapping]() { CloseHandle(mapping); });
+
+    auto const address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == address)
+    {
+        throw std::system_error(static_cast<int>(GetLastError()),
+                                std::system_category(),
+                                "MapViewOfFile");
+    }
+
+    return {address, static_cast<std::size_t>(size.QuadPart)};
+}
+
+void unmap_file(void * address, std::size_t)
+{
+    UnmapViewOfFile(address);
+}
+
+#else
+
+std::pair<void *, std::size_t> map_file(std::string const & path)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg): Gotta do it
+    auto const fd = open(path.c_str(), O_RDONLY);
+    if (-1 == fd)
+    {
+        throw std::system_error(errno, std::system_category(), "open");
+    }
+    auto const close_fd = gsl::finally([fd]() { close(fd); });
+
+    struct stat status {};
+    if (-1 == fstat(fd, &status))
+    {
+        throw std::system_error(errno, std::system_category(), "fstat");
+    }
+    if (0 == status.st_size)
+    {
+        return {nullptr, 0};
+    }
+
+    auto const size = static_cast<std::size_t>(status.st_size);
+    auto * const address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast): MAP_FAILED is a macro
+    if (MAP_FAILED == address)
+    {
+        throw std::system_error(errno, std::system_category(), "mmap");
+    }
+
+    return {address, size};
+}
+
+void unmap_file(void * address, std::size_t size)
+{
+    munmap(address, size);
+}
+
+#endif
+
+}  // namespace
+
+
+MappedFile::MappedFile(std::string const & path) : _address(nullptr), _size(0)
+{
+    std::tie(_address, _size) = map_file(path);
+}
+
+MappedFile::~MappedFile()
+{
+    if (nullptr != _address)
+    {
+        unmap_file(_address, _size);
+    }
+}
+
+MappedFile::MappedFile(MappedFile && other) noexcept :
+    _address(std::exchange(other._address, nullptr)),
+    _size(std::exchange(other._size, 0))
+{
+}
+
+MappedFile & MappedFile::operator=(MappedFile && other) noexcept
+{
+    if (this != &other)
+    {
+        if (nullptr != _address)
+        {
+            unmap_file(_address, _size);
+        }
+        _address = std::exchange(other._address, nullptr);
+        _size = std::exchange(other._size, 0);
+    }
+    return *this;
+}
+
+gsl::span<std::byte const> MappedFile::data() const noexcept
+{
+    return {static_cast<std::byte const *>(_address), static_cast<std::ptrdiff_t>(_size)};
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <gsl/gsl>
+
+
+// A read-only memory mapping of a whole file.
+class MappedFile final
+{
+private:
+    void * _address;
+    std::size_t _size;
+
+public:
+    explicit MappedFile(std::string const & path);
+    ~MappedFile();
+
+    MappedFile(MappedFile && other) noexcept;
+    MappedFile & operator=(MappedFile && other) noexcept;
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile & operator=(MappedFile const &) = delete;
+
+    [[nodiscard]] gsl::span<std::byte const> data() const noexcept;
+};
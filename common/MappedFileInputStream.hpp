@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <gsl/gsl>
+
+#include "IInputStream.hpp"
+#include "MappedFile.hpp"
+#include "MemoryInputStream.hpp"
+
+
+class MappedFileInputStream : public IInputStream
+{
+private:
+    MappedFile _file;
+    MemoryInputStream _stream;
+
+public:
+    explicit MappedFileInputStream(std::string const & path) : _file(path), _stream(_file.data())
+    {
+    }
+
+    std::size_t read(gsl::span<std::byte> buffer) override
+    {
+        return _stream.read(buffer);
+    }
+
+    [[nodiscard]] std::size_t remaining() const override
+    {
+        return _stream.remaining();
+    }
+};
@@ -0,0 +1,71 @@
+#include "MemoryBlockDevice.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+MemoryBlockDevice::MemoryBlockDevice(std::uint32_t const block_size,
+                                     std::uint32_t const block_count) :
+    _data(static_cast<std::size_t>(block_size) * static_cast<std::size_t>(block_count),
+          ERASED_VALUE),
+    _block_size(block_size),
+    _block_count(block_count)
+{
+}
+
+void MemoryBlockDevice::read(std::uint32_t block,
+                             std::uint32_t offset,
+                             void * buffer,
+                             std::uint32_t size)
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid read range");
+    }
+
+    auto const position = static_cast<std::size_t>(block) * static_cast<std::size_t>(_block_size)
+                          + static_cast<std::size_t>(offset);
+    std::memcpy(buffer, _data.data() + position, size);
+}
+
+void MemoryBlockDevice::program(std::uint32_t block,
+                                std::uint32_t offset,
+                                void const * buffer,
+                                std::uint32_t size)
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid write range");
+    }
+
+    auto const position = static_cast<std::size_t>(block) * static_cast<std::size_t>(_block_size)
+                          + static_cast<std::size_t>(offset);
+    std::memcpy(_data.data() + position, buffer, size);
+}
+
+void MemoryBlockDevice::erase(std::uint32_t block)
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    auto const begin = _data.begin()
+                       + static_cast<std::ptrdiff_t>(static_cast<std::size_t>(block) * _block_size);
+    std::fill(begin, begin + _block_size, ERASED_VALUE);
+}
+
+void MemoryBlockDevice::sync()
+{
+}
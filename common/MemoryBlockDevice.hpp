@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+
+
+// A block device backed by a single contiguous buffer. Erased blocks read as 0xff.
+class MemoryBlockDevice : public IBlockDevice
+{
+private:
+    std::vector<std::byte> _data;
+    std::uint32_t _block_size;
+    std::uint32_t _block_count;
+
+public:
+    MemoryBlockDevice(std::uint32_t block_size, std::uint32_t block_count);
+    ~MemoryBlockDevice() override = default;
+
+    MemoryBlockDevice(MemoryBlockDevice const &) = delete;
+    MemoryBlockDevice & operator=(MemoryBlockDevice const &) = delete;
+
+    void
+        read(std::uint32_t block, std::uint32_t offset, void * buffer, std::uint32_t size) override;
+    void program(std::uint32_t block,
+                 std::uint32_t offset,
+                 void const * buffer,
+                 std::uint32_t size) override;
+    void erase(std::uint32_t block) override;
+    void sync() override;
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept override
+    {
+        return _block_size;
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept override
+    {
+        return _block_count;
+    }
+
+    [[nodiscard]] gsl::span<std::byte const> data() const noexcept
+    {
+        return _data;
+    }
+
+    [[nodiscard]] gsl::span<std::byte> data() noexcept
+    {
+        return _data;
+    }
+
+    static constexpr std::byte ERASED_VALUE {0xff};
+};
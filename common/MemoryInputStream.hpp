@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include <gsl/gsl>
+
+#include "IInputStream.hpp"
+
+
+class MemoryInputStream : public IInputStream
+{
+private:
+    gsl::span<std::byte const> _data;
+    std::size_t _position;
+
+public:
+    explicit MemoryInputStream(gsl::span<std::byte const> data) : _data(data), _position(0)
+    {
+    }
+
+    std::size_t read(gsl::span<std::byte> buffer) override
+    {
+        auto const to_copy = std::min(static_cast<std::size_t>(buffer.size()), remaining());
+        std::memcpy(buffer.data(), _data.data() + _position, to_copy);
+        _position += to_copy;
+        return to_copy;
+    }
+
+    [[nodiscard]] std::size_t remaining() const override
+    {
+        return static_cast<std::size_t>(_data.size()) - _position;
+    }
+};
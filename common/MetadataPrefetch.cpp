@@ -0,0 +1,163 @@
+#include "MetadataPrefetch.hpp"
+
+#include <algorithm>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <DiskFormat1.hpp>
+#include <DiskFormat2.hpp>
+
+#include "ThreadPool.hpp"
+
+
+namespace {
+
+constexpr std::size_t BATCH_BYTES = 4 * 1024 * 1024;
+
+using Validator = bool (*)(gsl::span<std::byte const>) noexcept;
+
+struct Batch
+{
+    std::uint32_t first_block {};
+    std::uint32_t block_count {};
+    std::vector<std::byte> data {};
+};
+
+Validator select_validator(std::uint32_t const littlefs_version)
+{
+    switch (littlefs_version)
+    {
+    case 1:
+        return &is_metadata_block1;
+
+    case 2:
+        return &is_metadata_block2;
+
+    default:
+        throw std::runtime_error("Invalid littlefs version specified");
+    }
+}
+
+void read_batch(IBlockDevice & device, Batch & batch)
+{
+    auto const block_size = device.block_size();
+
+    batch.data.resize(static_cast<std::size_t>(batch.block_count) * block_size);
+    for (std::uint32_t index = 0; index < batch.block_count; ++index)
+    {
+        device.read(batch.first_block + index,
+                    0,
+                    batch.data.data() + static_cast<std::size_t>(index) * block_size,
+                    block_size);
+    }
+}
+
+// Sets a flag per block of the batch in `results`, for valid metadata blocks.
+// Plain chars rather than vector<bool> so that threads can write neighbouring
+// flags. Without a pool the blocks are validated right away. With one, the work
+// is queued, and it is done once every returned future is ready.
+std::vector<std::future<void>> validate_batch(Batch const & batch,
+                                              std::uint32_t const block_size,
+                                              Validator const validator,
+                                              ThreadPool * const pool,
+                                              std::vector<char> & results)
+{
+    results.assign(batch.block_count, 0);
+
+    auto const validate = [&batch, &results, block_size, validator](std::uint32_t const start,
+                                                                    std::uint32_t const end) {
+        for (auto index = start; index < end; ++index)
+        {
+            gsl::span<std::byte const> const block(
+                batch.data.data() + static_cast<std::size_t>(index) * block_size,
+                static_cast<std::ptrdiff_t>(block_size));
+            results[index] = validator(block) ? 1 : 0;
+        }
+    };
+
+    std::vector<std::future<void>> pending {};
+    if (nullptr == pool)
+    {
+        validate(0, batch.block_count);
+        return pending;
+    }
+
+    auto const parts = static_cast<std::uint32_t>(pool->size());
+    auto const blocks_per_part = (batch.block_count + parts - 1) / parts;
+    for (std::uint32_t start = 0; start < batch.block_count; start += blocks_per_part)
+    {
+        auto const end = std::min(start + blocks_per_part, batch.block_count);
+        pending.push_back(pool->submit([validate, start, end]() { validate(start, end); }));
+    }
+
+    return pending;
+}
+
+}  // namespace
+
+
+std::size_t prefetch_metadata(CachingBlockDevice & device,
+                              std::uint32_t const littlefs_version,
+                              unsigned const thread_count)
+{
+    auto const validator = select_validator(littlefs_version);
+    auto & underlying = device.underlying();
+
+    auto const block_size = device.block_size();
+    auto const block_count = device.block_count();
+    auto const blocks_per_batch =
+        std::max<std::uint32_t>(1, static_cast<std::uint32_t>(BATCH_BYTES / block_size));
+
+    std::optional<ThreadPool> pool {};
+    if (1 != thread_count)
+    {
+        pool.emplace(thread_count);
+    }
+    auto * const validation_pool = pool ? &*pool : nullptr;
+
+    // With a pool, one batch is validated while the next one is being read.
+    // The two batches swap buffers, so no more are allocated after the first two.
+    Batch current {0, std::min(blocks_per_batch, block_count), {}};
+    read_batch(underlying, current);
+
+    Batch next {};
+    std::vector<char> valid {};
+    while (current.block_count > 0)
+    {
+        auto pending = validate_batch(current, block_size, validator, validation_pool, valid);
+
+        next.first_block = current.first_block + current.block_count;
+        next.block_count = std::min(blocks_per_batch, block_count - next.first_block);
+        {
+            // The validation uses the current batch, even if reading fails
+            auto const wait = gsl::finally([&pending]() {
+                for (auto & part : pending)
+                {
+                    part.wait();
+                }
+            });
+            read_batch(underlying, next);
+        }
+
+        for (std::uint32_t index = 0; index < current.block_count; ++index)
+        {
+            if (0 != valid[index])
+            {
+                auto const * const data =
+                    current.data.data() + static_cast<std::size_t>(index) * block_size;
+                device.insert(current.first_block + index,
+                              gsl::span<std::byte const>(data,
+                                                         static_cast<std::ptrdiff_t>(block_size)));
+            }
+        }
+
+        std::swap(current, next);
+    }
+
+    return device.cached_blocks();
+}
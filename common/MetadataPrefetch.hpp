@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CachingBlockDevice.hpp"
+
+
+// Scans the whole device in large sequential batches, validating every block
+// as a littlefs metadata block of the given version on a pool of threads, and
+// loads the valid ones into the cache. Returns the number of cached blocks.
+// A thread count of 0 uses one thread per hardware thread. With a thread count
+// of 1, the blocks are validated on the calling thread and no thread is started.
+//
+// This trades one linear pass over the image for the many small, dependent
+// reads littlefs issues while mounting and walking the directory tree.
+std::size_t prefetch_metadata(CachingBlockDevice & device,
+                              std::uint32_t littlefs_version,
+                              unsigned thread_count);
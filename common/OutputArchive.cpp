@@ -38,10 +38,18 @@ std::unique_ptr<archive_entry, decltype(&archive_entry_free)> create_archive_ent
 }  // namespace
 
 
-OutputArchive::OutputArchive(CFile file, int format) :
+OutputArchive::OutputArchive(CFile file, int format, std::vector<std::byte> * const buffer) :
     _file(std::move(file)),
-    _archive(create_archive_object())
+    _archive(create_archive_object()),
+    _own_buffer(),
+    _buffer(nullptr != buffer ? *buffer : _own_buffer),
+    _digester(nullptr)
 {
+    if (_buffer.size() < STREAM_READ_BUFFER_SIZE)
+    {
+        _buffer.resize(STREAM_READ_BUFFER_SIZE);
+    }
+
     auto result = archive_write_set_format(_archive.get(), format);
     if (result < 0)
     {
@@ -73,23 +81,59 @@ void OutputArchive::add_file(std::string const & path,
     archive_entry_set_filetype(entry.get(), AE_IFREG);
     archive_entry_set_perm(entry.get(), permissions);
 
-    std::vector<std::byte> buffer(STREAM_READ_BUFFER_SIZE);
-
     auto const header_result = archive_write_header(_archive.get(), entry.get());
     if (header_result < 0)
     {
         throw std::runtime_error(archive_error_string(_archive.get()));
     }
 
+    if (nullptr != _digester)
+    {
+        _digester->begin_file(path);
+    }
+
     auto to_read = stream_size;
     while (to_read > 0)
     {
-        auto const bytes_read = stream.read(buffer);
-        auto const write_result = archive_write_data(_archive.get(), buffer.data(), bytes_read);
+        auto const bytes_read = stream.read(_buffer);
+        auto const write_result = archive_write_data(_archive.get(), _buffer.data(), bytes_read);
         if (write_result < 0)
         {
             throw std::runtime_error(archive_error_string(_archive.get()));
         }
+        if (nullptr != _digester)
+        {
+            _digester->update(gsl::span<std::byte const>(_buffer).first(
+                static_cast<std::ptrdiff_t>(bytes_read)));
+        }
         to_read -= bytes_read;
     }
+
+    if (nullptr != _digester)
+    {
+        _digester->end_file();
+    }
+}
+
+void OutputArchive::add_hardlink(std::string const & path,
+                                 std::string const & target,
+                                 unsigned short permissions)
+{
+    auto const entry = create_archive_entry();
+
+    archive_entry_set_pathname(entry.get(), path.c_str());
+    archive_entry_set_hardlink(entry.get(), target.c_str());
+    archive_entry_set_size(entry.get(), 0);
+    archive_entry_set_filetype(entry.get(), AE_IFREG);
+    archive_entry_set_perm(entry.get(), permissions);
+
+    if (archive_write_header(_archive.get(), entry.get()) < 0)
+    {
+        throw std::runtime_error(archive_error_string(_archive.get()));
+    }
+}
+
+void OutputArchive::set_digester(FileDigester * const digester) noexcept
+{
+    _digester = digester;
 }
@@ -2,11 +2,14 @@
 
 #include <cstddef>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <archive.h>
 #include <gsl/gsl>
 
 #include "CFile.hpp"
+#include "FileDigester.hpp"
 #include "IInputStream.hpp"
 
 
@@ -15,9 +18,15 @@ class OutputArchive
 private:
     CFile _file;
     std::unique_ptr<archive, decltype(&archive_write_free)> _archive;
+    std::vector<std::byte> _own_buffer;
+    std::vector<std::byte> & _buffer;
+    FileDigester * _digester;
 
 public:
-    OutputArchive(CFile file, int format);
+    // File data is copied through `buffer` if given, so that a caller writing
+    // many archives in turn can reuse it, and through a buffer of its own
+    // otherwise.
+    OutputArchive(CFile file, int format, std::vector<std::byte> * buffer = nullptr);
 
     virtual ~OutputArchive() = default;
 
@@ -25,4 +34,14 @@ class OutputArchive
     OutputArchive & operator=(OutputArchive const &) = delete;
 
     void add_file(std::string const & path, IInputStream & stream, unsigned short permissions);
+
+    // Adds `path` as a hard link to `target`, a file already in the archive.
+    // The link carries no data.
+    void add_hardlink(std::string const & path,
+                      std::string const & target,
+                      unsigned short permissions);
+
+    // Hands the data of every file added from now on to `digester`, which
+    // must outlive the archive. Pass nullptr to stop.
+    void set_digester(FileDigester * digester) noexcept;
 };
@@ -0,0 +1,229 @@
+#include "PowerLoss.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+
+#include "MemoryBlockDevice.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace {
+
+// The device at a cut point, reached by replaying the workload on a private
+// copy of the base image. It only moves forward.
+class StateCursor
+{
+private:
+    std::vector<std::byte> _image;
+    std::uint32_t _block_size;
+    std::vector<WriteOperation> const & _writes;
+    CutPoint _position;
+
+public:
+    StateCursor(gsl::span<std::byte const> const base,
+                std::uint32_t const block_size,
+                std::vector<WriteOperation> const & writes) :
+        _image(base.begin(), base.end()), _block_size(block_size), _writes(writes), _position()
+    {
+    }
+
+    void advance_to(CutPoint const & cut)
+    {
+        while (_position.operations < cut.operations)
+        {
+            auto const & operation = _writes[_position.operations];
+            apply(operation, _position.torn_bytes, operation_size(operation));
+            ++_position.operations;
+            _position.torn_bytes = 0;
+        }
+
+        if (cut.torn_bytes > _position.torn_bytes)
+        {
+            apply(_writes[_position.operations], _position.torn_bytes, cut.torn_bytes);
+            _position.torn_bytes = cut.torn_bytes;
+        }
+    }
+
+    [[nodiscard]] gsl::span<std::byte const> image() const noexcept
+    {
+        return _image;
+    }
+
+private:
+    [[nodiscard]] std::uint32_t operation_size(WriteOperation const & operation) const noexcept
+    {
+        return WriteOperation::Kind::Erase == operation.kind
+                   ? _block_size
+                   : static_cast<std::uint32_t>(operation.data.size());
+    }
+
+    // Applies bytes [from, to) of an operation. littlefs only programs erased
+    // bytes, so a program simply replaces them.
+    void apply(WriteOperation const & operation, std::uint32_t const from, std::uint32_t const to)
+    {
+        auto const start = static_cast<std::size_t>(operation.block) * _block_size
+                           + operation.offset + from;
+        if (start + (to - from) > _image.size())
+        {
+            throw std::range_error("Recorded operation beyond the end of the device");
+        }
+
+        if (WriteOperation::Kind::Erase == operation.kind)
+        {
+            std::fill_n(_image.begin() + static_cast<std::ptrdiff_t>(start),
+                        to - from,
+                        MemoryBlockDevice::ERASED_VALUE);
+        }
+        else
+        {
+            std::memcpy(_image.data() + start, operation.data.data() + from, to - from);
+        }
+    }
+};
+
+bool is_tolerated(PowerLossOptions const & options, CheckIssue::Kind const kind)
+{
+    return std::find(options.tolerated.cbegin(), options.tolerated.cend(), kind)
+           != options.tolerated.cend();
+}
+
+}  // namespace
+
+
+std::vector<CutPoint> cut_points(std::vector<WriteOperation> const & writes,
+                                 std::uint32_t const torn_granularity)
+{
+    std::vector<CutPoint> cuts {};
+    for (std::uint64_t index = 0; index < writes.size(); ++index)
+    {
+        cuts.push_back({index, 0});
+
+        auto const & operation = writes[index];
+        if (0 == torn_granularity || WriteOperation::Kind::Program != operation.kind)
+        {
+            continue;
+        }
+        for (auto torn = torn_granularity; torn < operation.data.size(); torn += torn_granularity)
+        {
+            cuts.push_back({index, torn});
+        }
+    }
+    cuts.push_back({writes.size(), 0});
+
+    return cuts;
+}
+
+PowerLossReport check_power_loss(gsl::span<std::byte const> const base,
+                                 std::uint32_t const block_size,
+                                 std::vector<WriteOperation> const & writes,
+                                 FilesystemFactory const & mount,
+                                 PowerLossOptions const & options,
+                                 PowerLossFailureSink const & on_failure)
+{
+    auto const cuts = cut_points(writes, options.torn_granularity);
+
+    auto check_options = options.check;
+    check_options.thread_count = 1;
+
+    // Declared before the pool, so that they outlive its workers even when a
+    // run throws
+    std::mutex failure_mutex {};
+    std::vector<PowerLossReport> results {};
+    // Set by a failing run, so that the others stop early instead of checking
+    // every remaining state before the error is reported
+    std::atomic<bool> stopped {false};
+
+    auto const check_run = [&](std::size_t const run, std::size_t const runs) {
+        auto & result = results[run];
+        StateCursor cursor(base, block_size, writes);
+
+        auto const first = cuts.size() * run / runs;
+        auto const last = cuts.size() * (run + 1) / runs;
+        for (auto index = first; index < last && !stopped; ++index)
+        {
+            auto const & cut = cuts[index];
+            cursor.advance_to(cut);
+
+            auto report = check_filesystem(cursor.image(), block_size, mount, check_options);
+
+            ++result.states;
+            bool failed = !report.mounted;
+            for (auto const & issue : report.issues)
+            {
+                ++result.issue_counts[issue.kind];
+                failed = failed || !is_tolerated(options, issue.kind);
+            }
+
+            if (!failed)
+            {
+                if (!report.issues.empty())
+                {
+                    ++result.tolerated_states;
+                }
+                continue;
+            }
+
+            ++result.failed_states;
+            if (on_failure)
+            {
+                std::lock_guard<std::mutex> const lock(failure_mutex);
+                on_failure(cut, cursor.image(), report);
+            }
+            if (result.failures.size() < options.max_failures)
+            {
+                result.failures.push_back({cut, std::move(report)});
+            }
+        }
+    };
+
+    ThreadPool pool(options.thread_count);
+    auto const runs = std::min(pool.size(), cuts.size());
+    results.resize(runs);
+
+    std::vector<std::future<void>> pending {};
+    for (std::size_t run = 0; run < runs; ++run)
+    {
+        pending.push_back(pool.submit([&, run]() {
+            try
+            {
+                check_run(run, runs);
+            }
+            catch (...)
+            {
+                stopped = true;
+                throw;
+            }
+        }));
+    }
+
+    for (auto & future : pending)
+    {
+        future.get();
+    }
+
+    // Runs are consecutive, so their failures come out in workload order
+    PowerLossReport report {};
+    for (auto & result : results)
+    {
+        report.states += result.states;
+        report.failed_states += result.failed_states;
+        report.tolerated_states += result.tolerated_states;
+        for (auto const & [kind, count] : result.issue_counts)
+        {
+            report.issue_counts[kind] += count;
+        }
+        for (auto & failure : result.failures)
+        {
+            if (report.failures.size() < options.max_failures)
+            {
+                report.failures.push_back(std::move(failure));
+            }
+        }
+    }
+
+    return report;
+}
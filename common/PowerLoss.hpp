@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include "FilesystemCheck.hpp"
+#include "RecordingBlockDevice.hpp"
+
+
+// A point of a recorded workload at which power is cut
+struct CutPoint
+{
+    // Operations that reached the device in full
+    std::uint64_t operations {};
+    // Leading bytes of the next operation, a program, that reached the device;
+    // 0 when power is cut between operations
+    std::uint32_t torn_bytes {};
+};
+
+struct PowerLossOptions
+{
+    // How each state is checked. Its thread count is ignored: every state is
+    // checked on a single thread, and states are checked in parallel instead.
+    CheckOptions check {};
+    // States checked at once; 0 uses one thread per hardware thread
+    unsigned thread_count {};
+    // Distance between the torn states of a program, normally the prog size.
+    // 0 only cuts power between operations.
+    std::uint32_t torn_granularity {};
+    // Issues that littlefs may leave after a power loss by design, and repairs
+    // by itself, which do not fail a state
+    std::vector<CheckIssue::Kind> tolerated {CheckIssue::Kind::Orphan};
+    // Failures kept in the report; the others are only counted
+    std::size_t max_failures {100};
+};
+
+struct PowerLossFailure
+{
+    CutPoint cut {};
+    CheckReport report {};
+};
+
+struct PowerLossReport
+{
+    std::uint64_t states {};
+    std::uint64_t failed_states {};
+    // States whose only issues are tolerated ones
+    std::uint64_t tolerated_states {};
+    // Issues of every state, tolerated or not
+    std::map<CheckIssue::Kind, std::uint64_t> issue_counts {};
+    // The first failures, in workload order
+    std::vector<PowerLossFailure> failures {};
+};
+
+// Called with every failed state and its image, by one checking thread at a time
+using PowerLossFailureSink = std::function<void(
+    CutPoint const & cut, gsl::span<std::byte const> image, CheckReport const & report)>;
+
+// Every state a power loss can leave the device in while `writes` are applied:
+// before each operation, after the last one, and with each program torn after
+// every multiple of `torn_granularity` bytes. Erases are not torn.
+[[nodiscard]] std::vector<CutPoint> cut_points(std::vector<WriteOperation> const & writes,
+                                               std::uint32_t torn_granularity);
+
+// Mounts and checks the device at every cut point of a workload recorded on a
+// device that held `base`.
+//
+// The cut points are split into one run per thread. Each thread replays the
+// workload on its own copy of the base up to the start of its run, then moves
+// from one cut point to the next by applying only the bytes in between, so
+// that no state is built from scratch. Checks mount copy-on-write views of
+// that copy, which they cannot change.
+[[nodiscard]] PowerLossReport check_power_loss(gsl::span<std::byte const> base,
+                                               std::uint32_t block_size,
+                                               std::vector<WriteOperation> const & writes,
+                                               FilesystemFactory const & mount,
+                                               PowerLossOptions const & options,
+                                               PowerLossFailureSink const & on_failure = {});
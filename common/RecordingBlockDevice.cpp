@@ -0,0 +1,57 @@
+#include "RecordingBlockDevice.hpp"
+
+#include <utility>
+
+
+RecordingBlockDevice::RecordingBlockDevice(std::unique_ptr<IBlockDevice> block_device,
+                                           bool const record_writes) :
+    _block_device(std::move(block_device)),
+    _read_blocks(),
+    _record_writes(record_writes),
+    _writes()
+{
+}
+
+void RecordingBlockDevice::read(std::uint32_t block,
+                                std::uint32_t offset,
+                                void * buffer,
+                                std::uint32_t size)
+{
+    _block_device->read(block, offset, buffer, size);
+    _read_blocks.insert(block);
+}
+
+void RecordingBlockDevice::program(std::uint32_t block,
+                                   std::uint32_t offset,
+                                   void const * buffer,
+                                   std::uint32_t size)
+{
+    _block_device->program(block, offset, buffer, size);
+
+    if (_record_writes)
+    {
+        auto const bytes = static_cast<std::byte const *>(buffer);
+        _writes.push_back(
+            {WriteOperation::Kind::Program, block, offset, {bytes, bytes + size}});
+    }
+}
+
+void RecordingBlockDevice::erase(std::uint32_t block)
+{
+    _block_device->erase(block);
+
+    if (_record_writes)
+    {
+        _writes.push_back({WriteOperation::Kind::Erase, block, 0, {}});
+    }
+}
+
+void RecordingBlockDevice::sync()
+{
+    _block_device->sync();
+}
+
+std::vector<std::uint32_t> RecordingBlockDevice::read_blocks() const
+{
+    return {_read_blocks.cbegin(), _read_blocks.cend()};
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <IBlockDevice.hpp>
+
+
+// A program or erase, as passed to the device
+struct WriteOperation
+{
+    enum class Kind : std::uint8_t
+    {
+        Program,
+        Erase,
+    };
+
+    Kind kind {};
+    std::uint32_t block {};
+    std::uint32_t offset {};
+    // Programs only
+    std::vector<std::byte> data {};
+};
+
+// Forwards every operation to the wrapped device, remembering which blocks were
+// read and, on request, every program and erase in order.
+class RecordingBlockDevice : public IBlockDevice
+{
+private:
+    std::unique_ptr<IBlockDevice> _block_device;
+    std::set<std::uint32_t> _read_blocks;
+    bool _record_writes;
+    std::vector<WriteOperation> _writes;
+
+public:
+    explicit RecordingBlockDevice(std::unique_ptr<IBlockDevice> block_device,
+                                  bool record_writes = false);
+    ~RecordingBlockDevice() override = default;
+
+    RecordingBlockDevice(RecordingBlockDevice const &) = delete;
+    RecordingBlockDevice & operator=(RecordingBlockDevice const &) = delete;
+
+    void
+        read(std::uint32_t block, std::uint32_t offset, void * buffer, std::uint32_t size) override;
+    void program(std::uint32_t block,
+                 std::uint32_t offset,
+                 void const * buffer,
+                 std::uint32_t size) override;
+    void erase(std::uint32_t block) override;
+    void sync() override;
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept override
+    {
+        return _block_device->block_size();
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept override
+    {
+        return _block_device->block_count();
+    }
+
+    // Blocks read so far, in ascending order
+    [[nodiscard]] std::vector<std::uint32_t> read_blocks() const;
+
+    // Programs and erases that succeeded so far, in order, if recorded
+    [[nodiscard]] std::vector<WriteOperation> const & writes() const noexcept
+    {
+        return _writes;
+    }
+};
@@ -0,0 +1,157 @@
+#include "Sha256.hpp"
+
+#include <algorithm>
+
+
+namespace {
+
+constexpr std::array<std::uint32_t, 8> INITIAL_STATE {0x6a09e667,
+                                                      0xbb67ae85,
+                                                      0x3c6ef372,
+                                                      0xa54ff53a,
+                                                      0x510e527f,
+                                                      0x9b05688c,
+                                                      0x1f83d9ab,
+                                                      0x5be0cd19};
+
+constexpr std::array<std::uint32_t, 64> ROUND_CONSTANTS {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+    0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+    0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+    0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+    0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+    0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+    0xc67178f2};
+
+constexpr std::uint32_t rotate_right(std::uint32_t const value, unsigned const count) noexcept
+{
+    return (value >> count) | (value << (32U - count));
+}
+
+}  // namespace
+
+
+Sha256::Sha256() noexcept : _state(INITIAL_STATE), _block(), _block_size(0), _length(0)
+{
+}
+
+void Sha256::update(gsl::span<std::byte const> const data) noexcept
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Bytes are bytes
+    auto const * input = reinterpret_cast<std::uint8_t const *>(data.data());
+    auto remaining = static_cast<std::size_t>(data.size());
+    _length += remaining;
+
+    if (_block_size > 0)
+    {
+        auto const count = std::min(remaining, _block.size() - _block_size);
+        std::copy_n(input, count, _block.begin() + static_cast<std::ptrdiff_t>(_block_size));
+        _block_size += count;
+        input += count;
+        remaining -= count;
+
+        if (_block_size < _block.size())
+        {
+            return;
+        }
+        compress(_block.data());
+        _block_size = 0;
+    }
+
+    for (; remaining >= _block.size(); remaining -= _block.size(), input += _block.size())
+    {
+        compress(input);
+    }
+
+    std::copy_n(input, remaining, _block.begin());
+    _block_size = remaining;
+}
+
+Sha256::Digest Sha256::finish() noexcept
+{
+    auto const bit_length = _length * 8;
+
+    // A single 1 bit, zeros up to 8 bytes short of a block, then the length in bits
+    std::array<std::uint8_t, 72> padding {0x80};
+    auto const padding_size =
+        ((_block_size < 56) ? 56 - _block_size : 120 - _block_size) + sizeof(bit_length);
+    for (std::size_t index = 0; index < sizeof(bit_length); ++index)
+    {
+        padding.at(padding_size - 1 - index) = static_cast<std::uint8_t>(bit_length >> (8 * index));
+    }
+
+    auto const length = _length;
+    update(gsl::as_bytes(gsl::span<std::uint8_t const>(padding.data(),
+                                                       static_cast<std::ptrdiff_t>(padding_size))));
+    _length = length;
+
+    Digest digest {};
+    for (std::size_t index = 0; index < digest.size(); ++index)
+    {
+        auto const word = _state.at(index / 4);
+        digest.at(index) = static_cast<std::uint8_t>(word >> (24 - 8 * (index % 4)));
+    }
+    return digest;
+}
+
+void Sha256::compress(std::uint8_t const * const block) noexcept
+{
+    std::array<std::uint32_t, 64> schedule {};
+    for (std::size_t index = 0; index < 16; ++index)
+    {
+        schedule.at(index) = (std::uint32_t {block[4 * index]} << 24U)
+                             | (std::uint32_t {block[4 * index + 1]} << 16U)
+                             | (std::uint32_t {block[4 * index + 2]} << 8U)
+                             | std::uint32_t {block[4 * index + 3]};
+    }
+    for (std::size_t index = 16; index < schedule.size(); ++index)
+    {
+        auto const before_15 = schedule.at(index - 15);
+        auto const before_2 = schedule.at(index - 2);
+        auto const sigma0 =
+            rotate_right(before_15, 7) ^ rotate_right(before_15, 18) ^ (before_15 >> 3U);
+        auto const sigma1 =
+            rotate_right(before_2, 17) ^ rotate_right(before_2, 19) ^ (before_2 >> 10U);
+        schedule.at(index) = schedule.at(index - 16) + sigma0 + schedule.at(index - 7) + sigma1;
+    }
+
+    auto a = _state[0];
+    auto b = _state[1];
+    auto c = _state[2];
+    auto d = _state[3];
+    auto e = _state[4];
+    auto f = _state[5];
+    auto g = _state[6];
+    auto h = _state[7];
+
+    for (std::size_t index = 0; index < schedule.size(); ++index)
+    {
+        auto const sum1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+        auto const choice = (e & f) ^ (~e & g);
+        auto const temporary1 = h + sum1 + choice + ROUND_CONSTANTS.at(index) + schedule.at(index);
+        auto const sum0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+        auto const majority = (a & b) ^ (a & c) ^ (b & c);
+        auto const temporary2 = sum0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temporary1;
+        d = c;
+        c = b;
+        b = a;
+        a = temporary1 + temporary2;
+    }
+
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+    _state[4] += e;
+    _state[5] += f;
+    _state[6] += g;
+    _state[7] += h;
+}
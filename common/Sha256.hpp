@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <gsl/gsl>
+
+
+// SHA-256 (FIPS 180-4), computed incrementally
+class Sha256 final
+{
+public:
+    using Digest = std::array<std::uint8_t, 32>;
+
+private:
+    std::array<std::uint32_t, 8> _state;
+    std::array<std::uint8_t, 64> _block;
+    std::size_t _block_size;
+    std::uint64_t _length;
+
+public:
+    Sha256() noexcept;
+
+    void update(gsl::span<std::byte const> data) noexcept;
+
+    // The object must not be updated afterwards
+    [[nodiscard]] Digest finish() noexcept;
+
+private:
+    void compress(std::uint8_t const * block) noexcept;
+};
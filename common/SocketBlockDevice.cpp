@@ -0,0 +1,313 @@
+#include "SocketBlockDevice.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+
+namespace asio = boost::asio;
+using namespace block_protocol;
+
+
+namespace {
+
+// Merged programs are sent once they reach this size
+constexpr std::uint32_t MAX_MERGED_PROGRAM = 1024 * 1024;
+// Queued requests are written once they reach this size
+constexpr std::size_t MAX_PENDING_OUTPUT = 1024 * 1024;
+
+constexpr std::byte ERASED_VALUE {0xff};
+
+[[noreturn]] void throw_status(Status const status, char const * operation)
+{
+    throw std::runtime_error(
+        fmt::format("Remote block device {} failed: {}", operation, status_name(status)));
+}
+
+}  // namespace
+
+
+SocketBlockDevice::SocketBlockDevice(std::string const & endpoint,
+                                     SocketBlockDeviceOptions const & options) :
+    _context(),
+    _socket(connect(_context, endpoint)),
+    _options(options),
+    _block_size(0),
+    _block_count(0),
+    _cache(),
+    _cache_index(),
+    _output(),
+    _outstanding(0),
+    _pending(),
+    _pending_data(),
+    _response_data()
+{
+    _options.readahead_blocks = std::max<std::uint32_t>(_options.readahead_blocks, 1);
+    _options.max_outstanding = std::max<std::size_t>(_options.max_outstanding, 1);
+
+    queue({Operation::Info, 0, 0, 0});
+    complete();
+
+    if (_response_data.size() != INFO_SIZE)
+    {
+        throw std::runtime_error("Invalid response from remote block device");
+    }
+    std::array<std::byte, INFO_SIZE> data {};
+    std::copy(_response_data.cbegin(), _response_data.cend(), data.begin());
+
+    auto const info = decode_info(data);
+    if (0 == info.block_size || 0 == info.block_count)
+    {
+        throw std::runtime_error("Remote block device reports an empty geometry");
+    }
+    _block_size = info.block_size;
+    _block_count = info.block_count;
+}
+
+SocketBlockDevice::~SocketBlockDevice()
+{
+    try
+    {
+        queue_pending();
+        complete();
+    }
+    catch (std::exception const &)
+    {
+        // Nowhere to report it; callers that care call sync() first
+    }
+}
+
+void SocketBlockDevice::read(std::uint32_t const block,
+                             std::uint32_t const offset,
+                             void * buffer,
+                             std::uint32_t const size)
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid read range");
+    }
+
+    if (auto const * const data = cached(block); nullptr != data)
+    {
+        std::memcpy(buffer, data->data() + offset, size);
+        return;
+    }
+
+    // The server has to see every earlier program and erase first
+    queue_pending();
+
+    if (0 == _options.cache_blocks)
+    {
+        queue({Operation::Read, block, offset, size});
+        complete();
+
+        if (_response_data.size() != size)
+        {
+            throw std::runtime_error("Invalid response from remote block device");
+        }
+        std::memcpy(buffer, _response_data.data(), size);
+        return;
+    }
+
+    auto const max_count = std::max<std::uint32_t>(MAX_TRANSFER_SIZE / _block_size, 1);
+    auto const count =
+        std::min({_options.readahead_blocks, max_count, _block_count - block});
+    queue({Operation::Read, block, 0, count * _block_size});
+    complete();
+
+    if (_response_data.size() != static_cast<std::size_t>(count) * _block_size)
+    {
+        throw std::runtime_error("Invalid response from remote block device");
+    }
+
+    // The last block cached is the most recently used, so the one asked for goes last
+    gsl::span<std::byte const> const data(_response_data);
+    for (auto index = count; index > 0; --index)
+    {
+        auto const offset_in_data = static_cast<std::ptrdiff_t>(index - 1) * _block_size;
+        cache(block + index - 1, data.subspan(offset_in_data, _block_size));
+    }
+
+    std::memcpy(buffer, _response_data.data() + offset, size);
+}
+
+void SocketBlockDevice::program(std::uint32_t const block,
+                                std::uint32_t const offset,
+                                void const * buffer,
+                                std::uint32_t const size)
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid write range");
+    }
+
+    if (auto * const data = cached(block); nullptr != data)
+    {
+        std::memcpy(data->data() + offset, buffer, size);
+    }
+
+    auto const bytes = gsl::span<std::byte const>(static_cast<std::byte const *>(buffer), size);
+
+    auto const extends_pending = _pending && Operation::Program == _pending->operation
+                                 && _pending->block == block
+                                 && _pending->offset + _pending->size == offset
+                                 && _pending->size + size <= MAX_MERGED_PROGRAM;
+    if (extends_pending)
+    {
+        _pending->size += size;
+        _pending_data.insert(_pending_data.end(), bytes.cbegin(), bytes.cend());
+        return;
+    }
+
+    queue_pending();
+    _pending = Request {Operation::Program, block, offset, size};
+    _pending_data.assign(bytes.cbegin(), bytes.cend());
+}
+
+void SocketBlockDevice::erase(std::uint32_t const block)
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    if (auto * const data = cached(block); nullptr != data)
+    {
+        std::fill(data->begin(), data->end(), ERASED_VALUE);
+    }
+
+    if (_pending && Operation::Erase == _pending->operation
+        && _pending->block + _pending->size == block)
+    {
+        ++_pending->size;
+        return;
+    }
+
+    queue_pending();
+    _pending = Request {Operation::Erase, block, 0, 1};
+}
+
+void SocketBlockDevice::sync()
+{
+    queue_pending();
+    queue({Operation::Sync, 0, 0, 0});
+    complete();
+}
+
+std::vector<std::byte> * SocketBlockDevice::cached(std::uint32_t const block)
+{
+    auto const found = _cache_index.find(block);
+    if (found == _cache_index.end())
+    {
+        return nullptr;
+    }
+
+    _cache.splice(_cache.begin(), _cache, found->second);
+    return &found->second->data;
+}
+
+void SocketBlockDevice::cache(std::uint32_t const block, gsl::span<std::byte const> const data)
+{
+    if (auto * const existing = cached(block); nullptr != existing)
+    {
+        existing->assign(data.cbegin(), data.cend());
+        return;
+    }
+
+    if (_cache.size() >= _options.cache_blocks)
+    {
+        // Reuses the storage of the least recently used block
+        _cache_index.erase(_cache.back().block);
+        _cache.splice(_cache.begin(), _cache, std::prev(_cache.end()));
+        _cache.front().block = block;
+        _cache.front().data.assign(data.cbegin(), data.cend());
+    }
+    else
+    {
+        _cache.push_front({block, {data.cbegin(), data.cend()}});
+    }
+    _cache_index[block] = _cache.begin();
+}
+
+void SocketBlockDevice::queue(Request const & request, gsl::span<std::byte const> const data)
+{
+    auto const header = encode(request);
+    _output.insert(_output.end(), header.cbegin(), header.cend());
+    _output.insert(_output.end(), data.cbegin(), data.cend());
+    ++_outstanding;
+
+    if (_outstanding >= _options.max_outstanding)
+    {
+        complete();
+    }
+    else if (_output.size() >= MAX_PENDING_OUTPUT)
+    {
+        asio::write(_socket, asio::buffer(_output));
+        _output.clear();
+    }
+}
+
+void SocketBlockDevice::queue_pending()
+{
+    if (!_pending)
+    {
+        return;
+    }
+
+    auto const request = *_pending;
+    _pending.reset();
+    if (Operation::Program == request.operation)
+    {
+        queue(request, _pending_data);
+    }
+    else
+    {
+        queue(request);
+    }
+}
+
+void SocketBlockDevice::complete()
+{
+    if (!_output.empty())
+    {
+        asio::write(_socket, asio::buffer(_output));
+        _output.clear();
+    }
+
+    std::optional<Status> failure {};
+    for (; _outstanding > 0; --_outstanding)
+    {
+        std::array<std::byte, RESPONSE_SIZE> header {};
+        asio::read(_socket, asio::buffer(header));
+        auto const response = decode_response(header);
+
+        if (response.size > 0)
+        {
+            _response_data.resize(response.size);
+            asio::read(_socket, asio::buffer(_response_data));
+        }
+        if (Status::Ok != response.status && !failure)
+        {
+            failure = response.status;
+        }
+    }
+
+    if (failure)
+    {
+        throw_status(*failure, "request");
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+
+#include "BlockProtocol.hpp"
+
+
+struct SocketBlockDeviceOptions
+{
+    // 0 disables the cache, and reads go to the server as they are
+    std::size_t cache_blocks {256};
+    // Blocks fetched by a read that misses the cache, counting the missed one
+    std::uint32_t readahead_blocks {8};
+    // Requests sent before waiting for their responses
+    std::size_t max_outstanding {64};
+};
+
+// A block device on the other end of a Unix or TCP socket, reached through the
+// block protocol, for instance flash behind a programmer daemon. Round trips
+// are what makes such a device slow, so the device avoids them:
+//
+// - Programs and erases are pipelined: they are sent without waiting for their
+//   responses, which are collected at the next read or sync, up to a limit.
+// - Adjacent programs, and erases of consecutive blocks, are merged into one
+//   request.
+// - Whole blocks are cached, and a read that misses fetches the following
+//   blocks too, in one request. Programs and erases update the cache.
+//
+// A failed program or erase is therefore reported by a later call, at the latest
+// by sync().
+class SocketBlockDevice : public IBlockDevice
+{
+private:
+    struct CachedBlock
+    {
+        std::uint32_t block;
+        std::vector<std::byte> data;
+    };
+
+    boost::asio::io_context _context;
+    block_protocol::Socket _socket;
+    SocketBlockDeviceOptions _options;
+    std::uint32_t _block_size;
+    std::uint32_t _block_count;
+
+    // Most recently used first
+    std::list<CachedBlock> _cache;
+    std::unordered_map<std::uint32_t, std::list<CachedBlock>::iterator> _cache_index;
+
+    // Requests not written to the socket yet
+    std::vector<std::byte> _output;
+    // Requests written, or about to be, whose responses have not been read
+    std::size_t _outstanding;
+    // A program or erase that the next one may still extend
+    std::optional<block_protocol::Request> _pending;
+    std::vector<std::byte> _pending_data;
+
+    std::vector<std::byte> _response_data;
+
+public:
+    explicit SocketBlockDevice(std::string const & endpoint,
+                               SocketBlockDeviceOptions const & options = {});
+    // Sends what is pending, but cannot report failures; call sync() for that
+    ~SocketBlockDevice() override;
+
+    SocketBlockDevice(SocketBlockDevice const &) = delete;
+    SocketBlockDevice & operator=(SocketBlockDevice const &) = delete;
+
+    void
+        read(std::uint32_t block, std::uint32_t offset, void * buffer, std::uint32_t size) override;
+    void program(std::uint32_t block,
+                 std::uint32_t offset,
+                 void const * buffer,
+                 std::uint32_t size) override;
+    void erase(std::uint32_t block) override;
+    void sync() override;
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept override
+    {
+        return _block_size;
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept override
+    {
+        return _block_count;
+    }
+
+private:
+    [[nodiscard]] std::vector<std::byte> * cached(std::uint32_t block);
+    void cache(std::uint32_t block, gsl::span<std::byte const> data);
+
+    void queue(block_protocol::Request const & request, gsl::span<std::byte const> data = {});
+    void queue_pending();
+    // Writes all queued requests and reads every outstanding response. The data
+    // of the last response that has any is left in _response_data.
+    void complete();
+};
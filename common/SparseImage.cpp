@@ -0,0 +1,494 @@
+#include "SparseImage.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <fmt/core.h>
+
+
+namespace {
+
+constexpr char EXTENT_MAGIC[8] = {'L', 'F', 'S', 'X', 'T', 'E', 'N', 'T'};
+constexpr std::uint32_t EXTENT_FORMAT_VERSION = 1;
+constexpr std::uint32_t EXTENT_BYTE_ORDER = 0x01020304;
+
+struct ExtentHeader
+{
+    char magic[8];
+    std::uint32_t format_version;
+    std::uint32_t byte_order;
+    std::uint32_t block_size;
+    std::uint32_t block_count;
+    std::uint32_t extent_count;
+    std::uint32_t reserved;
+};
+
+// Android sparse images are little-endian whatever the host, see
+// system/core/libsparse/sparse_format.h
+constexpr std::uint32_t ANDROID_MAGIC = 0xed26ff3a;
+constexpr std::uint16_t ANDROID_MAJOR_VERSION = 1;
+constexpr std::size_t ANDROID_FILE_HEADER_SIZE = 28;
+constexpr std::size_t ANDROID_CHUNK_HEADER_SIZE = 12;
+
+constexpr std::uint16_t CHUNK_TYPE_RAW = 0xcac1;
+constexpr std::uint16_t CHUNK_TYPE_FILL = 0xcac2;
+constexpr std::uint16_t CHUNK_TYPE_DONT_CARE = 0xcac3;
+constexpr std::uint16_t CHUNK_TYPE_CRC32 = 0xcac4;
+
+// Raw chunks are split so that their size fits the chunk header
+constexpr std::uint64_t MAX_RAW_CHUNK_SIZE = 64 * 1024 * 1024;
+
+constexpr std::size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+struct AndroidChunk
+{
+    std::uint16_t type;
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+void write_bytes(CFile & file, gsl::span<std::byte const> const bytes)
+{
+    if (file.write(bytes) != static_cast<std::size_t>(bytes.size()))
+    {
+        throw std::runtime_error("Failed writing sparse image");
+    }
+}
+
+void read_bytes(CFile & file, gsl::span<std::byte> const bytes)
+{
+    if (file.read(bytes) != static_cast<std::size_t>(bytes.size()))
+    {
+        throw std::runtime_error("Truncated sparse image");
+    }
+}
+
+void skip_bytes(CFile & file, std::size_t size)
+{
+    std::array<std::byte, 256> scratch {};
+    while (size > 0)
+    {
+        auto const piece = std::min(size, scratch.size());
+        read_bytes(file, gsl::span<std::byte>(scratch).first(static_cast<std::ptrdiff_t>(piece)));
+        size -= piece;
+    }
+}
+
+void put_le(std::vector<std::byte> & output, std::uint32_t value, std::size_t const size)
+{
+    for (std::size_t index = 0; index < size; ++index)
+    {
+        output.push_back(static_cast<std::byte>(value & 0xffU));
+        value >>= 8U;
+    }
+}
+
+std::uint32_t get_le(gsl::span<std::byte const> const input,
+                     std::size_t const offset,
+                     std::size_t const size)
+{
+    std::uint32_t value = 0;
+    for (std::size_t index = size; index > 0; --index)
+    {
+        value = (value << 8U)
+                | std::to_integer<std::uint32_t>(
+                    input[static_cast<std::ptrdiff_t>(offset + index - 1)]);
+    }
+    return value;
+}
+
+std::uint32_t blocks_per_piece(std::size_t const buffer_size, std::uint32_t const block_size)
+{
+    return static_cast<std::uint32_t>(std::max<std::size_t>(buffer_size / block_size, 1));
+}
+
+// Copies the blocks of an extent from the image to the file, a buffer at a time
+void copy_extent(IBlockDevice & image, BlockExtent const & extent, CFile & file)
+{
+    auto const block_size = image.block_size();
+    auto const piece_blocks = blocks_per_piece(WRITE_BUFFER_SIZE, block_size);
+    std::vector<std::byte> buffer(static_cast<std::size_t>(piece_blocks) * block_size);
+
+    for (std::uint32_t done = 0; done < extent.count;)
+    {
+        auto const count = std::min(piece_blocks, extent.count - done);
+        for (std::uint32_t index = 0; index < count; ++index)
+        {
+            image.read(extent.first + done + index,
+                       0,
+                       buffer.data() + static_cast<std::size_t>(index) * block_size,
+                       block_size);
+        }
+        write_bytes(file,
+                    gsl::span<std::byte const>(buffer).first(
+                        static_cast<std::ptrdiff_t>(count) * block_size));
+        done += count;
+    }
+}
+
+void check_extents(std::vector<BlockExtent> const & extents, std::uint32_t const block_count)
+{
+    std::uint64_t end = 0;
+    for (auto const & extent : extents)
+    {
+        if (extent.first < end || 0 == extent.count
+            || static_cast<std::uint64_t>(extent.first) + extent.count > block_count)
+        {
+            throw std::runtime_error("Invalid extent list");
+        }
+        end = static_cast<std::uint64_t>(extent.first) + extent.count;
+    }
+}
+
+}  // namespace
+
+
+std::vector<BlockExtent> used_extents(LittleFS & filesystem, std::uint32_t const block_count)
+{
+    std::vector<bool> used(block_count, false);
+    for (std::uint32_t block = 0; block < std::min<std::uint32_t>(2, block_count); ++block)
+    {
+        used[block] = true;
+    }
+    filesystem.traverse([&used](std::uint32_t const block) {
+        if (block < used.size())
+        {
+            used[block] = true;
+        }
+    });
+
+    std::vector<BlockExtent> extents {};
+    for (std::uint32_t block = 0; block < block_count; ++block)
+    {
+        if (!used[block])
+        {
+            continue;
+        }
+        if (!extents.empty() && extents.back().first + extents.back().count == block)
+        {
+            ++extents.back().count;
+        }
+        else
+        {
+            extents.push_back({block, 1});
+        }
+    }
+    return extents;
+}
+
+std::uint64_t extent_blocks(std::vector<BlockExtent> const & extents) noexcept
+{
+    std::uint64_t blocks = 0;
+    for (auto const & extent : extents)
+    {
+        blocks += extent.count;
+    }
+    return blocks;
+}
+
+void write_sparse_file(IBlockDevice & image,
+                       std::vector<BlockExtent> const & extents,
+                       std::string const & path)
+{
+    check_extents(extents, image.block_count());
+
+    auto const block_size = image.block_size();
+    {
+        std::ofstream file(path, std::ios_base::binary | std::ios_base::trunc);
+        file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+
+        std::vector<std::byte> buffer(block_size);
+        for (auto const & extent : extents)
+        {
+            // Seeking past the end leaves a hole on filesystems that support them
+            file.seekp(static_cast<std::streamoff>(extent.first) * block_size);
+            for (std::uint32_t block = extent.first; block < extent.first + extent.count; ++block)
+            {
+                image.read(block, 0, buffer.data(), block_size);
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Binary data
+                file.write(reinterpret_cast<char const *>(buffer.data()),
+                           static_cast<std::streamsize>(block_size));
+            }
+        }
+    }
+
+    // Extends the file with a hole when its last blocks are unused
+    boost::filesystem::resize_file(path,
+                                   static_cast<std::uintmax_t>(image.block_count()) * block_size);
+}
+
+void write_extent_image(IBlockDevice & image,
+                        std::vector<BlockExtent> const & extents,
+                        CFile & file)
+{
+    check_extents(extents, image.block_count());
+
+    ExtentHeader header {};
+    std::copy(std::begin(EXTENT_MAGIC), std::end(EXTENT_MAGIC), std::begin(header.magic));
+    header.format_version = EXTENT_FORMAT_VERSION;
+    header.byte_order = EXTENT_BYTE_ORDER;
+    header.block_size = image.block_size();
+    header.block_count = image.block_count();
+    header.extent_count = static_cast<std::uint32_t>(extents.size());
+
+    write_bytes(file, gsl::as_bytes(gsl::span<ExtentHeader const>(&header, 1)));
+    write_bytes(file, gsl::as_bytes(gsl::span<BlockExtent const>(extents)));
+    for (auto const & extent : extents)
+    {
+        copy_extent(image, extent, file);
+    }
+}
+
+void write_android_sparse_image(IBlockDevice & image,
+                                std::vector<BlockExtent> const & extents,
+                                CFile & file)
+{
+    check_extents(extents, image.block_count());
+
+    auto const block_size = image.block_size();
+    if (0 != block_size % 4)
+    {
+        throw std::invalid_argument("Android sparse images need a block size divisible by 4");
+    }
+
+    auto const raw_chunk_blocks = blocks_per_piece(MAX_RAW_CHUNK_SIZE, block_size);
+
+    std::vector<AndroidChunk> chunks {};
+    std::uint32_t next = 0;
+    for (auto const & extent : extents)
+    {
+        if (extent.first > next)
+        {
+            chunks.push_back({CHUNK_TYPE_DONT_CARE, next, extent.first - next});
+        }
+        for (std::uint32_t done = 0; done < extent.count; done += raw_chunk_blocks)
+        {
+            chunks.push_back({CHUNK_TYPE_RAW,
+                              extent.first + done,
+                              std::min(raw_chunk_blocks, extent.count - done)});
+        }
+        next = extent.first + extent.count;
+    }
+    if (image.block_count() > next)
+    {
+        chunks.push_back({CHUNK_TYPE_DONT_CARE, next, image.block_count() - next});
+    }
+
+    std::vector<std::byte> header {};
+    put_le(header, ANDROID_MAGIC, 4);
+    put_le(header, ANDROID_MAJOR_VERSION, 2);
+    put_le(header, 0, 2);
+    put_le(header, static_cast<std::uint32_t>(ANDROID_FILE_HEADER_SIZE), 2);
+    put_le(header, static_cast<std::uint32_t>(ANDROID_CHUNK_HEADER_SIZE), 2);
+    put_le(header, block_size, 4);
+    put_le(header, image.block_count(), 4);
+    put_le(header, static_cast<std::uint32_t>(chunks.size()), 4);
+    // No image checksum
+    put_le(header, 0, 4);
+    write_bytes(file, header);
+
+    for (auto const & chunk : chunks)
+    {
+        auto const data_size = CHUNK_TYPE_RAW == chunk.type ? chunk.count * block_size : 0;
+
+        header.clear();
+        put_le(header, chunk.type, 2);
+        put_le(header, 0, 2);
+        put_le(header, chunk.count, 4);
+        put_le(header, static_cast<std::uint32_t>(ANDROID_CHUNK_HEADER_SIZE) + data_size, 4);
+        write_bytes(file, header);
+
+        if (CHUNK_TYPE_RAW == chunk.type)
+        {
+            copy_extent(image, {chunk.first, chunk.count}, file);
+        }
+    }
+}
+
+SparseImageReader::SparseImageReader(CFile & file) :
+    _file(file),
+    _format(SparseFormat::Extents),
+    _block_size(0),
+    _block_count(0),
+    _extents(),
+    _chunk_count(0),
+    _chunk_header_size(0)
+{
+    std::array<std::byte, ANDROID_FILE_HEADER_SIZE> buffer {};
+    auto const magic = gsl::span<std::byte>(buffer).first(4);
+    read_bytes(_file, magic);
+
+    if (ANDROID_MAGIC == get_le(magic, 0, 4))
+    {
+        _format = SparseFormat::Android;
+
+        read_bytes(_file, gsl::span<std::byte>(buffer).subspan(4));
+        auto const header = gsl::span<std::byte const>(buffer);
+        if (get_le(header, 4, 2) != ANDROID_MAJOR_VERSION)
+        {
+            throw std::runtime_error("Unsupported Android sparse image version");
+        }
+
+        auto const file_header_size = get_le(header, 8, 2);
+        _chunk_header_size = get_le(header, 10, 2);
+        _block_size = get_le(header, 12, 4);
+        _block_count = get_le(header, 16, 4);
+        _chunk_count = get_le(header, 20, 4);
+
+        if (file_header_size < ANDROID_FILE_HEADER_SIZE
+            || _chunk_header_size < ANDROID_CHUNK_HEADER_SIZE || 0 == _block_size
+            || 0 != _block_size % 4)
+        {
+            throw std::runtime_error("Corrupt Android sparse image");
+        }
+        skip_bytes(_file, file_header_size - ANDROID_FILE_HEADER_SIZE);
+        return;
+    }
+
+    if (!std::equal(magic.begin(), magic.end(), std::begin(EXTENT_MAGIC), [](auto a, auto b) {
+            return std::to_integer<char>(a) == b;
+        }))
+    {
+        throw std::runtime_error("Not a sparse image");
+    }
+
+    ExtentHeader header {};
+    auto const header_bytes = gsl::as_writeable_bytes(gsl::span<ExtentHeader>(&header, 1));
+    std::copy(magic.begin(), magic.end(), header_bytes.begin());
+    read_bytes(_file, header_bytes.subspan(magic.size()));
+
+    if (!std::equal(std::begin(EXTENT_MAGIC), std::end(EXTENT_MAGIC), std::begin(header.magic)))
+    {
+        throw std::runtime_error("Not a sparse image");
+    }
+    if (header.format_version != EXTENT_FORMAT_VERSION || header.byte_order != EXTENT_BYTE_ORDER)
+    {
+        throw std::runtime_error("Unsupported extent image version");
+    }
+    if (0 == header.block_size)
+    {
+        throw std::runtime_error("Corrupt extent image");
+    }
+
+    _block_size = header.block_size;
+    _block_count = header.block_count;
+    _extents.resize(header.extent_count);
+    read_bytes(_file, gsl::as_writeable_bytes(gsl::span<BlockExtent>(_extents)));
+    check_extents(_extents, _block_count);
+}
+
+void SparseImageReader::read(SparseBlockSink const & sink, std::size_t const buffer_size)
+{
+    if (SparseFormat::Android == _format)
+    {
+        read_chunks(sink, buffer_size);
+    }
+    else
+    {
+        read_extents(sink, buffer_size);
+    }
+}
+
+void SparseImageReader::read_extents(SparseBlockSink const & sink, std::size_t const buffer_size)
+{
+    auto const piece_blocks = blocks_per_piece(buffer_size, _block_size);
+    std::vector<std::byte> buffer(static_cast<std::size_t>(piece_blocks) * _block_size);
+
+    for (auto const & extent : _extents)
+    {
+        for (std::uint32_t done = 0; done < extent.count;)
+        {
+            auto const count = std::min(piece_blocks, extent.count - done);
+            auto const piece = gsl::span<std::byte>(buffer).first(
+                static_cast<std::ptrdiff_t>(count) * _block_size);
+            read_bytes(_file, piece);
+            sink(extent.first + done, piece);
+            done += count;
+        }
+    }
+}
+
+void SparseImageReader::read_chunks(SparseBlockSink const & sink, std::size_t const buffer_size)
+{
+    auto const piece_blocks = blocks_per_piece(buffer_size, _block_size);
+    std::vector<std::byte> buffer(static_cast<std::size_t>(piece_blocks) * _block_size);
+    std::vector<std::byte> header(_chunk_header_size);
+
+    std::uint64_t next = 0;
+    for (std::uint32_t chunk = 0; chunk < _chunk_count; ++chunk)
+    {
+        read_bytes(_file, header);
+        auto const type = get_le(header, 0, 2);
+        auto const count = get_le(header, 4, 4);
+        auto const total_size = get_le(header, 8, 4);
+
+        if (next + count > _block_count)
+        {
+            throw std::runtime_error("Corrupt Android sparse image");
+        }
+        auto const expect_data_size = [total_size, this](std::uint64_t const size) {
+            if (total_size < _chunk_header_size || total_size - _chunk_header_size != size)
+            {
+                throw std::runtime_error("Corrupt Android sparse image");
+            }
+        };
+
+        auto const first = static_cast<std::uint32_t>(next);
+        switch (type)
+        {
+        case CHUNK_TYPE_RAW:
+            expect_data_size(static_cast<std::uint64_t>(count) * _block_size);
+            for (std::uint32_t done = 0; done < count;)
+            {
+                auto const piece_count = std::min(piece_blocks, count - done);
+                auto const piece = gsl::span<std::byte>(buffer).first(
+                    static_cast<std::ptrdiff_t>(piece_count) * _block_size);
+                read_bytes(_file, piece);
+                sink(first + done, piece);
+                done += piece_count;
+            }
+            break;
+
+        case CHUNK_TYPE_FILL:
+        {
+            expect_data_size(4);
+            std::array<std::byte, 4> pattern {};
+            read_bytes(_file, pattern);
+            for (std::size_t index = 0; index < buffer.size(); ++index)
+            {
+                buffer[index] = pattern[index % pattern.size()];
+            }
+            for (std::uint32_t done = 0; done < count;)
+            {
+                auto const piece_count = std::min(piece_blocks, count - done);
+                sink(first + done,
+                     gsl::span<std::byte const>(buffer).first(
+                         static_cast<std::ptrdiff_t>(piece_count) * _block_size));
+                done += piece_count;
+            }
+            break;
+        }
+
+        case CHUNK_TYPE_DONT_CARE:
+            expect_data_size(0);
+            break;
+
+        case CHUNK_TYPE_CRC32:
+            // The checksum covers the image so far, which is not kept to check it
+            expect_data_size(4);
+            skip_bytes(_file, 4);
+            break;
+
+        default:
+            throw std::runtime_error(
+                fmt::format("Unsupported Android sparse chunk type {:#06x}", type));
+        }
+
+        next += count;
+    }
+}
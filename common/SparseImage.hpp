@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <IBlockDevice.hpp>
+#include <LittleFS.hpp>
+
+#include "CFile.hpp"
+
+
+// Images that hold only some of the blocks of a device, usually those in use
+enum class SparseFormat
+{
+    // A plain image whose unused blocks are holes, read back as zeros
+    Holes,
+    // A header and a list of extents, followed by the contents of their blocks
+    Extents,
+    // The sparse image format of Android's fastboot and img2simg
+    Android,
+};
+
+struct BlockExtent
+{
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+// Runs of consecutive blocks in use by the filesystem, by littlefs' own
+// traversal, in ascending order. The superblock pair is always in use.
+[[nodiscard]] std::vector<BlockExtent> used_extents(LittleFS & filesystem,
+                                                    std::uint32_t block_count);
+
+[[nodiscard]] std::uint64_t extent_blocks(std::vector<BlockExtent> const & extents) noexcept;
+
+// Each writer reads the blocks of `extents` from `image`, which must be in
+// ascending order and not overlap, and nothing else.
+void write_sparse_file(IBlockDevice & image,
+                       std::vector<BlockExtent> const & extents,
+                       std::string const & path);
+void write_extent_image(IBlockDevice & image,
+                        std::vector<BlockExtent> const & extents,
+                        CFile & file);
+// The block size must be a multiple of 4. Unused blocks are "don't care"
+// chunks, which fastboot leaves as they are.
+void write_android_sparse_image(IBlockDevice & image,
+                                std::vector<BlockExtent> const & extents,
+                                CFile & file);
+
+// Consecutive blocks, starting at the given one
+using SparseBlockSink = std::function<void(std::uint32_t, gsl::span<std::byte const>)>;
+
+// Reads an extent or Android sparse image from the start, without seeking, so
+// that it may come from a pipe. The constructor reads the header.
+class SparseImageReader final
+{
+private:
+    CFile & _file;
+    SparseFormat _format;
+    std::uint32_t _block_size;
+    std::uint32_t _block_count;
+    // Extent images only
+    std::vector<BlockExtent> _extents;
+    // Android images only
+    std::uint32_t _chunk_count;
+    std::uint32_t _chunk_header_size;
+
+public:
+    explicit SparseImageReader(CFile & file);
+
+    SparseImageReader(SparseImageReader const &) = delete;
+    SparseImageReader & operator=(SparseImageReader const &) = delete;
+
+    // Hands every block the image holds to `sink` once, in ascending order, in
+    // runs of at most `buffer_size` bytes or one block. Fill chunks of Android
+    // images are expanded. Can only be called once.
+    void read(SparseBlockSink const & sink, std::size_t buffer_size);
+
+    [[nodiscard]] SparseFormat format() const noexcept
+    {
+        return _format;
+    }
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept
+    {
+        return _block_size;
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept
+    {
+        return _block_count;
+    }
+
+private:
+    void read_extents(SparseBlockSink const & sink, std::size_t buffer_size);
+    void read_chunks(SparseBlockSink const & sink, std::size_t buffer_size);
+};
@@ -0,0 +1,158 @@
+#include "SpooledBlockDevice.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <gsl/gsl>
+
+
+namespace {
+
+constexpr std::size_t READ_SIZE = 8 * 1024 * 1024;
+constexpr std::byte ERASED_VALUE {0xff};
+
+}  // namespace
+
+
+SpooledBlockDevice::SpooledBlockDevice(CFile & file,
+                                       std::uint32_t const block_size,
+                                       std::optional<std::uint32_t> const block_count) :
+    _chunks(),
+    _block_size(block_size),
+    _block_count(0)
+{
+    if (0 == block_size)
+    {
+        throw std::invalid_argument("Invalid block size");
+    }
+
+    auto const blocks_wanted =
+        static_cast<std::uint64_t>(block_count.value_or(std::numeric_limits<std::uint32_t>::max()));
+
+    auto chunk_size = FIRST_CHUNK_SIZE;
+    std::uint64_t blocks_read = 0;
+    std::size_t partial_bytes = 0;
+    while (blocks_read < blocks_wanted && 0 == partial_bytes)
+    {
+        auto const chunk_blocks =
+            static_cast<std::uint32_t>(std::min(std::max<std::uint64_t>(chunk_size / block_size, 1),
+                                                blocks_wanted - blocks_read));
+        auto const chunk_bytes = static_cast<std::size_t>(chunk_blocks) * block_size;
+
+        Chunk chunk {static_cast<std::uint32_t>(blocks_read),
+                     0,
+                     std::unique_ptr<std::byte, AlignedDelete>(static_cast<std::byte *>(
+                         ::operator new(chunk_bytes, std::align_val_t {PAGE_SIZE})))};
+
+        auto const data =
+            gsl::span<std::byte>(chunk.data.get(), static_cast<std::ptrdiff_t>(chunk_bytes));
+        std::size_t filled = 0;
+        while (filled < chunk_bytes)
+        {
+            auto const piece = data.subspan(static_cast<std::ptrdiff_t>(filled))
+                                   .first(static_cast<std::ptrdiff_t>(
+                                       std::min(READ_SIZE, chunk_bytes - filled)));
+            auto const count = file.read(piece);
+            filled += count;
+            if (count < static_cast<std::size_t>(piece.size()))
+            {
+                if (0 != std::ferror(file.handle()))
+                {
+                    throw std::runtime_error("Failed reading image");
+                }
+                break;
+            }
+        }
+
+        chunk.block_count = static_cast<std::uint32_t>(filled / block_size);
+        partial_bytes = filled % block_size;
+        blocks_read += chunk.block_count;
+
+        if (chunk.block_count > 0)
+        {
+            _chunks.push_back(std::move(chunk));
+        }
+        if (filled < chunk_bytes)
+        {
+            break;
+        }
+
+        chunk_size = std::min(chunk_size * 2, MAX_CHUNK_SIZE);
+    }
+
+    if (0 != partial_bytes)
+    {
+        throw std::runtime_error("Invalid block size");
+    }
+    if (block_count && blocks_read < *block_count)
+    {
+        throw std::runtime_error("Image shorter than the block count");
+    }
+    if (0 == blocks_read)
+    {
+        throw std::runtime_error("Empty image");
+    }
+
+    _block_count = static_cast<std::uint32_t>(blocks_read);
+}
+
+void SpooledBlockDevice::read(std::uint32_t const block,
+                              std::uint32_t const offset,
+                              void * buffer,
+                              std::uint32_t const size)
+{
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid read range");
+    }
+
+    std::memcpy(buffer, locate(block, offset), size);
+}
+
+void SpooledBlockDevice::program(std::uint32_t const block,
+                                 std::uint32_t const offset,
+                                 void const * buffer,
+                                 std::uint32_t const size)
+{
+    if (offset + size > _block_size)
+    {
+        throw std::range_error("Invalid write range");
+    }
+
+    std::memcpy(locate(block, offset), buffer, size);
+}
+
+void SpooledBlockDevice::erase(std::uint32_t const block)
+{
+    std::memset(locate(block, 0), std::to_integer<int>(ERASED_VALUE), _block_size);
+}
+
+void SpooledBlockDevice::sync()
+{
+}
+
+std::byte * SpooledBlockDevice::locate(std::uint32_t const block, std::uint32_t const offset) const
+{
+    if (block >= _block_count)
+    {
+        throw std::range_error("Invalid block number");
+    }
+
+    // Chunks are in block order; find the last one starting at or before the block
+    auto const chunk = std::prev(
+        std::upper_bound(_chunks.cbegin(),
+                         _chunks.cend(),
+                         block,
+                         [](std::uint32_t const value, Chunk const & candidate) {
+                             return value < candidate.first_block;
+                         }));
+
+    auto const position =
+        static_cast<std::size_t>(block - chunk->first_block) * _block_size + offset;
+    return chunk->data.get() + position;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <vector>
+
+#include <IBlockDevice.hpp>
+
+#include "CFile.hpp"
+
+
+// A block device holding an image read from a stream that cannot be seeked or
+// sized up front, such as standard input or a pipe. The stream is read in large
+// pieces into page-aligned chunks, which are added as the data arrives and
+// double in size up to a limit, so that growing never copies what was already
+// read. Chunks hold whole blocks, so a block never spans two of them.
+class SpooledBlockDevice : public IBlockDevice
+{
+private:
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    struct AlignedDelete
+    {
+        void operator()(std::byte * data) const noexcept
+        {
+            ::operator delete(data, std::align_val_t {PAGE_SIZE});
+        }
+    };
+
+    struct Chunk
+    {
+        std::uint32_t first_block;
+        std::uint32_t block_count;
+        std::unique_ptr<std::byte, AlignedDelete> data;
+    };
+
+    std::vector<Chunk> _chunks;
+    std::uint32_t _block_size;
+    std::uint32_t _block_count;
+
+public:
+    static constexpr std::size_t FIRST_CHUNK_SIZE = 1024 * 1024;
+    static constexpr std::size_t MAX_CHUNK_SIZE = 64 * 1024 * 1024;
+
+    // Reads `file` to its end, or up to `block_count` blocks when given. Throws
+    // if the stream ends within a block, or before `block_count` blocks.
+    SpooledBlockDevice(CFile & file,
+                       std::uint32_t block_size,
+                       std::optional<std::uint32_t> block_count);
+    ~SpooledBlockDevice() override = default;
+
+    SpooledBlockDevice(SpooledBlockDevice const &) = delete;
+    SpooledBlockDevice & operator=(SpooledBlockDevice const &) = delete;
+
+    void
+        read(std::uint32_t block, std::uint32_t offset, void * buffer, std::uint32_t size) override;
+    void program(std::uint32_t block,
+                 std::uint32_t offset,
+                 void const * buffer,
+                 std::uint32_t size) override;
+    void erase(std::uint32_t block) override;
+    void sync() override;
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept override
+    {
+        return _block_size;
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept override
+    {
+        return _block_count;
+    }
+
+private:
+    [[nodiscard]] std::byte * locate(std::uint32_t block, std::uint32_t offset) const;
+};
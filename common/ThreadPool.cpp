@@ -0,0 +1,53 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(unsigned thread_count) : _mutex(), _condition(), _tasks(), _stopping(false)
+{
+    if (0 == thread_count)
+    {
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    _threads.reserve(thread_count);
+    for (unsigned index = 0; index < thread_count; ++index)
+    {
+        _threads.emplace_back(&ThreadPool::worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> const lock(_mutex);
+        _stopping = true;
+    }
+    _condition.notify_all();
+
+    for (auto & thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::worker()
+{
+    for (;;)
+    {
+        std::function<void()> task {};
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+            if (_tasks.empty())
+            {
+                return;
+            }
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+
+        // Exceptions are captured by the packaged task
+        task();
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// A fixed set of worker threads consuming a shared task queue.
+// Destroying the pool finishes every queued task before joining the workers.
+class ThreadPool final
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::queue<std::function<void()>> _tasks;
+    bool _stopping;
+    std::vector<std::thread> _threads;
+
+public:
+    // A thread count of 0 uses one thread per hardware thread
+    explicit ThreadPool(unsigned thread_count);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool & operator=(ThreadPool const &) = delete;
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F && function)
+    {
+        using Result = std::invoke_result_t<F>;
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> const lock(_mutex);
+            _tasks.emplace([task]() { (*task)(); });
+        }
+        _condition.notify_one();
+
+        return future;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return _threads.size();
+    }
+
+private:
+    void worker();
+};
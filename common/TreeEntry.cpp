@@ -0,0 +1,20 @@
+#include "TreeEntry.hpp"
+
+
+std::vector<TreeEntry> list_tree(LittleFS & filesystem)
+{
+    auto const tree = filesystem.file_tree("/");
+    auto const nodes = tree.nodes();
+
+    std::vector<TreeEntry> entries {};
+    entries.reserve(static_cast<std::size_t>(nodes.size()));
+
+    std::string path {};
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
+    {
+        tree.path(index, path);
+        entries.push_back({path, 0 != nodes[index].is_directory, nodes[index].size});
+    }
+
+    return entries;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <LittleFS.hpp>
+
+
+struct TreeEntry
+{
+    std::string path {};
+    bool is_directory {};
+    std::uint32_t size {};
+};
+
+// Every entry below the root, with absolute paths. Every directory comes
+// before its contents.
+[[nodiscard]] std::vector<TreeEntry> list_tree(LittleFS & filesystem);
@@ -68,3 +68,21 @@ std::uintmax_t file_size(std::string const & path)
 
     return size;
 }
+
+bool is_seekable(std::string const & path)
+{
+#if defined(_MSC_VER)
+    // Windows pipes only come in through standard input, which callers check for
+    static_cast<void>(path);
+    return true;
+#else
+    // Not file_size: opening a FIFO only to close it again would break its writer
+    struct stat status {};
+    if (-1 == stat(path.c_str(), &status))
+    {
+        throw std::system_error(errno, std::system_category(), "stat");
+    }
+
+    return !S_ISFIFO(status.st_mode) && !S_ISSOCK(status.st_mode);
+#endif
+}
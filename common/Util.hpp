@@ -5,3 +5,7 @@
 
 
 std::uintmax_t file_size(std::string const & path);
+
+// False for pipes and sockets, whose size cannot be found up front and which
+// can only be read once, front to back
+bool is_seekable(std::string const & path);
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockDeviceView.hpp>
+#include <BlockUsage.hpp>
+#include <ImageFile.hpp>
+#include <JsonWriter.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_analyze_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_file_path;
+    std::string report_file_path;
+    std::size_t top_files;
+    std::optional<std::string> heatmap_file_path;
+    std::uint32_t heatmap_width;
+    std::uint32_t blocks_per_cell;
+};
+
+
+namespace po = boost::program_options;
+
+
+namespace {
+
+constexpr std::size_t OWNER_COUNT = 5;
+
+// Heatmap characters, indexed by BlockOwner
+constexpr std::array<char, OWNER_COUNT> HEATMAP_CHARACTERS {'.', 'S', 'M', 'D', '?'};
+
+}  // namespace
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_ANALYZE_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_ANALYZE_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_ANALYZE_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_ANALYZE_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs image file")
+        ("report-file", po::value<std::string>()->default_value("-"), "JSON report")
+        ("top", po::value<std::size_t>()->default_value(10), "number of most fragmented files to report")
+        ("heatmap", po::value<std::string>(), "ASCII map of block owners")
+        ("heatmap-width", po::value<std::uint32_t>()->default_value(64), "heatmap cells per line")
+        ("blocks-per-cell", po::value<std::uint32_t>()->default_value(1), "blocks summarized by each heatmap cell")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
+                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] "
+                        "[--report-file REPORT_FILE] [--top N] [--heatmap HEATMAP_FILE "
+                        "[--heatmap-width CELLS] [--blocks-per-cell BLOCKS]]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-analyze {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.report_file_path = vm["report-file"].as<std::string>();
+    options.top_files = vm["top"].as<std::size_t>();
+    options.heatmap_width = vm["heatmap-width"].as<std::uint32_t>();
+    options.blocks_per_cell = vm["blocks-per-cell"].as<std::uint32_t>();
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+    if (0 != vm.count("heatmap"))
+    {
+        options.heatmap_file_path = vm["heatmap"].as<std::string>();
+    }
+
+    if (0 == options.heatmap_width || 0 == options.blocks_per_cell)
+    {
+        throw std::runtime_error("Heatmap dimensions must be positive");
+    }
+
+    return options;
+}
+
+void write_report(CommandLineOptions const & options,
+                  BlockUsage const & usage,
+                  std::ostream & stream)
+{
+    std::array<std::uint32_t, OWNER_COUNT> owner_counts {};
+    for (auto const owner : usage.owners)
+    {
+        ++owner_counts.at(static_cast<std::size_t>(owner));
+    }
+
+    JsonWriter writer(stream);
+
+    writer.begin_object()
+        .member("image", options.input_file_path)
+        .member("littlefs_version", options.version)
+        .member("block_size", options.block_size)
+        .member("block_count", options.block_count.value());
+
+    writer.key("blocks").begin_object();
+    for (std::size_t owner = 0; owner < OWNER_COUNT; ++owner)
+    {
+        writer.member(block_owner_name(static_cast<BlockOwner>(owner)), owner_counts.at(owner));
+    }
+    writer.end_object();
+
+    auto const metadata_blocks = owner_counts.at(static_cast<std::size_t>(BlockOwner::Superblock))
+                                 + owner_counts.at(static_cast<std::size_t>(BlockOwner::Metadata));
+    auto const data_blocks = owner_counts.at(static_cast<std::size_t>(BlockOwner::Data));
+    writer.member("metadata_to_data_ratio",
+                  0 == data_blocks ? 0.0 : static_cast<double>(metadata_blocks) / data_blocks);
+    writer.member("inline_bytes", usage.inline_bytes);
+
+    // Fragmentation, over the files stored in CTZ skip-lists
+    std::vector<FileFragmentation const *> files {};
+    std::uint64_t file_blocks = 0;
+    std::uint64_t file_extents = 0;
+    std::uint64_t fragmented_files = 0;
+    for (auto const & file : usage.files)
+    {
+        if (0 == file.blocks)
+        {
+            continue;
+        }
+        files.push_back(&file);
+        file_blocks += file.blocks;
+        file_extents += file.extents;
+        fragmented_files += (file.extents > 1) ? 1 : 0;
+    }
+
+    auto const top_files = std::min(options.top_files, files.size());
+    std::partial_sort(files.begin(),
+                      files.begin() + static_cast<std::ptrdiff_t>(top_files),
+                      files.end(),
+                      [](auto const * first, auto const * second) {
+                          return first->extents > second->extents;
+                      });
+
+    writer.key("fragmentation")
+        .begin_object()
+        .member("files", static_cast<std::uint64_t>(files.size()))
+        .member("inline_files", static_cast<std::uint64_t>(usage.files.size() - files.size()))
+        .member("fragmented_files", fragmented_files)
+        .member("average_extent_blocks",
+                0 == file_extents
+                    ? 0.0
+                    : static_cast<double>(file_blocks) / static_cast<double>(file_extents));
+    writer.key("most_fragmented").begin_array();
+    for (std::size_t index = 0; index < top_files; ++index)
+    {
+        auto const & file = *files[index];
+        writer.begin_object()
+            .member("path", file.path)
+            .member("size", file.size)
+            .member("blocks", file.blocks)
+            .member("extents", file.extents)
+            .end_object();
+    }
+    writer.end_array().end_object();
+
+    // A pair whose log holds a single commit has just been compacted; long logs
+    // mean littlefs has to read through many commits on every fetch
+    std::uint64_t compacted_pairs = 0;
+    double total_fill = 0.0;
+    writer.key("metadata_pairs").begin_array();
+    for (auto const & pair : usage.pairs)
+    {
+        auto const fill = static_cast<double>(pair.log.size) / options.block_size;
+        compacted_pairs += (pair.log.commits <= 1) ? 1 : 0;
+        total_fill += fill;
+
+        writer.begin_object().member("path", pair.path).key("blocks").begin_array();
+        writer.value(pair.blocks[0]).value(pair.blocks[1]).end_array();
+        writer.member("revision", pair.log.revision)
+            .member("commits", pair.log.commits)
+            .member("log_bytes", pair.log.size)
+            .member("fill", fill)
+            .end_object();
+    }
+    writer.end_array();
+    writer.member("compacted_pairs", compacted_pairs)
+        .member("average_pair_fill",
+                usage.pairs.empty() ? 0.0 : total_fill / static_cast<double>(usage.pairs.size()));
+
+    auto const free = free_space(usage.owners);
+    writer.key("free_space")
+        .begin_object()
+        .member("blocks", free.blocks)
+        .member("runs", free.runs)
+        .member("largest_run", free.largest_run);
+    writer.key("histogram").begin_array();
+    for (std::size_t bucket = 0; bucket < free.run_histogram.size(); ++bucket)
+    {
+        writer.begin_object()
+            .member("min_blocks", static_cast<std::uint64_t>(1) << bucket)
+            .member("runs", free.run_histogram[bucket])
+            .end_object();
+    }
+    writer.end_array().end_object();
+
+    writer.end_object();
+    stream << "\n";
+}
+
+// One character per cell. A cell covering several blocks shows its most
+// common owner.
+void write_heatmap(CommandLineOptions const & options,
+                   std::vector<BlockOwner> const & owners,
+                   std::ostream & stream)
+{
+    auto const block_count = static_cast<std::uint32_t>(owners.size());
+    auto const blocks_per_line = options.heatmap_width * options.blocks_per_cell;
+    auto const number_width = fmt::format("{}", block_count).size();
+
+    stream << "# . free  S superblock  M metadata  D data  ? orphan\n";
+    for (std::uint32_t line = 0; line < block_count; line += blocks_per_line)
+    {
+        stream << fmt::format("{:>{}} ", line, number_width);
+
+        auto const line_end = std::min(block_count, line + blocks_per_line);
+        for (auto cell = line; cell < line_end; cell += options.blocks_per_cell)
+        {
+            std::array<std::uint32_t, OWNER_COUNT> counts {};
+            auto const cell_end = std::min(line_end, cell + options.blocks_per_cell);
+            for (auto block = cell; block < cell_end; ++block)
+            {
+                ++counts.at(static_cast<std::size_t>(owners[block]));
+            }
+
+            auto const dominant = std::max_element(counts.cbegin(), counts.cend());
+            stream << HEATMAP_CHARACTERS.at(
+                static_cast<std::size_t>(std::distance(counts.cbegin(), dominant)));
+        }
+        stream << "\n";
+    }
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    // The analysis issues many small, scattered reads, so the image is read into
+    // memory once, sequentially
+    options->block_count =
+        image_block_count(options->input_file_path, options->block_size, options->block_count);
+    auto image = load_image(options->input_file_path, options->block_size, *options->block_count);
+    auto filesystem = open_filesystem(options->version,
+                                      std::make_unique<BlockDeviceView>(*image),
+                                      options->read_size,
+                                      options->prog_size);
+
+    auto const usage = analyze_block_usage(*filesystem, *image, options->version);
+
+    if (options->report_file_path == "-")
+    {
+        write_report(*options, usage, std::cout);
+    }
+    else
+    {
+        std::ofstream report_file(options->report_file_path);
+        report_file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+        write_report(*options, usage, report_file);
+    }
+
+    if (options->heatmap_file_path)
+    {
+        std::ofstream heatmap_file(*options->heatmap_file_path);
+        heatmap_file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+        write_heatmap(*options, usage.owners, heatmap_file);
+    }
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
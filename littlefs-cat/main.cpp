@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <CFile.hpp>
+#include <FileBlockDevice.hpp>
+#include <FileRange.hpp>
+#include <ImageFile.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_cat_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_file_path;
+    std::string path;
+    std::string output_file_path;
+    FileRange range;
+    std::size_t buffer_size;
+};
+
+
+namespace po = boost::program_options;
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_CAT_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_CAT_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_CAT_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_CAT_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs image file")
+        ("path,f", po::value<std::string>()->required(), "path of the file to read in the image")
+        ("output-file,o", po::value<std::string>()->default_value("-"), "output file")
+        ("offset", po::value<std::int64_t>()->default_value(0), "first byte to read; negative counts back from the end")
+        ("length", po::value<std::uint64_t>(), "number of bytes to read (default: up to the end)")
+        ("tail", po::value<std::uint64_t>(), "read the last TAIL bytes")
+        ("buffer-size", po::value<std::size_t>()->default_value(DEFAULT_RANGE_BUFFER_SIZE), "size of each read and write")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE -f PATH [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
+                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] [-o OUTPUT_FILE] "
+                        "[--offset OFFSET | --tail TAIL] [--length LENGTH] "
+                        "[--buffer-size BUFFER_SIZE]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-cat {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.path = vm["path"].as<std::string>();
+    options.output_file_path = vm["output-file"].as<std::string>();
+    options.buffer_size = vm["buffer-size"].as<std::size_t>();
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    if (0 == options.buffer_size)
+    {
+        throw std::invalid_argument("Buffer size must not be 0");
+    }
+
+    auto const offset = vm["offset"].as<std::int64_t>();
+    options.range.from_end = offset < 0;
+    options.range.offset = offset < 0 ? static_cast<std::uint64_t>(-(offset + 1)) + 1
+                                      : static_cast<std::uint64_t>(offset);
+    if (0 != vm.count("tail"))
+    {
+        if (!vm["offset"].defaulted())
+        {
+            throw std::runtime_error("--tail and --offset are mutually exclusive");
+        }
+
+        // --tail 0 reads nothing, unlike --offset 0
+        options.range.from_end = true;
+        options.range.offset = vm["tail"].as<std::uint64_t>();
+    }
+    if (0 != vm.count("length"))
+    {
+        options.range.length = vm["length"].as<std::uint64_t>();
+    }
+
+    return options;
+}
+
+std::unique_ptr<IBlockDevice> open_image(CommandLineOptions & options)
+{
+    options.block_count =
+        image_block_count(options.input_file_path, options.block_size, options.block_count);
+
+    return std::make_unique<FileBlockDevice>(options.input_file_path,
+                                             false,
+                                             options.block_size,
+                                             options.block_count.value());
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    auto const filesystem = open_filesystem(
+        options->version, open_image(*options), options->read_size, options->prog_size);
+
+    auto output_file = options->output_file_path == "-" ? CFile::standard_output()
+                                                        : CFile(options->output_file_path, "wb");
+
+    auto const is_absolute = !options->path.empty() && options->path.front() == '/';
+    auto const path = is_absolute ? options->path : "/" + options->path;
+    read_file_range(
+        *filesystem,
+        path,
+        options->range,
+        [&output_file](gsl::span<std::byte const> const data) {
+            if (output_file.write(data) != static_cast<std::size_t>(data.size()))
+            {
+                throw std::runtime_error("Failed writing output");
+            }
+        },
+        options->buffer_size);
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
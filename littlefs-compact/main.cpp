@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockDeviceView.hpp>
+#include <ImageFile.hpp>
+#include <ImagePacker.hpp>
+#include <ImageSynthesizer2.hpp>
+#include <LittleFileInputStream.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <TreeEntry.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_compact_config.h>
+#include <littlefs_utils_config.h>
+
+#include <LittleFS1.hpp>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_file_path;
+    std::string output_file_path;
+    bool shrink;
+    bool verify;
+};
+
+
+namespace po = boost::program_options;
+
+
+namespace {
+
+// The superblock pair and the root directory pair of littlefs v1
+constexpr std::uint32_t LFS1_RESERVED_BLOCKS = 4;
+
+constexpr std::size_t VERIFY_BUFFER_SIZE = 1024 * 1024;
+
+class VerificationError : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+}  // namespace
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_COMPACT_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_COMPACT_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_COMPACT_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_COMPACT_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs image file")
+        ("output-file,o", po::value<std::string>()->required(), "compacted image file")
+        ("shrink", "reduce the block count to the minimum the content needs")
+        ("verify", "mount the compacted image and compare it with the input")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE -o OUTPUT_FILE [-l LITTLEFS_VERSION] "
+                        "[-b BLOCK_SIZE] [-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] "
+                        "[--shrink] [--verify]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-compact {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.output_file_path = vm["output-file"].as<std::string>();
+    options.shrink = (0 != vm.count("shrink"));
+    options.verify = (0 != vm.count("verify"));
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    return options;
+}
+
+// littlefs 2 images are laid out directly: one compacted metadata pair per
+// directory right after the superblock, then every file's data in order
+std::unique_ptr<MemoryBlockDevice> compact2(LittleFS & source,
+                                            std::vector<TreeEntry> const & entries,
+                                            CommandLineOptions const & options)
+{
+    ImageSynthesizer2 synthesizer(
+        {options.block_size, options.block_count.value(), options.prog_size, 0});
+
+    for (auto const & entry : entries)
+    {
+        if (entry.is_directory)
+        {
+            synthesizer.add_directory(entry.path);
+            continue;
+        }
+
+        synthesizer.add_file(entry.path, entry.size, [&source, path = entry.path]() {
+            return std::make_unique<LittleFileInputStream>(
+                source.open_file(path, LittleFS::OpenFlags::Read));
+        });
+    }
+
+    auto block_count = options.block_count.value();
+    if (options.shrink)
+    {
+        block_count = synthesizer.required_blocks();
+        synthesizer.set_block_count(block_count);
+    }
+
+    auto image = std::make_unique<MemoryBlockDevice>(options.block_size, block_count);
+    synthesizer.write(*image);
+
+    return image;
+}
+
+// littlefs 1 has no direct layout, but it allocates blocks in ascending order
+// on a fresh image. Creating every directory first keeps the metadata pairs
+// together, and writing each file in one go keeps its data contiguous.
+void write_tree1(LittleFS & source,
+                 std::vector<TreeEntry> const & entries,
+                 CommandLineOptions const & options,
+                 MemoryBlockDevice & image)
+{
+    LittleFS1::format(image, options.read_size, options.prog_size);
+    LittleFS1 target(
+        std::make_unique<BlockDeviceView>(image), options.read_size, options.prog_size);
+
+    PackGeometry geometry {};
+    geometry.block_size = options.block_size;
+    geometry.block_count = image.block_count();
+    geometry.reserved_blocks = LFS1_RESERVED_BLOCKS;
+
+    ImagePacker packer(target, geometry);
+    for (auto const & entry : entries)
+    {
+        if (entry.is_directory)
+        {
+            packer.add_directory(entry.path);
+        }
+    }
+    for (auto const & entry : entries)
+    {
+        if (!entry.is_directory)
+        {
+            LittleFileInputStream stream(source.open_file(entry.path, LittleFS::OpenFlags::Read));
+            packer.add_file(entry.path, stream);
+        }
+    }
+}
+
+void verify_copy(LittleFS & source, LittleFS & copy)
+{
+    auto const expected = list_tree(source);
+    auto actual = list_tree(copy);
+
+    auto sorted_expected = expected;
+    auto const by_path = [](TreeEntry const & first, TreeEntry const & second) {
+        return first.path < second.path;
+    };
+    std::sort(sorted_expected.begin(), sorted_expected.end(), by_path);
+    std::sort(actual.begin(), actual.end(), by_path);
+
+    auto const same_entry = [](TreeEntry const & first, TreeEntry const & second) {
+        return std::tie(first.path, first.is_directory, first.size)
+               == std::tie(second.path, second.is_directory, second.size);
+    };
+    if (!std::equal(sorted_expected.cbegin(),
+                    sorted_expected.cend(),
+                    actual.cbegin(),
+                    actual.cend(),
+                    same_entry))
+    {
+        throw VerificationError("Verification failed: the directory trees differ");
+    }
+
+    std::vector<std::byte> expected_buffer(VERIFY_BUFFER_SIZE);
+    std::vector<std::byte> actual_buffer(VERIFY_BUFFER_SIZE);
+    for (auto const & entry : expected)
+    {
+        if (entry.is_directory)
+        {
+            continue;
+        }
+
+        auto const expected_file = source.open_file(entry.path, LittleFS::OpenFlags::Read);
+        auto const actual_file = copy.open_file(entry.path, LittleFS::OpenFlags::Read);
+        for (;;)
+        {
+            auto const expected_read = expected_file->read(expected_buffer);
+            auto const actual_read = actual_file->read(actual_buffer);
+            if (expected_read != actual_read
+                || 0 != std::memcmp(expected_buffer.data(), actual_buffer.data(), actual_read))
+            {
+                throw VerificationError(
+                    fmt::format("Verification failed: contents of {} differ", entry.path));
+            }
+            if (0 == actual_read)
+            {
+                break;
+            }
+        }
+    }
+}
+
+std::unique_ptr<MemoryBlockDevice> compact1(LittleFS & source,
+                                            std::vector<TreeEntry> const & entries,
+                                            CommandLineOptions const & options)
+{
+    auto image = std::make_unique<MemoryBlockDevice>(options.block_size,
+                                                     options.block_count.value());
+    write_tree1(source, entries, options, *image);
+    if (!options.shrink)
+    {
+        return image;
+    }
+
+    std::uint32_t used_blocks = 0;
+    {
+        LittleFS1 compacted(
+            std::make_unique<BlockDeviceView>(*image), options.read_size, options.prog_size);
+        used_blocks = compacted.used_blocks();
+    }
+
+    // The blocks in use are a lower bound: lfs1 may need a little room to work
+    // with while writing. The smallest image everything fits in is searched for
+    // between that and the full block count, which is known to fit. A candidate
+    // only counts as fitting once its contents compare equal to the source.
+    auto low = used_blocks;
+    auto high = options.block_count.value();
+    while (low < high)
+    {
+        auto const block_count = low + (high - low) / 2;
+        auto shrunk = std::make_unique<MemoryBlockDevice>(options.block_size, block_count);
+        try
+        {
+            write_tree1(source, entries, options, *shrunk);
+
+            LittleFS1 candidate(
+                std::make_unique<BlockDeviceView>(*shrunk), options.read_size, options.prog_size);
+            verify_copy(source, candidate);
+        }
+        catch (ImageFullError const &)
+        {
+            low = block_count + 1;
+            continue;
+        }
+        catch (VerificationError const &)
+        {
+            low = block_count + 1;
+            continue;
+        }
+        image = std::move(shrunk);
+        high = block_count;
+    }
+
+    return image;
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    // The source is read into memory first, so the output may replace the input
+    options->block_count =
+        image_block_count(options->input_file_path, options->block_size, options->block_count);
+    auto const source_image =
+        load_image(options->input_file_path, options->block_size, *options->block_count);
+    auto source = open_filesystem(options->version,
+                                  std::make_unique<BlockDeviceView>(*source_image),
+                                  options->read_size,
+                                  options->prog_size);
+    auto const used_before = source->used_blocks();
+
+    auto const entries = list_tree(*source);
+
+    std::unique_ptr<MemoryBlockDevice> image {};
+    switch (options->version)
+    {
+    case 1:
+        image = compact1(*source, entries, *options);
+        break;
+
+    case 2:
+        image = compact2(*source, entries, *options);
+        break;
+
+    default:
+        throw std::runtime_error("Invalid littlefs version specified");
+    }
+
+    auto compacted = open_filesystem(options->version,
+                                     std::make_unique<BlockDeviceView>(*image),
+                                     options->read_size,
+                                     options->prog_size);
+    if (options->verify)
+    {
+        verify_copy(*source, *compacted);
+    }
+    auto const used_after = compacted->used_blocks();
+
+    save_image(image->data(), options->output_file_path);
+
+    std::cout << fmt::format("{} entries: {} blocks used before, {} after, "
+                             "image of {} blocks\n",
+                             entries.size(),
+                             used_before,
+                             used_after,
+                             image->block_count());
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
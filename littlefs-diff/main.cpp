@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+#include <xxhash.h>
+
+#include <BlockDeviceView.hpp>
+#include <BlockHash.hpp>
+#include <BlockPatch.hpp>
+#include <Ctz.hpp>
+#include <ImageFile.hpp>
+#include <JsonWriter.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <Util.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_diff_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string old_file_path;
+    std::string new_file_path;
+    std::optional<std::string> patch_file_path;
+    unsigned jobs;
+    std::string report_file_path;
+};
+
+
+namespace po = boost::program_options;
+
+
+namespace {
+
+constexpr std::size_t READ_BUFFER_SIZE = 64 * 1024;
+
+enum class OwnerKind : std::uint8_t
+{
+    Free,
+    Superblock,
+    Metadata,
+    File,
+};
+
+struct Owner
+{
+    OwnerKind kind {OwnerKind::Free};
+    // Index of the directory for metadata, of the file for data
+    std::uint32_t index {};
+};
+
+struct FileExtents
+{
+    std::string path {};
+    std::uint32_t size {};
+    bool is_inline {};
+    std::vector<std::uint32_t> blocks {};
+};
+
+// Where every file and directory of an image lives. Both lists are sorted by
+// path, since the tree walk visits them in directory order.
+struct ImageMap
+{
+    std::vector<std::string> directories {};
+    std::vector<FileExtents> files {};
+    std::vector<Owner> owners {};
+};
+
+struct FileChange
+{
+    std::string path {};
+    std::uint32_t old_size {};
+    std::uint32_t new_size {};
+    std::uint32_t changed_blocks {};
+};
+
+// Path, and whether it is a directory
+using Entry = std::pair<std::string, bool>;
+
+struct Changes
+{
+    std::vector<std::uint32_t> blocks {};
+    std::vector<Entry> added {};
+    std::vector<Entry> removed {};
+    std::vector<FileChange> modified {};
+};
+
+char const * owner_kind_name(OwnerKind const kind) noexcept
+{
+    switch (kind)
+    {
+    case OwnerKind::Free:
+        return "free";
+    case OwnerKind::Superblock:
+        return "superblock";
+    case OwnerKind::Metadata:
+        return "metadata";
+    case OwnerKind::File:
+        return "file";
+    }
+    return "unknown";
+}
+
+}  // namespace
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_DIFF_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_DIFF_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_DIFF_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_DIFF_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("old-file,a", po::value<std::string>()->required(), "littlefs image to compare against")
+        ("new-file,n", po::value<std::string>()->required(), "littlefs image to compare")
+        ("patch-file,o", po::value<std::string>(), "block patch turning the old image into the new one")
+        ("jobs,j", po::value<unsigned>()->default_value(0), "number of hashing threads (0 = one per hardware thread)")
+        ("report-file", po::value<std::string>()->default_value("-"), "JSON report")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -a OLD_FILE -n NEW_FILE [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
+                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] [-o PATCH_FILE] "
+                        "[-j JOBS] [--report-file REPORT_FILE]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-diff {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.old_file_path = vm["old-file"].as<std::string>();
+    options.new_file_path = vm["new-file"].as<std::string>();
+    options.jobs = vm["jobs"].as<unsigned>();
+    options.report_file_path = vm["report-file"].as<std::string>();
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+    if (0 != vm.count("patch-file"))
+    {
+        options.patch_file_path = vm["patch-file"].as<std::string>();
+    }
+
+    return options;
+}
+
+ImageMap map_image(LittleFS & filesystem, IBlockDevice & block_device)
+{
+    ImageMap map {};
+    map.directories.emplace_back("/");
+
+    auto const tree = filesystem.file_tree("/");
+    auto const nodes = tree.nodes();
+
+    std::string path {};
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
+    {
+        tree.path(index, path);
+        if (0 != nodes[index].is_directory)
+        {
+            map.directories.push_back(path);
+            continue;
+        }
+
+        auto const file = filesystem.open_file(path, LittleFS::OpenFlags::Read);
+        auto const layout = file->layout();
+
+        FileExtents extents {path, layout.size, layout.is_inline, {}};
+        if (!layout.is_inline)
+        {
+            extents.blocks = ctz_blocks(block_device, layout.head, layout.size);
+        }
+        map.files.push_back(std::move(extents));
+    }
+
+    // The owners refer to both lists by index, so they are sorted first
+    std::sort(map.directories.begin(), map.directories.end());
+    std::sort(map.files.begin(), map.files.end(), [](auto const & first, auto const & second) {
+        return first.path < second.path;
+    });
+
+    map.owners.resize(block_device.block_count());
+    auto const claim = [&map](std::uint32_t const block, Owner const owner) {
+        if (block < map.owners.size() && OwnerKind::Free == map.owners[block].kind)
+        {
+            map.owners[block] = owner;
+        }
+    };
+
+    for (std::uint32_t index = 0; index < map.directories.size(); ++index)
+    {
+        for (auto const block : filesystem.directory_blocks(map.directories[index]))
+        {
+            claim(block, {OwnerKind::Metadata, index});
+        }
+    }
+    for (std::uint32_t index = 0; index < map.files.size(); ++index)
+    {
+        for (auto const block : map.files[index].blocks)
+        {
+            claim(block, {OwnerKind::File, index});
+        }
+    }
+
+    // littlefs 1 keeps the superblock apart from the root directory
+    claim(0, {OwnerKind::Superblock, 0});
+    claim(1, {OwnerKind::Superblock, 0});
+
+    return map;
+}
+
+std::uint64_t content_hash(LittleFS & filesystem, std::string const & path)
+{
+    std::unique_ptr<XXH3_state_t, decltype(&XXH3_freeState)> state(XXH3_createState(),
+                                                                   &XXH3_freeState);
+    if (nullptr == state)
+    {
+        throw std::bad_alloc();
+    }
+    XXH3_64bits_reset(state.get());
+
+    auto const file = filesystem.open_file(path, LittleFS::OpenFlags::Read);
+    std::vector<std::byte> buffer(READ_BUFFER_SIZE);
+    for (;;)
+    {
+        auto const count = file->read(buffer);
+        if (0 == count)
+        {
+            break;
+        }
+        XXH3_64bits_update(state.get(), buffer.data(), count);
+    }
+
+    return XXH3_64bits_digest(state.get());
+}
+
+// A file whose skip-list kept its blocks changed exactly when one of them did.
+// Otherwise littlefs copied it somewhere else, and only the contents tell.
+bool is_modified(FileExtents const & old_file,
+                 LittleFS & old_filesystem,
+                 FileExtents const & new_file,
+                 LittleFS & new_filesystem,
+                 std::vector<bool> const & changed)
+{
+    if (old_file.size != new_file.size)
+    {
+        return true;
+    }
+
+    if (!old_file.is_inline && !new_file.is_inline && old_file.blocks == new_file.blocks)
+    {
+        return std::any_of(new_file.blocks.cbegin(),
+                           new_file.blocks.cend(),
+                           [&changed](std::uint32_t const block) { return changed[block]; });
+    }
+
+    return content_hash(old_filesystem, old_file.path)
+           != content_hash(new_filesystem, new_file.path);
+}
+
+// Walks both sorted listings side by side
+template <typename T, typename GetPath, typename OnOld, typename OnNew, typename OnBoth>
+void merge_sorted(std::vector<T> const & old_entries,
+                  std::vector<T> const & new_entries,
+                  GetPath get_path,
+                  OnOld on_old,
+                  OnNew on_new,
+                  OnBoth on_both)
+{
+    auto old_entry = old_entries.cbegin();
+    auto new_entry = new_entries.cbegin();
+    while (old_entry != old_entries.cend() || new_entry != new_entries.cend())
+    {
+        if (new_entry == new_entries.cend()
+            || (old_entry != old_entries.cend() && get_path(*old_entry) < get_path(*new_entry)))
+        {
+            on_old(*old_entry++);
+        }
+        else if (old_entry == old_entries.cend() || get_path(*new_entry) < get_path(*old_entry))
+        {
+            on_new(*new_entry++);
+        }
+        else
+        {
+            on_both(*old_entry++, *new_entry++);
+        }
+    }
+}
+
+Changes compare_images(ImageMap const & old_map,
+                       LittleFS & old_filesystem,
+                       ImageMap const & new_map,
+                       LittleFS & new_filesystem,
+                       std::vector<std::uint64_t> const & old_hashes,
+                       std::vector<std::uint64_t> const & new_hashes)
+{
+    Changes changes {};
+
+    std::vector<bool> changed(new_hashes.size(), false);
+    std::vector<std::uint32_t> changed_per_file(new_map.files.size(), 0);
+    for (std::uint32_t block = 0; block < new_hashes.size(); ++block)
+    {
+        if (old_hashes[block] == new_hashes[block])
+        {
+            continue;
+        }
+
+        changed[block] = true;
+        changes.blocks.push_back(block);
+
+        auto const & owner = new_map.owners[block];
+        if (OwnerKind::File == owner.kind)
+        {
+            ++changed_per_file[owner.index];
+        }
+    }
+
+    merge_sorted(
+        old_map.directories,
+        new_map.directories,
+        [](std::string const & path) -> std::string const & { return path; },
+        [&](std::string const & path) { changes.removed.emplace_back(path, true); },
+        [&](std::string const & path) { changes.added.emplace_back(path, true); },
+        [](std::string const &, std::string const &) {});
+
+    auto const * const first_new_file = new_map.files.data();
+    merge_sorted(
+        old_map.files,
+        new_map.files,
+        [](FileExtents const & file) -> std::string const & { return file.path; },
+        [&](FileExtents const & file) { changes.removed.emplace_back(file.path, false); },
+        [&](FileExtents const & file) { changes.added.emplace_back(file.path, false); },
+        [&](FileExtents const & old_file, FileExtents const & new_file) {
+            if (is_modified(old_file, old_filesystem, new_file, new_filesystem, changed))
+            {
+                auto const index = static_cast<std::size_t>(&new_file - first_new_file);
+                changes.modified.push_back(
+                    {new_file.path, old_file.size, new_file.size, changed_per_file[index]});
+            }
+        });
+
+    auto const by_path = [](auto const & first, auto const & second) {
+        return first.first < second.first;
+    };
+    std::sort(changes.added.begin(), changes.added.end(), by_path);
+    std::sort(changes.removed.begin(), changes.removed.end(), by_path);
+
+    return changes;
+}
+
+BlockPatch make_patch(MemoryBlockDevice const & old_image,
+                      MemoryBlockDevice const & new_image,
+                      std::vector<std::uint32_t> const & blocks,
+                      std::vector<std::uint64_t> const & old_hashes,
+                      std::vector<std::uint64_t> const & new_hashes)
+{
+    auto const block_size = old_image.block_size();
+    auto const block_data = [block_size](MemoryBlockDevice const & image,
+                                         std::uint32_t const block) {
+        auto const offset = static_cast<std::size_t>(block) * block_size;
+        return image.data().subspan(static_cast<std::ptrdiff_t>(offset), block_size);
+    };
+
+    BlockPatch patch(block_size, old_image.block_count());
+    for (auto const block : blocks)
+    {
+        patch.add(block,
+                  block_data(old_image, block),
+                  old_hashes[block],
+                  block_data(new_image, block),
+                  new_hashes[block]);
+    }
+
+    return patch;
+}
+
+void write_owner(JsonWriter & writer, ImageMap const & map, std::uint32_t const block)
+{
+    auto const & owner = map.owners[block];
+
+    writer.begin_object().member("kind", owner_kind_name(owner.kind));
+    if (OwnerKind::Metadata == owner.kind)
+    {
+        writer.member("path", map.directories[owner.index]);
+    }
+    else if (OwnerKind::File == owner.kind)
+    {
+        writer.member("path", map.files[owner.index].path);
+    }
+    writer.end_object();
+}
+
+void write_report(CommandLineOptions const & options,
+                  ImageMap const & old_map,
+                  ImageMap const & new_map,
+                  Changes const & changes,
+                  std::optional<BlockPatch> const & patch,
+                  std::ostream & stream)
+{
+    JsonWriter writer(stream);
+
+    writer.begin_object()
+        .member("old_image", options.old_file_path)
+        .member("new_image", options.new_file_path)
+        .member("littlefs_version", options.version)
+        .member("block_size", options.block_size)
+        .member("block_count", options.block_count.value())
+        .member("changed_blocks", static_cast<std::uint64_t>(changes.blocks.size()));
+
+    writer.key("blocks").begin_array();
+    for (auto const block : changes.blocks)
+    {
+        writer.begin_object().member("block", block);
+        writer.key("old");
+        write_owner(writer, old_map, block);
+        writer.key("new");
+        write_owner(writer, new_map, block);
+        writer.end_object();
+    }
+    writer.end_array();
+
+    auto const write_entries = [&writer](std::vector<Entry> const & entries) {
+        writer.begin_array();
+        for (auto const & [path, is_directory] : entries)
+        {
+            writer.begin_object()
+                .member("path", path)
+                .member("directory", is_directory)
+                .end_object();
+        }
+        writer.end_array();
+    };
+
+    writer.key("added");
+    write_entries(changes.added);
+    writer.key("removed");
+    write_entries(changes.removed);
+
+    writer.key("modified").begin_array();
+    for (auto const & file : changes.modified)
+    {
+        writer.begin_object()
+            .member("path", file.path)
+            .member("old_size", file.old_size)
+            .member("new_size", file.new_size)
+            .member("changed_blocks", file.changed_blocks)
+            .end_object();
+    }
+    writer.end_array();
+
+    if (patch)
+    {
+        writer.key("patch")
+            .begin_object()
+            .member("file", options.patch_file_path.value())
+            .member("records", static_cast<std::uint64_t>(patch->records().size()))
+            .member("bytes", patch->size())
+            .end_object();
+    }
+
+    writer.end_object();
+    stream << "\n";
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    if (!options->block_count
+        && file_size(options->old_file_path) != file_size(options->new_file_path))
+    {
+        throw std::runtime_error("The images differ in size");
+    }
+
+    // Both images are hashed as a whole and then walked with many small reads,
+    // so they are read into memory once, sequentially
+    options->block_count =
+        image_block_count(options->old_file_path, options->block_size, options->block_count);
+    auto old_image = load_image(options->old_file_path, options->block_size, *options->block_count);
+    auto new_image = load_image(options->new_file_path, options->block_size, *options->block_count);
+
+    auto const old_hashes = hash_blocks(old_image->data(), options->block_size, options->jobs);
+    auto const new_hashes = hash_blocks(new_image->data(), options->block_size, options->jobs);
+
+    auto old_filesystem = open_filesystem(options->version,
+                                          std::make_unique<BlockDeviceView>(*old_image),
+                                          options->read_size,
+                                          options->prog_size);
+    auto new_filesystem = open_filesystem(options->version,
+                                          std::make_unique<BlockDeviceView>(*new_image),
+                                          options->read_size,
+                                          options->prog_size);
+
+    auto const old_map = map_image(*old_filesystem, *old_image);
+    auto const new_map = map_image(*new_filesystem, *new_image);
+
+    auto const changes = compare_images(
+        old_map, *old_filesystem, new_map, *new_filesystem, old_hashes, new_hashes);
+
+    std::optional<BlockPatch> patch {};
+    if (options->patch_file_path)
+    {
+        patch = make_patch(*old_image, *new_image, changes.blocks, old_hashes, new_hashes);
+        patch->save(*options->patch_file_path);
+    }
+
+    if (options->report_file_path == "-")
+    {
+        write_report(*options, old_map, new_map, changes, patch, std::cout);
+    }
+    else
+    {
+        std::ofstream report_file(options->report_file_path);
+        report_file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+        write_report(*options, old_map, new_map, changes, patch, report_file);
+    }
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
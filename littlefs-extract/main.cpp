@@ -1,13 +1,20 @@
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <queue>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -15,10 +22,25 @@
 #include <fmt/core.h>
 #include <gsl/gsl>
 
+#include <BlobStore.hpp>
+#include <BlockDeviceView.hpp>
+#include <BoundedQueue.hpp>
 #include <CFile.hpp>
+#include <CachingBlockDevice.hpp>
+#include <CtzInputStream.hpp>
+#include <Digest.hpp>
+#include <DirectoryIndex.hpp>
 #include <FileBlockDevice.hpp>
+#include <FileDigester.hpp>
+#include <ImageFile.hpp>
+#include <JsonWriter.hpp>
 #include <LittleFileInputStream.hpp>
+#include <MemoryInputStream.hpp>
+#include <MetadataPrefetch.hpp>
 #include <OutputArchive.hpp>
+#include <RecordingBlockDevice.hpp>
+#include <SpooledBlockDevice.hpp>
+#include <ThreadPool.hpp>
 #include <Util.hpp>
 
 #if defined(_MSC_VER)
@@ -28,9 +50,6 @@
 #include <littlefs_extract_config.h>
 #include <littlefs_utils_config.h>
 
-#include <LittleFS1.hpp>
-#include <LittleFS2.hpp>
-
 
 struct CommandLineOptions
 {
@@ -41,6 +60,45 @@ struct CommandLineOptions
     std::uint32_t prog_size;
     std::string input_file_path;
     std::string output_file_path;
+    bool prefetch_metadata;
+    std::optional<std::string> index_file_path;
+    std::optional<DigestAlgorithm> digest;
+    std::optional<std::string> manifest_file_path;
+    unsigned digest_threads;
+    bool dedup;
+    unsigned shards;
+    std::optional<std::string> shard_index_file_path;
+    std::optional<std::string> blob_store_path;
+    std::optional<std::string> batch_file_path;
+    unsigned jobs;
+    std::string summary_file_path;
+};
+
+struct ExtractionStatistics
+{
+    std::uint64_t files;
+    std::uint64_t bytes;
+    // Files that were not written out again, because their contents were
+    std::uint64_t deduplicated_files;
+    std::uint64_t deduplicated_bytes;
+};
+
+struct ShardedFile
+{
+    std::string path;
+    std::uint64_t size;
+    // Entry of the file in the directory index, when there is one
+    std::uint32_t entry;
+};
+
+struct BatchJobResult
+{
+    std::size_t line;
+    std::string input_file_path;
+    std::string output_file_path;
+    double seconds;
+    std::optional<ExtractionStatistics> statistics;
+    std::string error;
 };
 
 
@@ -49,22 +107,280 @@ namespace po = boost::program_options;
 
 static constexpr int TAR_FILE_PERMISSIONS = 0644;
 
+// Files up to this size are hashed from memory for dedup, larger ones are read twice
+static constexpr std::size_t DEDUP_MEMORY_LIMIT = 64 * 1024 * 1024;
+static constexpr std::size_t DEDUP_READ_BUFFER_SIZE = 1024 * 1024;
 
-std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
-                                                     std::vector<std::string> const & args)
+
+using StreamFactory = std::function<std::unique_ptr<IInputStream>()>;
+
+// What an extraction keeps between images. Each batch worker has one, so its
+// buffers are reused from one job to the next.
+struct WorkerState
 {
-    po::options_description desc("Allowed options");
+    std::vector<std::byte> copy_buffer {};
+    std::vector<std::byte> dedup_buffer {};
+    // Threads validating prefetched metadata, 0 for one per hardware thread.
+    // Batch jobs validate on their own worker, which keeps the batch within -j.
+    unsigned prefetch_threads {};
+};
+
+// Receives the extracted files. Without dedup every file becomes an archive
+// entry. With dedup the contents are hashed first: in an archive, a file with
+// the same contents as an earlier one becomes a hard link to it, and with a
+// blob store each distinct content is written to the store once, and there is
+// no archive.
+class FileSink final
+{
+private:
+    OutputArchive * _archive;
+    std::optional<DigestAlgorithm> _dedup;
+    BlobStore * _blob_store;
+    // First path stored with each digest
+    std::unordered_map<std::string, std::string> _first_paths;
+    std::vector<FileDigest> _digests;
+    std::vector<std::byte> & _buffer;
+    ExtractionStatistics _statistics;
+
+public:
+    // `buffer` holds the contents while they are hashed
+    FileSink(OutputArchive * archive,
+             std::optional<DigestAlgorithm> dedup,
+             BlobStore * blob_store,
+             std::vector<std::byte> & buffer) noexcept :
+        _archive(archive),
+        _dedup(dedup),
+        _blob_store(blob_store),
+        _first_paths(),
+        _digests(),
+        _buffer(buffer),
+        _statistics()
+    {
+    }
+
+    FileSink(FileSink const &) = delete;
+    FileSink & operator=(FileSink const &) = delete;
+
+    // `open` may be called twice, for files too large to hash from memory
+    void add(std::string const & path, std::uint64_t const size, StreamFactory const & open)
+    {
+        ++_statistics.files;
+        _statistics.bytes += size;
+
+        if (!_dedup)
+        {
+            auto const stream = open();
+            _archive->add_file(path, *stream, TAR_FILE_PERMISSIONS);
+            return;
+        }
+
+        auto const [digest, contents] = hash_contents(size, open);
+
+        auto written = true;
+        if (nullptr != _blob_store)
+        {
+            written = _blob_store->add(digest, *contents);
+        }
+        else
+        {
+            auto const [first, inserted] = _first_paths.emplace(digest, path);
+            if (inserted)
+            {
+                _archive->add_file(path, *contents, TAR_FILE_PERMISSIONS);
+            }
+            else
+            {
+                _archive->add_hardlink(path, first->second, TAR_FILE_PERMISSIONS);
+                written = false;
+            }
+        }
+
+        if (!written)
+        {
+            ++_statistics.deduplicated_files;
+            _statistics.deduplicated_bytes += size;
+        }
+        _digests.push_back({path, size, digest});
+    }
+
+    [[nodiscard]] ExtractionStatistics const & statistics() const noexcept
+    {
+        return _statistics;
+    }
+
+    // Only filled in dedup mode
+    [[nodiscard]] std::vector<FileDigest> const & digests() const noexcept
+    {
+        return _digests;
+    }
+
+private:
+    // Returns the digest, and a stream positioned at the start of the contents
+    std::pair<std::string, std::unique_ptr<IInputStream>> hash_contents(
+        std::uint64_t const size,
+        StreamFactory const & open)
+    {
+        auto digest = create_digest(*_dedup);
+
+        if (size <= DEDUP_MEMORY_LIMIT)
+        {
+            _buffer.resize(static_cast<std::size_t>(size));
+
+            auto const stream = open();
+            std::size_t total = 0;
+            for (;;)
+            {
+                auto const count =
+                    stream->read(gsl::span<std::byte>(_buffer).subspan(
+                        static_cast<std::ptrdiff_t>(total)));
+                if (0 == count)
+                {
+                    break;
+                }
+                total += count;
+            }
+
+            auto const data =
+                gsl::span<std::byte const>(_buffer).first(static_cast<std::ptrdiff_t>(total));
+            digest->update(data);
+            return {digest->finish(), std::make_unique<MemoryInputStream>(data)};
+        }
+
+        _buffer.resize(DEDUP_READ_BUFFER_SIZE);
+        auto const stream = open();
+        for (;;)
+        {
+            auto const count = stream->read(_buffer);
+            if (0 == count)
+            {
+                break;
+            }
+            digest->update(
+                gsl::span<std::byte const>(_buffer).first(static_cast<std::ptrdiff_t>(count)));
+        }
+        return {digest->finish(), open()};
+    }
+};
+
+
+po::options_description image_options_description()
+{
+    po::options_description desc("Image options");
     desc.add_options()
-        ("help,h", "produce help message")
-        ("version,v", "show version")
         ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_EXTRACT_DEFAULT_VERSION), "littlefs version to use")
         ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_EXTRACT_DEFAULT_BLOCK_SIZE), "filesystem block size")
         ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
         ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_EXTRACT_DEFAULT_READ_SIZE), "filesystem read size")
         ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_EXTRACT_DEFAULT_PROG_SIZE), "filesystem prog size")
-        ("input-file,i", po::value<std::string>()->required(), "littlefs image file")
+        ("input-file,i", po::value<std::string>(), "littlefs image file (- or a pipe: read into memory)")
         ("output-file,o", po::value<std::string>()->default_value("-"), "output tar file")
+        ("prefetch-metadata", "bulk-read and validate metadata blocks before walking the tree")
+        ("index-file", po::value<std::string>(), "directory index cache, rebuilt when stale")
+        ("digest", po::value<std::string>(), "hash every file while extracting (xxh3 or sha256)")
+        ("manifest-file", po::value<std::string>(), "manifest of file digests (default: OUTPUT_FILE.manifest)")
+        ("digest-threads", po::value<unsigned>()->default_value(0), "number of hashing threads (0 = one per hardware thread)")
+        ("dedup", "store files with the same contents once, as hard links")
+        ("shards", po::value<unsigned>()->default_value(1), "split the output into this many tar files of about the same size")
+        ("shard-index-file", po::value<std::string>(), "index of the shard holding each file (default: OUTPUT_FILE.index)")
+    ;
+    return desc;
+}
+
+CommandLineOptions read_image_options(po::variables_map const & vm)
+{
+    if (0 == vm.count("input-file"))
+    {
+        throw po::required_option("input-file");
+    }
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.output_file_path = vm["output-file"].as<std::string>();
+    options.prefetch_metadata = 0 != vm.count("prefetch-metadata");
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    if (0 != vm.count("index-file"))
+    {
+        options.index_file_path = vm["index-file"].as<std::string>();
+    }
+
+    options.digest_threads = vm["digest-threads"].as<unsigned>();
+    options.dedup = 0 != vm.count("dedup");
+
+    options.shards = vm["shards"].as<unsigned>();
+    if (0 == options.shards)
+    {
+        throw std::invalid_argument("There must be at least one shard");
+    }
+    if (options.shards > 1)
+    {
+        if (options.output_file_path == "-")
+        {
+            throw std::runtime_error("--shards needs an output file");
+        }
+        if (options.dedup || options.digest)
+        {
+            throw std::runtime_error("--shards cannot be combined with --dedup or --digest");
+        }
+
+        options.shard_index_file_path = 0 != vm.count("shard-index-file")
+                                            ? vm["shard-index-file"].as<std::string>()
+                                            : options.output_file_path + ".index";
+    }
+    if (0 != vm.count("digest"))
+    {
+        options.digest = parse_digest_algorithm(vm["digest"].as<std::string>());
+
+        if (0 != vm.count("manifest-file"))
+        {
+            options.manifest_file_path = vm["manifest-file"].as<std::string>();
+        }
+        else if (options.output_file_path == "-")
+        {
+            throw std::runtime_error(
+                "--digest needs --manifest-file when writing to standard output");
+        }
+        else
+        {
+            options.manifest_file_path = options.output_file_path + ".manifest";
+        }
+    }
+
+    return options;
+}
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
     ;
+    desc.add(image_options_description());
+
+    po::options_description batch_desc("Batch options");
+    batch_desc.add_options()
+        ("batch", po::value<std::string>(), "manifest with the image options of one job per line")
+        ("jobs,j", po::value<unsigned>()->default_value(0), "number of parallel jobs (0 = one per hardware thread)")
+        ("summary-file", po::value<std::string>()->default_value("-"), "JSON summary of the batch")
+    ;
+    desc.add(batch_desc);
+
+    po::options_description dedup_desc("Blob store options");
+    dedup_desc.add_options()
+        ("blob-store", po::value<std::string>(), "content-addressed store for file contents, shared by all images; OUTPUT_FILE becomes a manifest")
+    ;
+    desc.add(dedup_desc);
 
     po::variables_map vm {};
     po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
@@ -73,7 +389,15 @@ std::optional<CommandLineOptions> parse_command_line(std::string const & executa
     {
         auto const & usage =
             fmt::format("Usage: {} -i INPUT_FILE [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
-                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] [-o OUTPUT_FILE]\n",
+                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] [-o OUTPUT_FILE] "
+                        "[--prefetch-metadata] [--index-file INDEX_FILE] "
+                        "[--digest ALGORITHM [--manifest-file MANIFEST_FILE] "
+                        "[--digest-threads THREADS]] [--dedup] "
+                        "[--shards SHARDS [--shard-index-file SHARD_INDEX_FILE]] "
+                        "[--blob-store DIRECTORY]\n"
+                        "       {} --batch MANIFEST [-j JOBS] [--summary-file SUMMARY_FILE] "
+                        "[--blob-store DIRECTORY]\n",
+                        executable,
                         executable);
 
 #if _MSC_VER
@@ -94,85 +418,646 @@ std::optional<CommandLineOptions> parse_command_line(std::string const & executa
     po::notify(vm);
 
     CommandLineOptions options {};
+    if (0 != vm.count("batch"))
+    {
+        options.batch_file_path = vm["batch"].as<std::string>();
+        options.jobs = vm["jobs"].as<unsigned>();
+        options.summary_file_path = vm["summary-file"].as<std::string>();
+    }
+    else
+    {
+        options = read_image_options(vm);
+    }
 
-    options.version = vm["littlefs-version"].as<std::uint32_t>();
-    options.block_size = vm["block-size"].as<std::uint32_t>();
-    options.read_size = vm["read-size"].as<std::uint32_t>();
-    options.prog_size = vm["prog-size"].as<std::uint32_t>();
-    options.input_file_path = vm["input-file"].as<std::string>();
-    options.output_file_path = vm["output-file"].as<std::string>();
+    if (0 != vm.count("blob-store"))
+    {
+        options.blob_store_path = vm["blob-store"].as<std::string>();
+    }
 
-    if (0 != vm.count("block-count"))
+    return options;
+}
+
+// Parses one line of a batch manifest, e.g. "-i device.img -o device.tar -b 4096"
+CommandLineOptions parse_batch_job(std::string const & line)
+{
+    po::variables_map vm {};
+    po::store(po::command_line_parser(po::split_unix(line))
+                  .options(image_options_description())
+                  .run(),
+              vm);
+    po::notify(vm);
+
+    auto options = read_image_options(vm);
+    if (options.output_file_path == "-")
     {
-        options.block_count = vm["block-count"].as<std::uint32_t>();
+        throw std::runtime_error("Batch jobs must specify an output file");
+    }
+    if (options.input_file_path == "-")
+    {
+        throw std::runtime_error("Batch jobs cannot read standard input");
     }
 
     return options;
 }
 
-int entry_point(std::string const & executable, std::vector<std::string> const & args)
+void extract_filesystem(LittleFS & filesystem, FileSink & sink)
 {
-    auto options = parse_command_line(executable, args);
-    if (!options)
+    auto const tree = filesystem.file_tree("/");
+    auto const nodes = tree.nodes();
+
+    std::string path {};
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
     {
-        return 1;
+        if (0 != nodes[index].is_directory)
+        {
+            continue;
+        }
+
+        tree.path(index, path);
+
+        sink.add(path.substr(1), nodes[index].size, [&filesystem, &path]() {
+            return std::make_unique<LittleFileInputStream>(
+                filesystem.open_file(path, LittleFS::OpenFlags::Read));
+        });
+    }
+}
+
+std::unique_ptr<IInputStream> open_index_entry(DirectoryIndex const & index,
+                                               IBlockDevice & block_device,
+                                               DirectoryIndex::Entry const & entry)
+{
+    if (0 != (entry.flags & DirectoryIndex::FLAG_INLINE))
+    {
+        return std::make_unique<MemoryInputStream>(index.inline_data(entry));
+    }
+    return std::make_unique<CtzInputStream>(block_device, entry.head, entry.size);
+}
+
+// Reads file contents straight from the recorded extents, without mounting
+void extract_index(DirectoryIndex const & index, IBlockDevice & block_device, FileSink & sink)
+{
+    std::string path {};
+
+    auto const entries = index.entries();
+    for (std::uint32_t entry_index = 0; entry_index < static_cast<std::uint32_t>(entries.size());
+         ++entry_index)
+    {
+        auto const & entry = entries[entry_index];
+        if (0 != (entry.flags & DirectoryIndex::FLAG_DIRECTORY))
+        {
+            continue;
+        }
+
+        auto const open = [&index, &block_device, &entry]() {
+            return open_index_entry(index, block_device, entry);
+        };
+        sink.add(index.path(entry_index, path).substr(1), entry.size, open);
+    }
+}
+
+void extract_to_sink(CommandLineOptions const & options,
+                     std::unique_ptr<IBlockDevice> image_file,
+                     std::optional<DirectoryIndex> const & index,
+                     unsigned const prefetch_threads,
+                     FileSink & sink)
+{
+    if (index)
+    {
+        extract_index(*index, *image_file, sink);
+        return;
+    }
+
+    if (options.prefetch_metadata)
+    {
+        auto caching_device = std::make_unique<CachingBlockDevice>(std::move(image_file));
+        prefetch_metadata(*caching_device, options.version, prefetch_threads);
+        image_file = std::move(caching_device);
+    }
+
+    if (options.index_file_path)
+    {
+        auto recording_device = std::make_unique<RecordingBlockDevice>(std::move(image_file));
+        auto & recorder = *recording_device;
+
+        auto const filesystem = open_filesystem(
+            options.version, std::move(recording_device), options.read_size, options.prog_size);
+
+        auto const new_index = DirectoryIndex::build(*filesystem, recorder, options.version);
+        new_index.save(*options.index_file_path);
+
+        extract_index(new_index, recorder, sink);
+        return;
+    }
+
+    auto const filesystem = open_filesystem(
+        options.version, std::move(image_file), options.read_size, options.prog_size);
+    extract_filesystem(*filesystem, sink);
+}
+
+void write_manifest(std::ostream & stream,
+                    DigestAlgorithm const algorithm,
+                    std::vector<FileDigest> const & digests)
+{
+    JsonWriter writer(stream);
+    writer.begin_object()
+        .member("algorithm", digest_algorithm_name(algorithm))
+        .key("files")
+        .begin_array();
+    for (auto const & file : digests)
+    {
+        writer.begin_object()
+            .member("path", file.path)
+            .member("size", file.size)
+            .member("digest", file.digest)
+            .end_object();
+    }
+    writer.end_array().end_object();
+
+    stream << "\n";
+}
+
+// Paths are the ones stored in the archive
+void write_manifest(std::string const & path,
+                    DigestAlgorithm const algorithm,
+                    std::vector<FileDigest> const & digests)
+{
+    if (path == "-")
+    {
+        write_manifest(std::cout, algorithm, digests);
+        return;
+    }
+
+    std::ofstream stream(path);
+    stream.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    write_manifest(stream, algorithm, digests);
+}
+
+// Each call returns a separate handle on the image. A spooled image is shared
+// instead, since reading it from memory is safe from several threads.
+std::unique_ptr<IBlockDevice> open_image(CommandLineOptions const & options,
+                                         SpooledBlockDevice * spooled)
+{
+    if (nullptr != spooled)
+    {
+        return std::make_unique<BlockDeviceView>(*spooled);
+    }
+
+    return std::make_unique<FileBlockDevice>(options.input_file_path,
+                                             false,
+                                             options.block_size,
+                                             options.block_count.value());
+}
+
+std::string shard_file_path(std::string const & output_file_path, unsigned const shard)
+{
+    return fmt::format("{}.{:03}", output_file_path, shard);
+}
+
+std::vector<ShardedFile> list_files(DirectoryIndex const & index)
+{
+    std::vector<ShardedFile> files {};
+    std::string path {};
+
+    auto const entries = index.entries();
+    for (std::uint32_t entry_index = 0; entry_index < static_cast<std::uint32_t>(entries.size());
+         ++entry_index)
+    {
+        auto const & entry = entries[entry_index];
+        if (0 == (entry.flags & DirectoryIndex::FLAG_DIRECTORY))
+        {
+            files.push_back({index.path(entry_index, path).substr(1), entry.size, entry_index});
+        }
+    }
+
+    return files;
+}
+
+std::vector<ShardedFile> list_files(LittleFS & filesystem)
+{
+    auto const tree = filesystem.file_tree("/");
+    auto const nodes = tree.nodes();
+
+    std::vector<ShardedFile> files {};
+    std::string path {};
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
+    {
+        if (0 == nodes[index].is_directory)
+        {
+            files.push_back({tree.path(index, path).substr(1), nodes[index].size, 0});
+        }
+    }
+
+    return files;
+}
+
+// Largest files first, each to the shard with the fewest bytes so far. No two
+// shards then differ by more than the largest file.
+std::vector<std::vector<std::uint32_t>> assign_shards(std::vector<ShardedFile> const & files,
+                                                      unsigned const shard_count)
+{
+    std::vector<std::uint32_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [&files](std::uint32_t const left, std::uint32_t const right) {
+                         return files[left].size > files[right].size;
+                     });
+
+    using Load = std::pair<std::uint64_t, unsigned>;
+    std::priority_queue<Load, std::vector<Load>, std::greater<>> loads {};
+    for (unsigned shard = 0; shard < shard_count; ++shard)
+    {
+        loads.push({0, shard});
+    }
+
+    std::vector<std::vector<std::uint32_t>> shards(shard_count);
+    for (auto const file : order)
+    {
+        auto const [bytes, shard] = loads.top();
+        loads.pop();
+
+        shards[shard].push_back(file);
+        loads.push({bytes + files[file].size, shard});
+    }
+
+    // Listing order within a shard, which keeps the files of a directory together
+    for (auto & shard : shards)
+    {
+        std::sort(shard.begin(), shard.end());
+    }
+
+    return shards;
+}
+
+void write_shard_index(CommandLineOptions const & options,
+                       std::vector<ShardedFile> const & files,
+                       std::vector<std::vector<std::uint32_t>> const & shards)
+{
+    std::vector<unsigned> file_shards(files.size());
+
+    std::ofstream stream(options.shard_index_file_path.value());
+    stream.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+
+    JsonWriter writer(stream);
+    writer.begin_object().key("shards").begin_array();
+    for (unsigned shard = 0; shard < static_cast<unsigned>(shards.size()); ++shard)
+    {
+        std::uint64_t bytes = 0;
+        for (auto const file : shards[shard])
+        {
+            bytes += files[file].size;
+            file_shards[file] = shard;
+        }
+
+        writer.begin_object()
+            .member("file", shard_file_path(options.output_file_path, shard))
+            .member("files", static_cast<std::uint64_t>(shards[shard].size()))
+            .member("bytes", bytes)
+            .end_object();
+    }
+    writer.end_array().key("files").begin_array();
+    for (std::size_t file = 0; file < files.size(); ++file)
+    {
+        writer.begin_object()
+            .member("path", files[file].path)
+            .member("shard", static_cast<std::uint64_t>(file_shards[file]))
+            .end_object();
+    }
+    writer.end_array().end_object();
+
+    stream << "\n";
+}
+
+// Writes every shard from its own thread, each with its own handle on the
+// image and, without a directory index, its own mount.
+ExtractionStatistics extract_shards(CommandLineOptions const & options,
+                                    SpooledBlockDevice * spooled,
+                                    std::optional<DirectoryIndex> index)
+{
+    if (!index && options.index_file_path)
+    {
+        auto recording_device =
+            std::make_unique<RecordingBlockDevice>(open_image(options, spooled));
+        auto & recorder = *recording_device;
+
+        auto const filesystem = open_filesystem(
+            options.version, std::move(recording_device), options.read_size, options.prog_size);
+
+        index = DirectoryIndex::build(*filesystem, recorder, options.version);
+        index->save(*options.index_file_path);
     }
 
-    if (!options->block_count)
+    auto const files = index ? list_files(*index)
+                             : list_files(*open_filesystem(options.version,
+                                                           open_image(options, spooled),
+                                                           options.read_size,
+                                                           options.prog_size));
+    auto const shards = assign_shards(files, options.shards);
+
+    std::vector<std::future<void>> pending {};
     {
-        auto const image_size = file_size(options->input_file_path);
-        if (image_size % options->block_size != 0)
+        ThreadPool pool(options.shards);
+        for (unsigned shard = 0; shard < options.shards; ++shard)
         {
-            throw std::runtime_error("Invalid block size");
+            pending.push_back(pool.submit([&, shard]() {
+                auto image_file = open_image(options, spooled);
+                std::unique_ptr<LittleFS> filesystem {};
+                if (!index)
+                {
+                    filesystem = open_filesystem(options.version,
+                                                 std::move(image_file),
+                                                 options.read_size,
+                                                 options.prog_size);
+                }
+
+                // NOLINTNEXTLINE(hicpp-signed-bitwise): There are unsigned literals
+                OutputArchive archive(CFile(shard_file_path(options.output_file_path, shard), "wb"),
+                                      ARCHIVE_FORMAT_TAR_PAX_RESTRICTED);
+
+                for (auto const file : shards[shard])
+                {
+                    std::unique_ptr<IInputStream> stream {};
+                    if (index)
+                    {
+                        stream = open_index_entry(
+                            *index, *image_file, index->entries()[files[file].entry]);
+                    }
+                    else
+                    {
+                        stream = std::make_unique<LittleFileInputStream>(filesystem->open_file(
+                            "/" + files[file].path, LittleFS::OpenFlags::Read));
+                    }
+
+                    archive.add_file(files[file].path, *stream, TAR_FILE_PERMISSIONS);
+                }
+            }));
         }
+    }
+
+    for (auto & shard : pending)
+    {
+        shard.get();
+    }
+
+    write_shard_index(options, files, shards);
+
+    ExtractionStatistics statistics {};
+    for (auto const & file : files)
+    {
+        ++statistics.files;
+        statistics.bytes += file.size;
+    }
+    return statistics;
+}
 
-        auto const block_count = image_size / options->block_size;
+// With a blob store, the contents go to the store and the output file is the
+// image's manifest
+ExtractionStatistics extract_image(CommandLineOptions options,
+                                   BlobStore * blob_store,
+                                   WorkerState & worker)
+{
+    // Pipes can be read only once and have no size, so the whole image is read
+    // into memory and its size is what arrived
+    std::unique_ptr<SpooledBlockDevice> spooled {};
+    if (options.input_file_path == "-" || !is_seekable(options.input_file_path))
+    {
+        auto input_file = options.input_file_path == "-" ? CFile::standard_input()
+                                                         : CFile(options.input_file_path, "rb");
+        spooled = std::make_unique<SpooledBlockDevice>(
+            input_file, options.block_size, options.block_count);
+        options.block_count = spooled->block_count();
+    }
+    else
+    {
+        options.block_count =
+            image_block_count(options.input_file_path, options.block_size, options.block_count);
+    }
+
+    auto image_file = open_image(options, spooled.get());
 
-        if (block_count > std::numeric_limits<std::uint32_t>::max())
+    std::optional<DirectoryIndex> index {};
+    if (options.index_file_path)
+    {
+        index = DirectoryIndex::load(*options.index_file_path);
+        if (index && !index->matches(*image_file, options.version))
         {
-            throw std::runtime_error("Image too large");
+            index.reset();
         }
+    }
 
-        options->block_count = static_cast<std::uint32_t>(block_count);
+    if (options.shards > 1)
+    {
+        if (nullptr != blob_store)
+        {
+            throw std::runtime_error("--shards cannot be combined with --blob-store");
+        }
+        return extract_shards(options, spooled.get(), std::move(index));
     }
 
-    auto image_file = std::make_unique<FileBlockDevice>(options->input_file_path,
-                                                        false,
-                                                        options->block_size,
-                                                        options->block_count.value());
+    std::optional<DigestAlgorithm> dedup {};
+    if (options.dedup || nullptr != blob_store)
+    {
+        dedup = options.digest.value_or(DigestAlgorithm::Sha256);
+    }
 
-    std::unique_ptr<LittleFS> filesystem {};
-    switch (options->version)
+    if (nullptr != blob_store)
     {
-    case 1:
-        filesystem = std::make_unique<LittleFS1>(std::move(image_file),
-                                                 options->read_size,
-                                                 options->prog_size);
-        break;
+        FileSink sink(nullptr, dedup, blob_store, worker.dedup_buffer);
+        extract_to_sink(options, std::move(image_file), index, worker.prefetch_threads, sink);
 
-    case 2:
-        filesystem = std::make_unique<LittleFS2>(std::move(image_file),
-                                                 options->read_size,
-                                                 options->prog_size);
-        break;
+        write_manifest(options.output_file_path, *dedup, sink.digests());
+        return sink.statistics();
+    }
 
-    default:
-        throw std::runtime_error("Invalid littlefs version specified");
+    // Dedup hashes every file anyway, so the manifest comes from its digests
+    std::optional<FileDigester> digester {};
+    if (options.digest && !dedup)
+    {
+        digester.emplace(*options.digest, options.digest_threads);
     }
 
-    CFile output_file = options->output_file_path == "-" ? CFile::standard_output()
-                                                         : CFile(options->output_file_path, "wb");
+    CFile output_file = options.output_file_path == "-" ? CFile::standard_output()
+                                                        : CFile(options.output_file_path, "wb");
 
     // NOLINTNEXTLINE(hicpp-signed-bitwise): There are unsigned literals
-    OutputArchive archive(std::move(output_file), ARCHIVE_FORMAT_TAR_PAX_RESTRICTED);
+    OutputArchive archive(
+        std::move(output_file), ARCHIVE_FORMAT_TAR_PAX_RESTRICTED, &worker.copy_buffer);
+    if (digester)
+    {
+        archive.set_digester(&*digester);
+    }
+
+    FileSink sink(&archive, dedup, nullptr, worker.dedup_buffer);
+    extract_to_sink(options, std::move(image_file), index, worker.prefetch_threads, sink);
+
+    if (digester)
+    {
+        write_manifest(*options.manifest_file_path, digester->algorithm(), digester->finish());
+    }
+    else if (dedup && options.manifest_file_path)
+    {
+        write_manifest(*options.manifest_file_path, *dedup, sink.digests());
+    }
+
+    return sink.statistics();
+}
+
+BatchJobResult run_batch_job(std::size_t const line_number,
+                             std::string const & line,
+                             BlobStore * blob_store,
+                             WorkerState & worker)
+{
+    BatchJobResult result {line_number, {}, {}, 0, {}, {}};
+
+    auto const start = std::chrono::steady_clock::now();
+    try
+    {
+        auto const options = parse_batch_job(line);
+        result.input_file_path = options.input_file_path;
+        result.output_file_path = options.output_file_path;
+
+        result.statistics = extract_image(options, blob_store, worker);
+    }
+    catch (std::exception const & exception)
+    {
+        result.error = exception.what();
+    }
+    auto const end = std::chrono::steady_clock::now();
+
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+void write_batch_summary(std::vector<BatchJobResult> const & results, std::ostream & stream)
+{
+    JsonWriter writer(stream);
+
+    std::uint64_t failed = 0;
+
+    writer.begin_object().key("jobs").begin_array();
+    for (auto const & result : results)
+    {
+        writer.begin_object()
+            .member("line", static_cast<std::uint64_t>(result.line))
+            .member("input", result.input_file_path)
+            .member("output", result.output_file_path)
+            .member("succeeded", result.statistics.has_value())
+            .member("seconds", result.seconds);
+        if (result.statistics)
+        {
+            writer.member("files", result.statistics->files)
+                .member("bytes", result.statistics->bytes)
+                .member("deduplicated_files", result.statistics->deduplicated_files)
+                .member("deduplicated_bytes", result.statistics->deduplicated_bytes);
+        }
+        else
+        {
+            writer.member("error", result.error);
+            ++failed;
+        }
+        writer.end_object();
+    }
+    writer.end_array()
+        .member("succeeded", static_cast<std::uint64_t>(results.size()) - failed)
+        .member("failed", failed)
+        .end_object();
+
+    stream << "\n";
+}
+
+// Runs every job of the manifest on a pool of workers. A failing job is
+// reported in the summary and does not stop the others.
+int run_batch(CommandLineOptions const & options)
+{
+    std::ifstream manifest(options.batch_file_path.value());
+    if (!manifest)
+    {
+        throw std::runtime_error("Failed opening batch manifest");
+    }
+
+    std::optional<BlobStore> blob_store {};
+    if (options.blob_store_path)
+    {
+        blob_store.emplace(*options.blob_store_path);
+    }
+    auto * const shared_store = blob_store ? &*blob_store : nullptr;
+
+    // Not bounded by its capacity, but by holding one state per worker. Each
+    // job borrows one and hands it back when done.
+    BoundedQueue<WorkerState> idle_workers(std::numeric_limits<std::size_t>::max());
+
+    std::vector<std::future<BatchJobResult>> pending {};
+    {
+        ThreadPool pool(options.jobs);
+        for (std::size_t worker = 0; worker < pool.size(); ++worker)
+        {
+            idle_workers.push({{}, {}, 1});
+        }
+
+        std::string line {};
+        for (std::size_t line_number = 1; std::getline(manifest, line); ++line_number)
+        {
+            auto const first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#')
+            {
+                continue;
+            }
+
+            pending.push_back(pool.submit([line_number, line, shared_store, &idle_workers]() {
+                auto worker = idle_workers.pop();
+                auto const release = gsl::finally(
+                    [&idle_workers, &worker]() { idle_workers.push(std::move(*worker)); });
+                return run_batch_job(line_number, line, shared_store, *worker);
+            }));
+        }
+    }
+
+    std::vector<BatchJobResult> results {};
+    results.reserve(pending.size());
+    for (auto & result : pending)
+    {
+        results.push_back(result.get());
+    }
+
+    if (options.summary_file_path == "-")
+    {
+        write_batch_summary(results, std::cout);
+    }
+    else
+    {
+        std::ofstream summary(options.summary_file_path);
+        summary.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+        write_batch_summary(results, summary);
+    }
+
+    auto const all_succeeded =
+        std::all_of(results.cbegin(), results.cend(), [](BatchJobResult const & result) {
+            return result.statistics.has_value();
+        });
+    return all_succeeded ? 0 : -1;
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto const options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    if (options->batch_file_path)
+    {
+        return run_batch(*options);
+    }
 
-    for (auto const & file_info : filesystem->recursive_dirlist("/"))
+    std::optional<BlobStore> blob_store {};
+    if (options->blob_store_path)
     {
-        auto const stream = std::make_unique<LittleFileInputStream>(
-            filesystem->open_file(file_info.path, LittleFS::OpenFlags::Read));
-        archive.add_file(file_info.path.substr(1), *stream, TAR_FILE_PERMISSIONS);
+        blob_store.emplace(*options->blob_store_path);
     }
 
+    WorkerState worker {};
+    extract_image(*options, blob_store ? &*blob_store : nullptr, worker);
     return 0;
 }
 
@@ -0,0 +1,651 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockHash.hpp>
+#include <BoundedQueue.hpp>
+#include <CFile.hpp>
+#include <FileBlockDevice.hpp>
+#include <JsonWriter.hpp>
+#include <MappedFile.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <SocketBlockDevice.hpp>
+#include <SparseImage.hpp>
+#include <ThreadPool.hpp>
+#include <Util.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_flash_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t block_size;
+    std::string input_file_path;
+    std::vector<std::string> targets;
+    bool sparse;
+    bool force;
+    bool verify;
+    std::optional<std::string> report_file_path;
+};
+
+
+namespace po = boost::program_options;
+
+
+// Exit code of a run where some target could not be written or verified, as
+// opposed to -1 for a run that could not start at all
+static constexpr int FLASH_FAILED = 2;
+
+// Blocks the writer hands to the verifier at a time, after a sync
+static constexpr std::uint32_t VERIFY_BATCH_BLOCKS = 64;
+// Batches waiting for the verifier before the writer blocks
+static constexpr std::size_t VERIFY_QUEUE_DEPTH = 16;
+
+static constexpr std::size_t INPUT_CHUNK_SIZE = 8 * 1024 * 1024;
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_FLASH_DEFAULT_BLOCK_SIZE), "block size")
+        ("input-file,i", po::value<std::string>()->required(), "source image, or - for standard input")
+        ("target,t", po::value<std::vector<std::string>>()->required(), "target image file, device, or unix:PATH or tcp:HOST:PORT endpoint; may be repeated")
+        ("sparse", "the source is an extent or Android sparse image, and only its blocks are written")
+        ("force", "write every block, even those the target already holds")
+        ("no-verify", "do not read the targets back")
+        ("report-file", po::value<std::string>(), "JSON report, or - for standard output")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE -t TARGET [-t TARGET...] [-b BLOCK_SIZE] "
+                        "[--sparse] [--force] [--no-verify] [--report-file REPORT_FILE]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-flash {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.targets = vm["target"].as<std::vector<std::string>>();
+    options.sparse = (0 != vm.count("sparse"));
+    options.force = (0 != vm.count("force"));
+    options.verify = (0 == vm.count("no-verify"));
+
+    if (0 != vm.count("report-file"))
+    {
+        options.report_file_path = vm["report-file"].as<std::string>();
+    }
+
+    if (0 == options.block_size)
+    {
+        throw std::invalid_argument("The block size must not be zero");
+    }
+
+    return options;
+}
+
+// The source image, read once: mapped when it is a file, otherwise read into
+// memory in full. A sparse image is expanded in memory, and only the blocks it
+// holds are written.
+class SourceImage final
+{
+private:
+    std::optional<MappedFile> _mapping;
+    std::vector<std::byte> _contents;
+    gsl::span<std::byte const> _data;
+    std::uint32_t _block_size;
+    std::uint32_t _block_count;
+    std::vector<BlockExtent> _extents;
+
+public:
+    SourceImage(std::string const & path, std::uint32_t const block_size, bool const sparse) :
+        _mapping(), _contents(), _data(), _block_size(block_size), _block_count(0), _extents()
+    {
+        if (sparse)
+        {
+            load_sparse(path);
+            return;
+        }
+
+        if (path != "-" && is_seekable(path))
+        {
+            _data = _mapping.emplace(path).data();
+        }
+        else
+        {
+            auto input_file = path == "-" ? CFile::standard_input() : CFile(path, "rb");
+            for (;;)
+            {
+                auto const offset = _contents.size();
+                _contents.resize(offset + INPUT_CHUNK_SIZE);
+
+                auto const chunk = gsl::span<std::byte>(_contents).subspan(
+                    static_cast<std::ptrdiff_t>(offset));
+                auto const read = input_file.read(chunk);
+                _contents.resize(offset + read);
+
+                if (read < INPUT_CHUNK_SIZE)
+                {
+                    break;
+                }
+            }
+            _data = _contents;
+        }
+
+        if (static_cast<std::size_t>(_data.size()) % block_size != 0)
+        {
+            throw std::runtime_error("Invalid block size");
+        }
+
+        auto const block_count = static_cast<std::size_t>(_data.size()) / block_size;
+        if (block_count > std::numeric_limits<std::uint32_t>::max())
+        {
+            throw std::runtime_error("Image too large");
+        }
+        _block_count = static_cast<std::uint32_t>(block_count);
+        if (_block_count > 0)
+        {
+            _extents.push_back({0, _block_count});
+        }
+    }
+
+    SourceImage(SourceImage const &) = delete;
+    SourceImage & operator=(SourceImage const &) = delete;
+
+    [[nodiscard]] gsl::span<std::byte const> data() const noexcept
+    {
+        return _data;
+    }
+
+    [[nodiscard]] std::uint32_t block_size() const noexcept
+    {
+        return _block_size;
+    }
+
+    [[nodiscard]] std::uint32_t block_count() const noexcept
+    {
+        return _block_count;
+    }
+
+    // The blocks to write
+    [[nodiscard]] std::vector<BlockExtent> const & extents() const noexcept
+    {
+        return _extents;
+    }
+
+private:
+    void load_sparse(std::string const & path)
+    {
+        auto input_file = path == "-" ? CFile::standard_input() : CFile(path, "rb");
+        SparseImageReader reader(input_file);
+
+        _block_size = reader.block_size();
+        _block_count = reader.block_count();
+        _contents.assign(static_cast<std::size_t>(_block_count) * _block_size,
+                         MemoryBlockDevice::ERASED_VALUE);
+
+        reader.read(
+            [this](std::uint32_t const first, gsl::span<std::byte const> const data) {
+                std::copy(data.begin(),
+                          data.end(),
+                          _contents.begin()
+                              + static_cast<std::ptrdiff_t>(static_cast<std::size_t>(first)
+                                                            * _block_size));
+
+                auto const count =
+                    static_cast<std::uint32_t>(static_cast<std::size_t>(data.size()) / _block_size);
+                if (!_extents.empty() && _extents.back().first + _extents.back().count == first)
+                {
+                    _extents.back().count += count;
+                }
+                else
+                {
+                    _extents.push_back({first, count});
+                }
+            },
+            INPUT_CHUNK_SIZE);
+
+        _data = _contents;
+    }
+};
+
+struct TargetResult
+{
+    std::string target {};
+    // Blocks left alone because the target already held them
+    std::uint32_t skipped {};
+    std::uint32_t erased {};
+    std::uint32_t programmed {};
+    std::uint32_t verified {};
+    // Blocks whose contents read back differ from the source
+    std::vector<std::uint32_t> mismatches {};
+    double seconds {};
+    std::optional<std::string> error {};
+
+    [[nodiscard]] bool passed() const noexcept
+    {
+        return !error && mismatches.empty();
+    }
+};
+
+bool is_endpoint(std::string const & target)
+{
+    return 0 == target.rfind("unix:", 0) || 0 == target.rfind("tcp:", 0);
+}
+
+bool is_erased(gsl::span<std::byte const> const block)
+{
+    return std::all_of(block.begin(), block.end(), [](std::byte const value) {
+        return MemoryBlockDevice::ERASED_VALUE == value;
+    });
+}
+
+// A missing target file is created erased, so that erased blocks of the source
+// need not be written to it
+void create_target_file(std::string const & path,
+                        std::uint32_t const block_size,
+                        std::uint32_t const block_count)
+{
+    CFile file(path, "wb");
+
+    std::vector<std::byte> erased(block_size, MemoryBlockDevice::ERASED_VALUE);
+    for (std::uint32_t block = 0; block < block_count; ++block)
+    {
+        if (file.write(gsl::span<std::byte const>(erased)) != erased.size())
+        {
+            throw std::runtime_error(fmt::format("Cannot write to {}", path));
+        }
+    }
+}
+
+std::unique_ptr<IBlockDevice> open_target(std::string const & target,
+                                          std::uint32_t const block_size,
+                                          std::uint32_t const block_count,
+                                          SocketBlockDeviceOptions const & socket_options)
+{
+    if (is_endpoint(target))
+    {
+        auto device = std::make_unique<SocketBlockDevice>(target, socket_options);
+        if (device->block_size() != block_size)
+        {
+            throw std::runtime_error(fmt::format(
+                "The target has blocks of {} bytes, not {}", device->block_size(), block_size));
+        }
+        if (device->block_count() < block_count)
+        {
+            throw std::runtime_error(fmt::format(
+                "The target has {} blocks, the image {}", device->block_count(), block_count));
+        }
+        return device;
+    }
+
+    auto const size = file_size(target);
+    if (size / block_size < block_count)
+    {
+        throw std::runtime_error(fmt::format(
+            "The target has {} blocks, the image {}", size / block_size, block_count));
+    }
+
+    return std::make_unique<FileBlockDevice>(target, true, block_size, block_count);
+}
+
+// Reads blocks back and compares their hash with the source's
+void verify_blocks(IBlockDevice & device,
+                   std::vector<std::uint32_t> const & blocks,
+                   std::vector<std::uint64_t> const & hashes,
+                   std::vector<std::byte> & buffer,
+                   TargetResult & result)
+{
+    auto const block_size = device.block_size();
+    for (auto const block : blocks)
+    {
+        device.read(block, 0, buffer.data(), block_size);
+        if (block_hash(buffer) != hashes[block])
+        {
+            result.mismatches.push_back(block);
+        }
+        ++result.verified;
+    }
+}
+
+// Writes the blocks of the source the target does not hold yet: a block that
+// already matches is skipped, an erased one is only programmed, and any other
+// is erased first.
+//
+// Verification reads back through a second handle, so that it does not see
+// what the writer caches. For files, it runs alongside the writer on the
+// batches the writer has synced. Block servers serve one client at a time, so
+// endpoints are verified once the writer has disconnected.
+TargetResult flash_target(CommandLineOptions const & options,
+                          SourceImage const & source,
+                          std::vector<std::uint64_t> const & hashes,
+                          std::string const & target)
+{
+    TargetResult result {};
+    result.target = target;
+
+    auto const start = std::chrono::steady_clock::now();
+    auto const block_size = options.block_size;
+    auto const block_count = source.block_count();
+
+    try
+    {
+        auto const endpoint = is_endpoint(target);
+        if (!endpoint && !boost::filesystem::exists(target))
+        {
+            create_target_file(target, block_size, block_count);
+        }
+        if (!endpoint && !is_seekable(target))
+        {
+            throw std::runtime_error("Targets must be seekable");
+        }
+
+        // The writer compares every block, so reads ahead pay off; the verifier
+        // must not be answered from a cache
+        SocketBlockDeviceOptions write_options {};
+        SocketBlockDeviceOptions verify_options {};
+        verify_options.cache_blocks = 0;
+
+        BoundedQueue<std::vector<std::uint32_t>> batches(VERIFY_QUEUE_DEPTH);
+        std::future<void> verification {};
+        std::vector<std::uint32_t> written {};
+
+        std::optional<ThreadPool> verifier {};
+        if (options.verify && !endpoint)
+        {
+            verifier.emplace(1);
+            verification = verifier->submit([&]() {
+                auto const _ = gsl::finally([&batches]() { batches.close(); });
+
+                auto device = open_target(target, block_size, block_count, verify_options);
+                std::vector<std::byte> buffer(block_size);
+                for (auto batch = batches.pop(); batch; batch = batches.pop())
+                {
+                    verify_blocks(*device, *batch, hashes, buffer, result);
+                }
+            });
+        }
+
+        {
+            auto const _ = gsl::finally([&batches]() { batches.close(); });
+
+            auto device = open_target(target, block_size, block_count, write_options);
+            std::vector<std::byte> buffer(block_size);
+            std::vector<std::uint32_t> batch {};
+
+            auto const hand_over = [&]() {
+                if (batch.empty())
+                {
+                    return;
+                }
+                if (verifier)
+                {
+                    device->sync();
+                    batches.push(std::move(batch));
+                }
+                else
+                {
+                    written.insert(written.end(), batch.begin(), batch.end());
+                }
+                batch.clear();
+            };
+
+            auto const image = source.data();
+            for (auto const & extent : source.extents())
+            {
+                for (auto block = extent.first; block < extent.first + extent.count; ++block)
+                {
+                    auto const contents = image.subspan(
+                        static_cast<std::ptrdiff_t>(block) * block_size, block_size);
+
+                    if (!options.force)
+                    {
+                        device->read(block, 0, buffer.data(), block_size);
+                        if (std::equal(contents.begin(), contents.end(), buffer.begin()))
+                        {
+                            ++result.skipped;
+                            continue;
+                        }
+                    }
+
+                    if (options.force || !is_erased(buffer))
+                    {
+                        device->erase(block);
+                        ++result.erased;
+                    }
+                    device->program(block, 0, contents.data(), block_size);
+                    ++result.programmed;
+
+                    batch.push_back(block);
+                    if (batch.size() >= VERIFY_BATCH_BLOCKS)
+                    {
+                        hand_over();
+                    }
+                }
+            }
+            hand_over();
+
+            device->sync();
+        }
+
+        if (verifier)
+        {
+            verification.get();
+        }
+        else if (options.verify)
+        {
+            auto device = open_target(target, block_size, block_count, verify_options);
+            std::vector<std::byte> buffer(block_size);
+            verify_blocks(*device, written, hashes, buffer, result);
+        }
+    }
+    catch (std::exception const & exception)
+    {
+        result.error = exception.what();
+    }
+
+    result.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void write_report(CommandLineOptions const & options,
+                  SourceImage const & source,
+                  std::vector<TargetResult> const & results,
+                  std::ostream & stream)
+{
+    JsonWriter writer(stream);
+
+    writer.begin_object()
+        .member("image", options.input_file_path)
+        .member("block_size", options.block_size)
+        .member("block_count", source.block_count())
+        .key("targets")
+        .begin_array();
+    for (auto const & result : results)
+    {
+        writer.begin_object()
+            .member("target", result.target)
+            .member("skipped", result.skipped)
+            .member("erased", result.erased)
+            .member("programmed", result.programmed)
+            .member("verified", result.verified)
+            .key("mismatches")
+            .begin_array();
+        for (auto const block : result.mismatches)
+        {
+            writer.value(block);
+        }
+        writer.end_array().member("seconds", result.seconds);
+        if (result.error)
+        {
+            writer.member("error", *result.error);
+        }
+        writer.member("passed", result.passed()).end_object();
+    }
+    writer.end_array().end_object();
+
+    stream << "\n";
+}
+
+void print_result(TargetResult const & result)
+{
+    if (result.error)
+    {
+        std::cerr << fmt::format("{}: failed after {:.2f} s: {}\n",
+                                 result.target,
+                                 result.seconds,
+                                 *result.error);
+        return;
+    }
+
+    std::cout << fmt::format("{}: {} skipped, {} erased, {} programmed, {} verified, "
+                             "{} mismatched, {:.2f} s\n",
+                             result.target,
+                             result.skipped,
+                             result.erased,
+                             result.programmed,
+                             result.verified,
+                             result.mismatches.size(),
+                             result.seconds);
+}
+
+// Every target is written by its own thread from the one copy of the source,
+// so the run takes as long as the slowest target. A target that fails does not
+// stop the others.
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    SourceImage const source(options->input_file_path, options->block_size, options->sparse);
+    options->block_size = source.block_size();
+    auto const hashes = hash_blocks(source.data(), options->block_size, 0);
+
+    std::vector<TargetResult> results {};
+    {
+        ThreadPool writers(static_cast<unsigned>(options->targets.size()));
+
+        std::vector<std::future<TargetResult>> pending {};
+        for (auto const & target : options->targets)
+        {
+            pending.push_back(writers.submit(
+                [&options, &source, &hashes, &target]() {
+                    return flash_target(*options, source, hashes, target);
+                }));
+        }
+
+        for (auto & result : pending)
+        {
+            results.push_back(result.get());
+            print_result(results.back());
+        }
+    }
+
+    if (options->report_file_path == "-")
+    {
+        write_report(*options, source, results, std::cout);
+    }
+    else if (options->report_file_path)
+    {
+        std::ofstream report_file(*options->report_file_path);
+        report_file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+        write_report(*options, source, results, report_file);
+    }
+
+    auto const passed = std::all_of(results.begin(), results.end(), [](auto const & result) {
+        return result.passed();
+    });
+    return passed ? 0 : FLASH_FAILED;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
@@ -3,7 +3,6 @@
 #include <exception>
 #include <iostream>
 #include <iterator>
-#include <limits>
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -16,7 +15,7 @@
 #include <gsl/gsl>
 
 #include <FileBlockDevice.hpp>
-#include <Util.hpp>
+#include <ImageFile.hpp>
 
 #if defined(_MSC_VER)
     #include <Unicode.hpp>
@@ -109,23 +108,8 @@ int entry_point(std::string const & executable, std::vector<std::string> const &
         return 1;
     }
 
-    if (!options->block_count)
-    {
-        auto const image_size = file_size(options->input_file_path);
-        if (image_size % options->block_size != 0)
-        {
-            throw std::runtime_error("Invalid block size");
-        }
-
-        auto const block_count = image_size / options->block_size;
-
-        if (block_count > std::numeric_limits<std::uint32_t>::max())
-        {
-            throw std::runtime_error("Image too large");
-        }
-
-        options->block_count = static_cast<std::uint32_t>(block_count);
-    }
+    options->block_count =
+        image_block_count(options->input_file_path, options->block_size, options->block_count);
 
     auto image_file = FileBlockDevice(options->input_file_path,
                                       true,
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <FilesystemCheck.hpp>
+#include <ImageFile.hpp>
+#include <JsonWriter.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_fsck_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_file_path;
+    bool read_data;
+    unsigned jobs;
+    std::string report_file_path;
+};
+
+
+namespace po = boost::program_options;
+
+
+// Exit code of a check that found inconsistencies, as opposed to -1 for a check
+// that could not run at all
+static constexpr int CHECK_FAILED = 2;
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_FSCK_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_FSCK_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_FSCK_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_FSCK_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs image file")
+        ("read-data", "read every file to its end")
+        ("jobs,j", po::value<unsigned>()->default_value(0), "number of checking threads (0 = one per hardware thread)")
+        ("report-file", po::value<std::string>()->default_value("-"), "JSON report")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
+                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] [--read-data] [-j JOBS] "
+                        "[--report-file REPORT_FILE]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-fsck {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.read_data = (0 != vm.count("read-data"));
+    options.jobs = vm["jobs"].as<unsigned>();
+    options.report_file_path = vm["report-file"].as<std::string>();
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    if (1 != options.version && 2 != options.version)
+    {
+        throw std::runtime_error("Invalid littlefs version specified");
+    }
+
+    return options;
+}
+
+void write_report(CommandLineOptions const & options,
+                  CheckReport const & report,
+                  std::ostream & stream)
+{
+    JsonWriter writer(stream);
+
+    auto const & statistics = report.statistics;
+
+    writer.begin_object()
+        .member("image", options.input_file_path)
+        .member("littlefs_version", options.version)
+        .member("block_size", options.block_size)
+        .member("block_count", options.block_count.value())
+        .member("data_read", options.read_data)
+        .member("mounted", report.mounted)
+        .member("directories", statistics.directories)
+        .member("files", statistics.files)
+        .member("bytes", statistics.bytes)
+        .member("metadata_blocks", statistics.metadata_blocks)
+        .member("data_blocks", statistics.data_blocks)
+        .member("used_blocks", statistics.used_blocks);
+
+    writer.key("issues").begin_array();
+    for (auto const & issue : report.issues)
+    {
+        writer.begin_object().member("kind", issue_kind_name(issue.kind));
+        if (!issue.path.empty())
+        {
+            writer.member("path", issue.path);
+        }
+        if (issue.block)
+        {
+            writer.member("block", *issue.block);
+        }
+        writer.member("message", issue.message).end_object();
+    }
+    writer.end_array().member("passed", report.passed()).end_object();
+
+    stream << "\n";
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    // The whole image is read once, sequentially, and every checking thread then
+    // shares the copy in memory
+    options->block_count =
+        image_block_count(options->input_file_path, options->block_size, options->block_count);
+    auto const image =
+        load_image(options->input_file_path, options->block_size, *options->block_count);
+
+    auto const mount = [&options](std::unique_ptr<IBlockDevice> block_device) {
+        return open_filesystem(
+            options->version, std::move(block_device), options->read_size, options->prog_size);
+    };
+
+    CheckOptions check_options {};
+    check_options.littlefs_version = options->version;
+    check_options.thread_count = options->jobs;
+    check_options.read_data = options->read_data;
+
+    auto const report = check_filesystem(image->data(), options->block_size, mount, check_options);
+
+    if (options->report_file_path == "-")
+    {
+        write_report(*options, report, std::cout);
+    }
+    else
+    {
+        std::ofstream report_file(options->report_file_path);
+        report_file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+        write_report(*options, report, report_file);
+    }
+
+    return report.passed() ? 0 : CHECK_FAILED;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
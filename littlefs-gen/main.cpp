@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockDeviceView.hpp>
+#include <CFile.hpp>
+#include <ImageGenerator.hpp>
+#include <MemoryBlockDevice.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_gen_config.h>
+#include <littlefs_utils_config.h>
+
+#include <LittleFS1.hpp>
+#include <LittleFS2.hpp>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::uint32_t block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string output_file_path;
+    GenerationProfile profile;
+};
+
+
+namespace po = boost::program_options;
+
+
+SizeDistribution parse_size_distribution(std::string const & name)
+{
+    if ("fixed" == name)
+    {
+        return SizeDistribution::Fixed;
+    }
+    if ("uniform" == name)
+    {
+        return SizeDistribution::Uniform;
+    }
+    if ("log-uniform" == name)
+    {
+        return SizeDistribution::LogUniform;
+    }
+
+    throw po::validation_error(
+        po::validation_error::invalid_option_value, "size-distribution", name);
+}
+
+po::options_description profile_options_description()
+{
+    po::options_description desc("Profile options");
+    desc.add_options()
+        ("seed", po::value<std::uint64_t>()->default_value(0), "random seed")
+        ("files", po::value<std::uint32_t>()->default_value(100), "number of files")
+        ("size-distribution", po::value<std::string>()->default_value("log-uniform"), "file size distribution (fixed, uniform, log-uniform)")
+        ("min-file-size", po::value<std::uint32_t>()->default_value(0), "smallest file size")
+        ("max-file-size", po::value<std::uint32_t>()->default_value(64 * 1024), "largest file size")
+        ("depth", po::value<std::uint32_t>()->default_value(2), "directory tree depth")
+        ("fan-out", po::value<std::uint32_t>()->default_value(4), "subdirectories per directory")
+        ("churn-cycles", po::value<std::uint32_t>()->default_value(0), "number of delete/rewrite cycles")
+        ("churn-fraction", po::value<double>()->default_value(0.25), "fraction of files touched per cycle")
+    ;
+
+    return desc;
+}
+
+GenerationProfile read_profile(po::variables_map const & vm)
+{
+    GenerationProfile profile {};
+
+    profile.seed = vm["seed"].as<std::uint64_t>();
+    profile.file_count = vm["files"].as<std::uint32_t>();
+    profile.size_distribution = parse_size_distribution(vm["size-distribution"].as<std::string>());
+    profile.min_file_size = vm["min-file-size"].as<std::uint32_t>();
+    profile.max_file_size = vm["max-file-size"].as<std::uint32_t>();
+    profile.depth = vm["depth"].as<std::uint32_t>();
+    profile.fan_out = vm["fan-out"].as<std::uint32_t>();
+    profile.churn_cycles = vm["churn-cycles"].as<std::uint32_t>();
+    profile.churn_fraction = vm["churn-fraction"].as<double>();
+
+    return profile;
+}
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description generic("Allowed options");
+    generic.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_GEN_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_GEN_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>()->required(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_GEN_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_GEN_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("output-file,o", po::value<std::string>()->required(), "output image file")
+        ("profile", po::value<std::string>(), "file with profile options, one \"name = value\" per line")
+    ;
+
+    auto const profile = profile_options_description();
+
+    po::options_description desc {};
+    desc.add(generic).add(profile);
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -o OUTPUT_FILE -c BLOCK_COUNT [-l LITTLEFS_VERSION] "
+                        "[-b BLOCK_SIZE] [-r READ_SIZE] [-p PROG_SIZE] [--profile PROFILE] "
+                        "[PROFILE_OPTIONS]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-gen {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    // Options given on the command line take precedence over the profile file
+    if (0 != vm.count("profile"))
+    {
+        po::store(po::parse_config_file<char>(vm["profile"].as<std::string>().c_str(), profile),
+                  vm);
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.block_count = vm["block-count"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.output_file_path = vm["output-file"].as<std::string>();
+    options.profile = read_profile(vm);
+
+    return options;
+}
+
+template <typename FS>
+GenerationStatistics generate(MemoryBlockDevice & image, CommandLineOptions const & options)
+{
+    FS::format(image, options.read_size, options.prog_size);
+
+    FS filesystem(std::make_unique<BlockDeviceView>(image), options.read_size, options.prog_size);
+    return generate_image(filesystem, options.profile);
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto const options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    // Everything happens in memory; the image is written out in one go at the end
+    MemoryBlockDevice image(options->block_size, options->block_count);
+
+    GenerationStatistics statistics {};
+    switch (options->version)
+    {
+    case 1:
+        statistics = generate<LittleFS1>(image, *options);
+        break;
+
+    case 2:
+        statistics = generate<LittleFS2>(image, *options);
+        break;
+
+    default:
+        throw std::runtime_error("Invalid littlefs version specified");
+    }
+
+    CFile output(options->output_file_path, "wb");
+    auto const data = image.data();
+    if (output.write(data) != static_cast<std::size_t>(data.size()))
+    {
+        throw std::runtime_error("Failed writing the image");
+    }
+
+    std::cout << fmt::format("{} files ({} bytes) in {} directories, {} deletions, {} rewrites\n",
+                             statistics.files,
+                             statistics.bytes,
+                             statistics.directories,
+                             statistics.deletions,
+                             statistics.rewrites);
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <FileBlockDevice.hpp>
+#include <ImageFile.hpp>
+#include <JsonWriter.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_ls_config.h>
+#include <littlefs_utils_config.h>
+
+
+enum class ListingFormat
+{
+    Short,
+    Long,
+    Json,
+    Ndjson,
+};
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_file_path;
+    std::string directory;
+    bool recursive;
+    ListingFormat format;
+};
+
+
+namespace po = boost::program_options;
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_LS_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_LS_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_LS_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_LS_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs image file")
+        ("directory,d", po::value<std::string>()->default_value("/"), "directory to list")
+        ("recursive,R", "also list the contents of every subdirectory")
+        ("long", "show the type and size of every entry")
+        ("json", "write a JSON array with one object per entry")
+        ("ndjson", "write one JSON object per entry and line")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
+                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] [-d DIRECTORY] [-R] "
+                        "[--long | --json | --ndjson]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-ls {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.directory = vm["directory"].as<std::string>();
+    options.recursive = (0 != vm.count("recursive"));
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    if (vm.count("long") + vm.count("json") + vm.count("ndjson") > 1)
+    {
+        throw std::runtime_error("--long, --json and --ndjson are mutually exclusive");
+    }
+    options.format = 0 != vm.count("ndjson") ? ListingFormat::Ndjson
+                     : 0 != vm.count("json") ? ListingFormat::Json
+                     : 0 != vm.count("long") ? ListingFormat::Long
+                                             : ListingFormat::Short;
+
+    return options;
+}
+
+std::unique_ptr<IBlockDevice> open_image(CommandLineOptions & options)
+{
+    options.block_count =
+        image_block_count(options.input_file_path, options.block_size, options.block_count);
+
+    return std::make_unique<FileBlockDevice>(options.input_file_path,
+                                             false,
+                                             options.block_size,
+                                             options.block_count.value());
+}
+
+void write_entry(JsonWriter & writer,
+                 std::string const & path,
+                 LittleFS::DirectoryEntry const & entry)
+{
+    writer.begin_object()
+        .member("path", path)
+        .member("type", entry.is_directory ? "directory" : "file")
+        .member("size", entry.size)
+        .end_object();
+}
+
+// With --json, `array` is the array every entry goes into
+void print_entry(CommandLineOptions const & options,
+                 JsonWriter & array,
+                 std::string const & path,
+                 LittleFS::DirectoryEntry const & entry)
+{
+    switch (options.format)
+    {
+    case ListingFormat::Short:
+        std::cout << path << '\n';
+        break;
+
+    case ListingFormat::Long:
+        std::cout << fmt::format(
+            "{} {:>10} {}\n", entry.is_directory ? 'd' : '-', entry.size, path);
+        break;
+
+    case ListingFormat::Json:
+        write_entry(array, path, entry);
+        break;
+
+    case ListingFormat::Ndjson:
+    {
+        JsonWriter writer(std::cout);
+        write_entry(writer, path, entry);
+        std::cout << '\n';
+        break;
+    }
+    }
+}
+
+// Prints entries as littlefs reads them, descending into a subdirectory as
+// soon as it is seen. Only the directories on the current path are open at a
+// time, so memory does not grow with the number of entries.
+void list_directory(CommandLineOptions const & options,
+                    LittleFS & filesystem,
+                    JsonWriter & array,
+                    std::string const & directory)
+{
+    filesystem.read_directory(
+        directory.empty() ? "/" : directory, [&](LittleFS::DirectoryEntry const & entry) {
+            if (entry.name == "." || entry.name == "..")
+            {
+                return;
+            }
+
+            auto const path = directory + "/" + entry.name;
+            print_entry(options, array, path, entry);
+
+            if (options.recursive && entry.is_directory)
+            {
+                list_directory(options, filesystem, array, path);
+            }
+        });
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    auto const filesystem = open_filesystem(
+        options->version, open_image(*options), options->read_size, options->prog_size);
+
+    // Paths are printed as "/a/b", whatever the form of the directory option
+    auto directory = options->directory;
+    while (!directory.empty() && directory.back() == '/')
+    {
+        directory.pop_back();
+    }
+    if (!directory.empty() && directory.front() != '/')
+    {
+        directory.insert(0, "/");
+    }
+
+    // The array is written as entries are read, so --json streams too
+    JsonWriter array(std::cout);
+    if (ListingFormat::Json == options->format)
+    {
+        array.begin_array();
+    }
+    list_directory(*options, *filesystem, array, directory);
+    if (ListingFormat::Json == options->format)
+    {
+        array.end_array();
+        std::cout << '\n';
+    }
+    std::cout.flush();
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
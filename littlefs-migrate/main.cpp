@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockDeviceView.hpp>
+#include <BoundedQueue.hpp>
+#include <ImageFile.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <ThreadPool.hpp>
+#include <TreeEntry.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_migrate_config.h>
+#include <littlefs_utils_config.h>
+
+#include <LittleFS1.hpp>
+#include <LittleFS2.hpp>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_file_path;
+    std::string output_file_path;
+    bool in_place;
+};
+
+
+namespace po = boost::program_options;
+
+
+namespace {
+
+// Enough buffers in flight for the reader to stay ahead of the writer on small files
+constexpr std::size_t POOL_BUFFERS = 8;
+constexpr std::size_t BUFFER_SIZE = 256 * 1024;
+
+struct Chunk
+{
+    std::vector<std::byte> buffer {};
+    std::size_t size {};
+};
+
+struct MigrationStatistics
+{
+    std::uint64_t directories {};
+    std::uint64_t files {};
+    std::uint64_t bytes {};
+    double seconds {};
+};
+
+}  // namespace
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_MIGRATE_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_MIGRATE_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_MIGRATE_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs 1 image file")
+        ("output-file,o", po::value<std::string>()->required(), "littlefs 2 image file")
+        ("in-place", "convert the image with lfs2_migrate instead of copying the files")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE -o OUTPUT_FILE [-b BLOCK_SIZE] [-c BLOCK_COUNT] "
+                        "[-r READ_SIZE] [-p PROG_SIZE] [--in-place]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-migrate {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.output_file_path = vm["output-file"].as<std::string>();
+    options.in_place = (0 != vm.count("in-place"));
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+#if !defined(LFS2_MIGRATE)
+    if (options.in_place)
+    {
+        throw std::runtime_error("--in-place needs littlefs2 built with LITTLEFS2_MIGRATE=ON");
+    }
+#endif
+
+    return options;
+}
+
+// A reader thread fills buffers from the littlefs 1 files while this thread
+// writes them to littlefs 2. The buffers cycle between the two through a
+// fixed pool, so memory use does not depend on the size of the files.
+MigrationStatistics copy_tree(LittleFS & source,
+                              LittleFS & target,
+                              std::vector<TreeEntry> const & entries)
+{
+    BoundedQueue<std::vector<std::byte>> free_buffers(POOL_BUFFERS);
+    BoundedQueue<Chunk> chunks(POOL_BUFFERS);
+    for (std::size_t index = 0; index < POOL_BUFFERS; ++index)
+    {
+        free_buffers.push(std::vector<std::byte>(BUFFER_SIZE));
+    }
+
+    // Declared after the queues, so that it joins the reader before they go away
+    ThreadPool reader_thread(1);
+    auto reader = reader_thread.submit([&]() {
+        auto const closer = gsl::finally([&chunks]() { chunks.close(); });
+
+        for (auto const & entry : entries)
+        {
+            if (entry.is_directory)
+            {
+                continue;
+            }
+
+            auto const file = source.open_file(entry.path, LittleFS::OpenFlags::Read);
+            for (;;)
+            {
+                auto buffer = free_buffers.pop();
+                if (!buffer)
+                {
+                    // The writer gave up
+                    return;
+                }
+
+                auto const count = file->read(*buffer);
+                if (0 == count)
+                {
+                    free_buffers.push(std::move(*buffer));
+                    break;
+                }
+                if (!chunks.push({std::move(*buffer), count}))
+                {
+                    return;
+                }
+            }
+        }
+    });
+
+    MigrationStatistics statistics {};
+    try
+    {
+        for (auto const & entry : entries)
+        {
+            if (entry.is_directory)
+            {
+                target.make_directory(entry.path);
+                ++statistics.directories;
+                continue;
+            }
+
+            auto const file = target.open_file(entry.path,
+                                               LittleFS::OpenFlags::Write
+                                                   | LittleFS::OpenFlags::CreateIfNotExists
+                                                   | LittleFS::OpenFlags::Truncate);
+
+            std::uint64_t written = 0;
+            while (written < entry.size)
+            {
+                auto chunk = chunks.pop();
+                if (!chunk)
+                {
+                    break;
+                }
+
+                auto const data = gsl::span<std::byte const>(chunk->buffer)
+                                      .first(static_cast<std::ptrdiff_t>(chunk->size));
+                if (file->write(data) != chunk->size)
+                {
+                    throw std::runtime_error(fmt::format("Short write to {}", entry.path));
+                }
+                written += chunk->size;
+                free_buffers.push(std::move(chunk->buffer));
+            }
+
+            if (written != entry.size)
+            {
+                // A failed reader closes the queue early and explains why
+                reader.get();
+                throw std::runtime_error(
+                    fmt::format("Read {} of {} bytes from {}", written, entry.size, entry.path));
+            }
+
+            // The final commit happens here, and may still fail
+            file->close();
+
+            ++statistics.files;
+            statistics.bytes += written;
+        }
+    }
+    catch (...)
+    {
+        free_buffers.close();
+        chunks.close();
+        throw;
+    }
+
+    reader.get();
+    return statistics;
+}
+
+std::unique_ptr<MemoryBlockDevice> migrate_by_copy(CommandLineOptions const & options,
+                                                   MemoryBlockDevice & source_image,
+                                                   MigrationStatistics & statistics)
+{
+    LittleFS1 source(
+        std::make_unique<BlockDeviceView>(source_image), options.read_size, options.prog_size);
+    auto const entries = list_tree(source);
+
+    auto image = std::make_unique<MemoryBlockDevice>(options.block_size,
+                                                     options.block_count.value());
+    LittleFS2::format(*image, options.read_size, options.prog_size);
+    LittleFS2 target(
+        std::make_unique<BlockDeviceView>(*image), options.read_size, options.prog_size);
+
+    auto const start = std::chrono::steady_clock::now();
+    statistics = copy_tree(source, target, entries);
+    statistics.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return image;
+}
+
+#if defined(LFS2_MIGRATE)
+void migrate_in_place(CommandLineOptions const & options,
+                      MemoryBlockDevice & image,
+                      MigrationStatistics & statistics)
+{
+    // Only for the report: lfs2_migrate does not say what it moved
+    {
+        LittleFS1 source(
+            std::make_unique<BlockDeviceView>(image), options.read_size, options.prog_size);
+        for (auto const & entry : list_tree(source))
+        {
+            if (entry.is_directory)
+            {
+                ++statistics.directories;
+            }
+            else
+            {
+                ++statistics.files;
+                statistics.bytes += entry.size;
+            }
+        }
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    LittleFS2::migrate(image, options.read_size, options.prog_size);
+    statistics.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+#endif
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    // Both images live in memory, so the output file may be the input file
+    options->block_count =
+        image_block_count(options->input_file_path, options->block_size, options->block_count);
+    auto image = load_image(options->input_file_path, options->block_size, *options->block_count);
+
+    MigrationStatistics statistics {};
+#if defined(LFS2_MIGRATE)
+    if (options->in_place)
+    {
+        migrate_in_place(*options, *image, statistics);
+    }
+    else
+#endif
+    {
+        image = migrate_by_copy(*options, *image, statistics);
+    }
+
+    save_image(image->data(), options->output_file_path);
+
+    auto constexpr MEBIBYTE = 1024.0 * 1024.0;
+    auto const throughput =
+        statistics.seconds > 0.0
+            ? static_cast<double>(statistics.bytes) / MEBIBYTE / statistics.seconds
+            : 0.0;
+    std::cout << fmt::format("Migrated {} directories and {} files ({} bytes) in {:.3f} s, "
+                             "{:.1f} MiB/s\n",
+                             statistics.directories,
+                             statistics.files,
+                             statistics.bytes,
+                             statistics.seconds,
+                             throughput);
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
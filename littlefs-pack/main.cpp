@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockDeviceView.hpp>
+#include <CFile.hpp>
+#include <CowBlockDevice.hpp>
+#include <HostDirectory.hpp>
+#include <ImageFile.hpp>
+#include <ImagePacker.hpp>
+#include <ImageSynthesizer2.hpp>
+#include <InputArchive.hpp>
+#include <MappedFile.hpp>
+#include <MappedFileInputStream.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <MemoryInputStream.hpp>
+#include <ThreadPool.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_pack_config.h>
+#include <littlefs_utils_config.h>
+
+#include <LittleFS1.hpp>
+#include <LittleFS2.hpp>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::uint32_t block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_path;
+    std::optional<std::string> output_file_path;
+    bool direct;
+    bool verify;
+    std::optional<std::string> variants_file_path;
+    unsigned jobs;
+};
+
+struct VariantResult
+{
+    std::size_t line;
+    std::string output_file_path;
+    std::size_t overrides;
+    std::size_t modified_blocks;
+    std::string error;
+};
+
+
+namespace po = boost::program_options;
+
+
+namespace {
+
+// Largest attribute littlefs v2 can store inline
+constexpr std::uint32_t LFS2_INLINE_LIMIT = 0x3fe;
+
+// The superblock pair, plus the separate root directory pair in littlefs v1
+constexpr std::uint32_t LFS1_RESERVED_BLOCKS = 4;
+constexpr std::uint32_t LFS2_RESERVED_BLOCKS = 2;
+
+}  // namespace
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_PACK_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_PACK_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>()->required(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_PACK_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_PACK_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input,i", po::value<std::string>()->default_value("-"), "input archive or directory")
+        ("output-file,o", po::value<std::string>(), "output image file")
+        ("direct", "lay out the image directly instead of writing through littlefs (littlefs 2 only)")
+        ("verify", "with --direct, mount the finished image and compare it with the input")
+        ("variants", po::value<std::string>(), "manifest of per-unit variants built from the image")
+        ("jobs,j", po::value<unsigned>()->default_value(0), "number of variants written in parallel (0 = one per hardware thread)")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -c BLOCK_COUNT [-o OUTPUT_FILE] [-i INPUT] "
+                        "[-l LITTLEFS_VERSION] [-b BLOCK_SIZE] [-r READ_SIZE] [-p PROG_SIZE] "
+                        "[--direct] [--verify] [--variants MANIFEST [-j JOBS]]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-pack {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.block_count = vm["block-count"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_path = vm["input"].as<std::string>();
+    options.direct = (0 != vm.count("direct"));
+    options.verify = (0 != vm.count("verify"));
+    options.jobs = vm["jobs"].as<unsigned>();
+
+    if (0 != vm.count("output-file"))
+    {
+        options.output_file_path = vm["output-file"].as<std::string>();
+    }
+    if (0 != vm.count("variants"))
+    {
+        options.variants_file_path = vm["variants"].as<std::string>();
+    }
+    if (!options.output_file_path && !options.variants_file_path)
+    {
+        throw po::required_option("output-file");
+    }
+
+    if (options.direct && 2 != options.version)
+    {
+        throw std::runtime_error("--direct is only supported for littlefs 2");
+    }
+    if (options.verify && !options.direct)
+    {
+        throw std::runtime_error("--verify requires --direct");
+    }
+
+    return options;
+}
+
+void pack_directory(ImagePacker & packer, std::string const & root)
+{
+    auto const entries = list_host_directory(root);
+
+    // Everything is known up front, so check the whole tree before writing anything
+    for (auto const & entry : entries)
+    {
+        if (entry.is_directory)
+        {
+            packer.reserve_directory();
+        }
+        else
+        {
+            packer.reserve_file(entry.size);
+        }
+    }
+
+    for (auto const & entry : entries)
+    {
+        if (entry.is_directory)
+        {
+            packer.add_directory(entry.path);
+            continue;
+        }
+
+        MappedFile const contents(entry.host_path);
+        MemoryInputStream stream(contents.data());
+        packer.add_file(entry.path, stream);
+    }
+}
+
+void pack_archive(ImagePacker & packer, std::string const & path)
+{
+    InputArchive archive(("-" == path) ? CFile::standard_input() : CFile(path, "rb"));
+
+    while (auto const entry = archive.next_entry())
+    {
+        if (entry->is_directory)
+        {
+            packer.reserve_directory();
+            packer.add_directory(entry->path);
+        }
+        else if (entry->is_regular_file)
+        {
+            packer.reserve_file(entry->size);
+            packer.add_file(entry->path, archive);
+        }
+        else
+        {
+            std::cerr << fmt::format("Skipping {}: not a regular file or directory\n",
+                                     entry->path);
+        }
+    }
+}
+
+template <typename FS>
+PackStatistics pack(MemoryBlockDevice & image,
+                    CommandLineOptions const & options,
+                    PackGeometry const & geometry,
+                    std::uint32_t & used_blocks)
+{
+    FS::format(image, options.read_size, options.prog_size);
+
+    FS filesystem(std::make_unique<BlockDeviceView>(image), options.read_size, options.prog_size);
+    ImagePacker packer(filesystem, geometry);
+
+    if ("-" != options.input_path && is_host_directory(options.input_path))
+    {
+        pack_directory(packer, options.input_path);
+    }
+    else
+    {
+        pack_archive(packer, options.input_path);
+    }
+
+    used_blocks = filesystem.used_blocks();
+    return packer.statistics();
+}
+
+PackStatistics add_directory_contents(ImageSynthesizer2 & synthesizer, std::string const & root)
+{
+    PackStatistics statistics {};
+
+    for (auto const & entry : list_host_directory(root))
+    {
+        if (entry.is_directory)
+        {
+            synthesizer.add_directory(entry.path);
+            ++statistics.directories;
+            continue;
+        }
+
+        if (entry.size > std::numeric_limits<std::uint32_t>::max())
+        {
+            throw std::length_error(fmt::format("File too large: {}", entry.path));
+        }
+
+        synthesizer.add_file(entry.path,
+                             static_cast<std::uint32_t>(entry.size),
+                             [host_path = entry.host_path]() {
+                                 return std::make_unique<MappedFileInputStream>(host_path);
+                             });
+        ++statistics.files;
+        statistics.bytes += entry.size;
+    }
+
+    return statistics;
+}
+
+// An archive can only be read once, so file contents are kept in memory until
+// the image is written. They are bounded by the image size anyway.
+PackStatistics add_archive_contents(ImageSynthesizer2 & synthesizer, std::string const & path)
+{
+    PackStatistics statistics {};
+
+    InputArchive archive(("-" == path) ? CFile::standard_input() : CFile(path, "rb"));
+    while (auto const entry = archive.next_entry())
+    {
+        if (entry->is_directory)
+        {
+            synthesizer.add_directory(entry->path);
+            ++statistics.directories;
+            continue;
+        }
+        if (!entry->is_regular_file)
+        {
+            std::cerr << fmt::format("Skipping {}: not a regular file or directory\n",
+                                     entry->path);
+            continue;
+        }
+
+        if (entry->size > std::numeric_limits<std::uint32_t>::max())
+        {
+            throw std::length_error(fmt::format("File too large: {}", entry->path));
+        }
+
+        auto contents =
+            std::make_shared<std::vector<std::byte>>(static_cast<std::size_t>(entry->size));
+        for (gsl::span<std::byte> remaining(*contents); !remaining.empty();)
+        {
+            auto const bytes_read = archive.read(remaining);
+            if (0 == bytes_read)
+            {
+                throw std::runtime_error(fmt::format("Truncated archive entry: {}", entry->path));
+            }
+            remaining = remaining.subspan(static_cast<std::ptrdiff_t>(bytes_read));
+        }
+
+        synthesizer.add_file(entry->path,
+                             static_cast<std::uint32_t>(entry->size),
+                             [contents = std::move(contents)]() {
+                                 return std::make_unique<MemoryInputStream>(*contents);
+                             });
+        ++statistics.files;
+        statistics.bytes += entry->size;
+    }
+
+    return statistics;
+}
+
+PackStatistics synthesize(MemoryBlockDevice & image,
+                          CommandLineOptions const & options,
+                          std::uint32_t & used_blocks)
+{
+    ImageSynthesizer2 synthesizer(
+        {options.block_size, options.block_count, options.prog_size, 0});
+
+    auto const statistics = ("-" != options.input_path && is_host_directory(options.input_path))
+                                ? add_directory_contents(synthesizer, options.input_path)
+                                : add_archive_contents(synthesizer, options.input_path);
+
+    synthesizer.write(image);
+
+    LittleFS2 filesystem(
+        std::make_unique<BlockDeviceView>(image), options.read_size, options.prog_size);
+    if (options.verify)
+    {
+        synthesizer.verify(filesystem);
+    }
+
+    used_blocks = filesystem.used_blocks();
+    return statistics;
+}
+
+void save_image(CowBlockDevice const & image, std::string const & path)
+{
+    CFile output(path, "wb");
+    for (std::uint32_t block = 0; block < image.block_count(); ++block)
+    {
+        auto const data = image.block(block);
+        if (output.write(data) != static_cast<std::size_t>(data.size()))
+        {
+            throw std::runtime_error("Failed writing the image");
+        }
+    }
+}
+
+// A variant line holds the output image, then any number of IMAGE_PATH=HOST_FILE
+// overrides, which are written on top of the template
+VariantResult build_variant(MemoryBlockDevice const & template_image,
+                            CommandLineOptions const & options,
+                            std::size_t const line_number,
+                            std::string const & line)
+{
+    VariantResult result {line_number, {}, 0, 0, {}};
+
+    try
+    {
+        auto const arguments = po::split_unix(line);
+        result.output_file_path = arguments.at(0);
+
+        // Only the blocks this variant touches are copied
+        CowBlockDevice image(template_image.data(), options.block_size);
+        {
+            auto const filesystem = open_filesystem(options.version,
+                                                    std::make_unique<BlockDeviceView>(image),
+                                                    options.read_size,
+                                                    options.prog_size);
+            ImagePacker packer(*filesystem, {options.block_size, options.block_count, 0, 0});
+
+            for (auto argument = std::next(arguments.begin()); argument != arguments.end();
+                 ++argument)
+            {
+                auto const separator = argument->find('=');
+                if (std::string::npos == separator)
+                {
+                    throw std::runtime_error(fmt::format("Invalid override: {}", *argument));
+                }
+
+                MappedFileInputStream stream(argument->substr(separator + 1));
+                packer.add_file(argument->substr(0, separator), stream);
+                ++result.overrides;
+            }
+        }
+
+        result.modified_blocks = image.modified_blocks();
+        save_image(image, result.output_file_path);
+    }
+    catch (std::exception const & exception)
+    {
+        result.error = exception.what();
+    }
+
+    return result;
+}
+
+// Forks every variant of the manifest from the template on a pool of workers.
+// Returns the number of variants that failed.
+std::size_t build_variants(MemoryBlockDevice const & template_image,
+                           CommandLineOptions const & options)
+{
+    std::ifstream manifest(options.variants_file_path.value());
+    if (!manifest)
+    {
+        throw std::runtime_error("Failed opening variants manifest");
+    }
+
+    std::vector<std::future<VariantResult>> pending {};
+    {
+        ThreadPool pool(options.jobs);
+
+        std::string line {};
+        for (std::size_t line_number = 1; std::getline(manifest, line); ++line_number)
+        {
+            auto const first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#')
+            {
+                continue;
+            }
+
+            pending.push_back(pool.submit([&template_image, &options, line_number, line]() {
+                return build_variant(template_image, options, line_number, line);
+            }));
+        }
+    }
+
+    std::size_t failed = 0;
+    for (auto & future : pending)
+    {
+        auto const result = future.get();
+        if (result.error.empty())
+        {
+            std::cout << fmt::format("{}: {} files overridden, {} blocks changed\n",
+                                     result.output_file_path,
+                                     result.overrides,
+                                     result.modified_blocks);
+        }
+        else
+        {
+            std::cerr << fmt::format("Line {}: {}\n", result.line, result.error);
+            ++failed;
+        }
+    }
+
+    return failed;
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto const options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    // Everything happens in memory; the image is written out in one go at the end
+    MemoryBlockDevice image(options->block_size, options->block_count);
+
+    PackGeometry geometry {};
+    geometry.block_size = options->block_size;
+    geometry.block_count = options->block_count;
+
+    PackStatistics statistics {};
+    std::uint32_t used_blocks = 0;
+    switch (options->version)
+    {
+    case 1:
+        geometry.reserved_blocks = LFS1_RESERVED_BLOCKS;
+        statistics = pack<LittleFS1>(image, *options, geometry, used_blocks);
+        break;
+
+    case 2:
+        if (options->direct)
+        {
+            statistics = synthesize(image, *options, used_blocks);
+            break;
+        }
+
+        geometry.inline_max = std::min(options->block_size, LFS2_INLINE_LIMIT);
+        geometry.reserved_blocks = LFS2_RESERVED_BLOCKS;
+        statistics = pack<LittleFS2>(image, *options, geometry, used_blocks);
+        break;
+
+    default:
+        throw std::runtime_error("Invalid littlefs version specified");
+    }
+
+    if (options->output_file_path)
+    {
+        save_image(image.data(), *options->output_file_path);
+    }
+
+    std::cout << fmt::format("{} files ({} bytes) in {} directories, "
+                             "{} of {} blocks used ({:.1f}%)\n",
+                             statistics.files,
+                             statistics.bytes,
+                             statistics.directories,
+                             used_blocks,
+                             options->block_count,
+                             100.0 * used_blocks / options->block_count);
+
+    if (options->variants_file_path && 0 != build_variants(image, *options))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockPatch.hpp>
+#include <CowBlockDevice.hpp>
+#include <FileBlockDevice.hpp>
+#include <MappedFile.hpp>
+#include <Util.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::string input_file_path;
+    std::string patch_file_path;
+    bool check_only;
+};
+
+
+namespace po = boost::program_options;
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs image file to patch in place")
+        ("patch-file,d", po::value<std::string>()->required(), "block patch written by littlefs-diff")
+        ("check", "only check that the patch applies, without writing")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE -d PATCH_FILE [--check]\n", executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-patch {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.patch_file_path = vm["patch-file"].as<std::string>();
+    options.check_only = (0 != vm.count("check"));
+
+    return options;
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto const options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    auto const patch = BlockPatch::load(options->patch_file_path);
+
+    auto const image_size = static_cast<std::uintmax_t>(patch.block_size()) * patch.block_count();
+    if (file_size(options->input_file_path) != image_size)
+    {
+        throw std::runtime_error("Image size does not match the patch");
+    }
+
+    BlockPatch::ApplyResult result {};
+    if (options->check_only)
+    {
+        // Applying to a copy-on-write view runs every check and leaves the file alone
+        MappedFile const image(options->input_file_path);
+        CowBlockDevice block_device(image.data(), patch.block_size());
+        result = patch.apply(block_device);
+    }
+    else
+    {
+        FileBlockDevice block_device(
+            options->input_file_path, true, patch.block_size(), patch.block_count());
+        result = patch.apply(block_device);
+    }
+
+    std::cout << fmt::format("{} {} blocks, {} already patched\n",
+                             options->check_only ? "Would write" : "Wrote",
+                             result.written,
+                             result.already_applied);
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
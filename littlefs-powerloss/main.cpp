@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockDeviceView.hpp>
+#include <CFile.hpp>
+#include <CowBlockDevice.hpp>
+#include <ImageFile.hpp>
+#include <ImageGenerator.hpp>
+#include <JsonWriter.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <PowerLoss.hpp>
+#include <RecordingBlockDevice.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_powerloss_config.h>
+#include <littlefs_utils_config.h>
+
+#include <LittleFS1.hpp>
+#include <LittleFS2.hpp>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::uint32_t block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    GenerationProfile profile;
+    std::uint32_t torn_granularity;
+    bool read_data;
+    unsigned jobs;
+    std::size_t max_failures;
+    std::string report_file_path;
+    std::optional<std::string> failure_directory;
+};
+
+
+namespace po = boost::program_options;
+
+
+// Exit code of a run where some state failed its check, as opposed to -1 for a
+// run that could not complete
+static constexpr int CHECK_FAILED = 2;
+
+
+struct Workload
+{
+    GenerationStatistics statistics {};
+    std::vector<WriteOperation> writes {};
+    double seconds {};
+};
+
+
+SizeDistribution parse_size_distribution(std::string const & name)
+{
+    if ("fixed" == name)
+    {
+        return SizeDistribution::Fixed;
+    }
+    if ("uniform" == name)
+    {
+        return SizeDistribution::Uniform;
+    }
+    if ("log-uniform" == name)
+    {
+        return SizeDistribution::LogUniform;
+    }
+
+    throw po::validation_error(
+        po::validation_error::invalid_option_value, "size-distribution", name);
+}
+
+po::options_description profile_options_description()
+{
+    po::options_description desc("Workload profile options");
+    desc.add_options()
+        ("seed", po::value<std::uint64_t>()->default_value(0), "random seed")
+        ("files", po::value<std::uint32_t>()->default_value(20), "number of files")
+        ("size-distribution", po::value<std::string>()->default_value("log-uniform"), "file size distribution (fixed, uniform, log-uniform)")
+        ("min-file-size", po::value<std::uint32_t>()->default_value(0), "smallest file size")
+        ("max-file-size", po::value<std::uint32_t>()->default_value(4 * 1024), "largest file size")
+        ("depth", po::value<std::uint32_t>()->default_value(1), "directory tree depth")
+        ("fan-out", po::value<std::uint32_t>()->default_value(2), "subdirectories per directory")
+        ("churn-cycles", po::value<std::uint32_t>()->default_value(1), "number of delete/rewrite cycles")
+        ("churn-fraction", po::value<double>()->default_value(0.25), "fraction of files touched per cycle")
+    ;
+
+    return desc;
+}
+
+GenerationProfile read_profile(po::variables_map const & vm)
+{
+    GenerationProfile profile {};
+
+    profile.seed = vm["seed"].as<std::uint64_t>();
+    profile.file_count = vm["files"].as<std::uint32_t>();
+    profile.size_distribution = parse_size_distribution(vm["size-distribution"].as<std::string>());
+    profile.min_file_size = vm["min-file-size"].as<std::uint32_t>();
+    profile.max_file_size = vm["max-file-size"].as<std::uint32_t>();
+    profile.depth = vm["depth"].as<std::uint32_t>();
+    profile.fan_out = vm["fan-out"].as<std::uint32_t>();
+    profile.churn_cycles = vm["churn-cycles"].as<std::uint32_t>();
+    profile.churn_fraction = vm["churn-fraction"].as<double>();
+
+    return profile;
+}
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description generic("Allowed options");
+    generic.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_POWERLOSS_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_POWERLOSS_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>()->required(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_POWERLOSS_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_POWERLOSS_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("profile", po::value<std::string>(), "file with profile options, one \"name = value\" per line")
+        ("torn-granularity", po::value<std::uint32_t>(), "bytes between the torn states of a program (default: prog size, 0 = no torn programs)")
+        ("read-data", "read every file to its end in every state")
+        ("jobs,j", po::value<unsigned>()->default_value(0), "number of checking threads (0 = one per hardware thread)")
+        ("report-file", po::value<std::string>()->default_value("-"), "JSON report")
+        ("max-failures", po::value<std::size_t>()->default_value(100), "number of failed states detailed in the report")
+        ("save-failures", po::value<std::string>(), "directory to write the image of every failed state to")
+    ;
+
+    auto const profile = profile_options_description();
+
+    po::options_description desc {};
+    desc.add(generic).add(profile);
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -c BLOCK_COUNT [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
+                        "[-r READ_SIZE] [-p PROG_SIZE] [--profile PROFILE] [PROFILE_OPTIONS] "
+                        "[--torn-granularity BYTES] [--read-data] [-j JOBS] "
+                        "[--report-file REPORT_FILE] [--max-failures N] "
+                        "[--save-failures DIRECTORY]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-powerloss {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    // Options given on the command line take precedence over the profile file
+    if (0 != vm.count("profile"))
+    {
+        po::store(po::parse_config_file<char>(vm["profile"].as<std::string>().c_str(), profile),
+                  vm);
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.block_count = vm["block-count"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.profile = read_profile(vm);
+    options.torn_granularity = 0 != vm.count("torn-granularity")
+                                   ? vm["torn-granularity"].as<std::uint32_t>()
+                                   : options.prog_size;
+    options.read_data = (0 != vm.count("read-data"));
+    options.jobs = vm["jobs"].as<unsigned>();
+    options.report_file_path = vm["report-file"].as<std::string>();
+    options.max_failures = vm["max-failures"].as<std::size_t>();
+
+    if (0 != vm.count("save-failures"))
+    {
+        options.failure_directory = vm["save-failures"].as<std::string>();
+    }
+
+    return options;
+}
+
+// Formats `base`, which is not part of the workload, then runs the workload on
+// a copy-on-write view of it and records every program and erase
+template <typename FS>
+Workload record_workload(MemoryBlockDevice & base, CommandLineOptions const & options)
+{
+    FS::format(base, options.read_size, options.prog_size);
+
+    RecordingBlockDevice recording(std::make_unique<CowBlockDevice>(base.data(), base.block_size()),
+                                   true);
+
+    Workload workload {};
+    auto const start = std::chrono::steady_clock::now();
+    {
+        FS filesystem(
+            std::make_unique<BlockDeviceView>(recording), options.read_size, options.prog_size);
+        workload.statistics = generate_image(filesystem, options.profile);
+    }
+    workload.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    workload.writes = recording.writes();
+
+    return workload;
+}
+
+char const * operation_name(WriteOperation::Kind const kind) noexcept
+{
+    return WriteOperation::Kind::Erase == kind ? "erase" : "program";
+}
+
+void write_report(CommandLineOptions const & options,
+                  Workload const & workload,
+                  PowerLossReport const & report,
+                  double const seconds,
+                  std::ostream & stream)
+{
+    JsonWriter writer(stream);
+
+    auto const & statistics = workload.statistics;
+    auto const programs = static_cast<std::uint64_t>(
+        std::count_if(workload.writes.cbegin(), workload.writes.cend(), [](auto const & write) {
+            return WriteOperation::Kind::Program == write.kind;
+        }));
+
+    writer.begin_object()
+        .member("littlefs_version", options.version)
+        .member("block_size", options.block_size)
+        .member("block_count", options.block_count)
+        .member("torn_granularity", options.torn_granularity)
+        .member("data_read", options.read_data);
+
+    writer.key("workload")
+        .begin_object()
+        .member("directories", statistics.directories)
+        .member("files", statistics.files)
+        .member("bytes", statistics.bytes)
+        .member("deletions", statistics.deletions)
+        .member("rewrites", statistics.rewrites)
+        .member("programs", programs)
+        .member("erases", static_cast<std::uint64_t>(workload.writes.size()) - programs)
+        .member("seconds", workload.seconds)
+        .end_object();
+
+    auto const states_per_second = seconds > 0 ? static_cast<double>(report.states) / seconds : 0;
+    writer.member("states", report.states)
+        .member("failed_states", report.failed_states)
+        .member("tolerated_states", report.tolerated_states)
+        .member("seconds", seconds)
+        .member("states_per_second", states_per_second);
+
+    writer.key("issues").begin_object();
+    for (auto const & [kind, count] : report.issue_counts)
+    {
+        writer.member(issue_kind_name(kind), count);
+    }
+    writer.end_object();
+
+    writer.key("failures").begin_array();
+    for (auto const & failure : report.failures)
+    {
+        writer.begin_object().member("operation", failure.cut.operations);
+        if (failure.cut.operations < workload.writes.size())
+        {
+            auto const & write = workload.writes[failure.cut.operations];
+            writer.member("next", operation_name(write.kind))
+                .member("block", write.block)
+                .member("offset", write.offset);
+        }
+        writer.member("torn_bytes", failure.cut.torn_bytes)
+            .member("mounted", failure.report.mounted)
+            .key("issues")
+            .begin_array();
+        for (auto const & issue : failure.report.issues)
+        {
+            writer.begin_object().member("kind", issue_kind_name(issue.kind));
+            if (!issue.path.empty())
+            {
+                writer.member("path", issue.path);
+            }
+            if (issue.block)
+            {
+                writer.member("block", *issue.block);
+            }
+            writer.member("message", issue.message).end_object();
+        }
+        writer.end_array().end_object();
+    }
+    writer.end_array().member("passed", 0 == report.failed_states).end_object();
+
+    stream << "\n";
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    MemoryBlockDevice base(options->block_size, options->block_count);
+
+    Workload workload {};
+    switch (options->version)
+    {
+    case 1:
+        workload = record_workload<LittleFS1>(base, *options);
+        break;
+
+    case 2:
+        workload = record_workload<LittleFS2>(base, *options);
+        break;
+
+    default:
+        throw std::runtime_error("Invalid littlefs version specified");
+    }
+
+    auto const mount = [&options](std::unique_ptr<IBlockDevice> block_device) {
+        return open_filesystem(
+            options->version, std::move(block_device), options->read_size, options->prog_size);
+    };
+
+    PowerLossFailureSink save_failure {};
+    if (options->failure_directory)
+    {
+        boost::filesystem::create_directories(*options->failure_directory);
+        save_failure = [&options](CutPoint const & cut,
+                                  gsl::span<std::byte const> const image,
+                                  CheckReport const &) {
+            auto const path = fmt::format("{}/cut-{:08}-{:05}.img",
+                                          *options->failure_directory,
+                                          cut.operations,
+                                          cut.torn_bytes);
+            CFile output(path, "wb");
+            if (output.write(image) != static_cast<std::size_t>(image.size()))
+            {
+                throw std::runtime_error(fmt::format("Failed writing {}", path));
+            }
+        };
+    }
+
+    PowerLossOptions power_loss_options {};
+    power_loss_options.check.littlefs_version = options->version;
+    power_loss_options.check.read_data = options->read_data;
+    power_loss_options.thread_count = options->jobs;
+    power_loss_options.torn_granularity = options->torn_granularity;
+    power_loss_options.max_failures = options->max_failures;
+
+    auto const start = std::chrono::steady_clock::now();
+    auto const report = check_power_loss(base.data(),
+                                         options->block_size,
+                                         workload.writes,
+                                         mount,
+                                         power_loss_options,
+                                         save_failure);
+    auto const seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (options->report_file_path == "-")
+    {
+        write_report(*options, workload, report, seconds, std::cout);
+    }
+    else
+    {
+        std::ofstream report_file(options->report_file_path);
+        report_file.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+        write_report(*options, workload, report, seconds, report_file);
+
+        std::cout << fmt::format("{} states checked in {:.2f} s, {} failed\n",
+                                 report.states,
+                                 seconds,
+                                 report.failed_states);
+    }
+
+    return 0 == report.failed_states ? 0 : CHECK_FAILED;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockProtocol.hpp>
+#include <BlockServer.hpp>
+#include <FileBlockDevice.hpp>
+#include <ImageFile.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_serve_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::string image_file_path;
+    std::string endpoint;
+    bool read_only;
+    bool once;
+};
+
+
+namespace po = boost::program_options;
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_SERVE_DEFAULT_BLOCK_SIZE), "block size")
+        ("block-count,c", po::value<std::uint32_t>(), "block count")
+        ("image-file,i", po::value<std::string>()->required(), "image file or device to serve")
+        ("listen,L", po::value<std::string>()->required(), "endpoint to listen on: unix:PATH or tcp:HOST:PORT")
+        ("read-only", "refuse programs and erases")
+        ("once", "exit when the first client disconnects")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i IMAGE_FILE -L ENDPOINT [-b BLOCK_SIZE] [-c BLOCK_COUNT] "
+                        "[--read-only] [--once]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-serve {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.image_file_path = vm["image-file"].as<std::string>();
+    options.endpoint = vm["listen"].as<std::string>();
+    options.read_only = (0 != vm.count("read-only"));
+    options.once = (0 != vm.count("once"));
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    return options;
+}
+
+std::unique_ptr<FileBlockDevice> open_image(CommandLineOptions & options)
+{
+    options.block_count =
+        image_block_count(options.image_file_path, options.block_size, options.block_count);
+
+    return std::make_unique<FileBlockDevice>(options.image_file_path,
+                                             !options.read_only,
+                                             options.block_size,
+                                             options.block_count.value());
+}
+
+// Clients are served one at a time, since they share the image. A client that
+// breaks the protocol is dropped, and the server goes on with the next one.
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    auto const image = open_image(*options);
+
+    boost::asio::io_context context {};
+    auto acceptor = block_protocol::listen(context, options->endpoint);
+
+    for (;;)
+    {
+        block_protocol::Socket socket(context);
+        acceptor.accept(socket);
+
+        try
+        {
+            serve_block_device(socket, *image, options->read_only);
+            image->sync();
+        }
+        catch (std::exception const & exception)
+        {
+            std::cerr << fmt::format("Client dropped: {}\n", exception.what());
+        }
+
+        if (options->once)
+        {
+            return 0;
+        }
+    }
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
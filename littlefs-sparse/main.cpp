@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <BlockDeviceView.hpp>
+#include <CFile.hpp>
+#include <FileBlockDevice.hpp>
+#include <ImageFile.hpp>
+#include <MemoryBlockDevice.hpp>
+#include <SparseImage.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_sparse_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string input_file_path;
+    std::string output_file_path;
+    SparseFormat format;
+    bool import;
+};
+
+
+namespace po = boost::program_options;
+
+
+static constexpr std::size_t IMPORT_BUFFER_SIZE = 1024 * 1024;
+
+
+SparseFormat parse_format(std::string const & name)
+{
+    if (name == "holes")
+    {
+        return SparseFormat::Holes;
+    }
+    if (name == "extents")
+    {
+        return SparseFormat::Extents;
+    }
+    if (name == "android")
+    {
+        return SparseFormat::Android;
+    }
+    throw std::invalid_argument(fmt::format("Unknown sparse format: {}", name));
+}
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_SPARSE_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_SPARSE_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_SPARSE_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_SPARSE_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("input-file,i", po::value<std::string>()->required(), "littlefs image file, or sparse image with --import; - for standard input")
+        ("output-file,o", po::value<std::string>()->required(), "sparse image, or littlefs image with --import; - for standard output")
+        ("format,f", po::value<std::string>()->default_value("extents"), "sparse format: holes, extents or android")
+        ("import", "rebuild the full image from an extent or Android sparse image")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i INPUT_FILE -o OUTPUT_FILE [-f FORMAT] [-l LITTLEFS_VERSION] "
+                        "[-b BLOCK_SIZE] [-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE]\n"
+                        "       {} --import -i INPUT_FILE -o OUTPUT_FILE\n",
+                        executable,
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-sparse {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.input_file_path = vm["input-file"].as<std::string>();
+    options.output_file_path = vm["output-file"].as<std::string>();
+    options.format = parse_format(vm["format"].as<std::string>());
+    options.import = (0 != vm.count("import"));
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    if (!options.import && options.input_file_path == "-")
+    {
+        throw std::invalid_argument("Images to export must be files");
+    }
+    if (!options.import && SparseFormat::Holes == options.format
+        && options.output_file_path == "-")
+    {
+        throw std::invalid_argument("Sparse files cannot be written to standard output");
+    }
+
+    return options;
+}
+
+std::unique_ptr<FileBlockDevice> open_image(CommandLineOptions & options)
+{
+    options.block_count =
+        image_block_count(options.input_file_path, options.block_size, options.block_count);
+
+    return std::make_unique<FileBlockDevice>(options.input_file_path,
+                                             false,
+                                             options.block_size,
+                                             options.block_count.value());
+}
+
+CFile open_output(std::string const & path)
+{
+    return path == "-" ? CFile::standard_output() : CFile(path, "wb");
+}
+
+// Only the blocks littlefs reaches are read from the image, so the export
+// takes time in proportion to the space in use
+void export_image(CommandLineOptions & options)
+{
+    auto const image = open_image(options);
+    auto const extents = [&options, &image]() {
+        auto filesystem = open_filesystem(options.version,
+                                          std::make_unique<BlockDeviceView>(*image),
+                                          options.read_size,
+                                          options.prog_size);
+        return used_extents(*filesystem, image->block_count());
+    }();
+
+    switch (options.format)
+    {
+    case SparseFormat::Holes:
+        write_sparse_file(*image, extents, options.output_file_path);
+        break;
+
+    case SparseFormat::Extents:
+    {
+        auto output_file = open_output(options.output_file_path);
+        write_extent_image(*image, extents, output_file);
+        break;
+    }
+
+    case SparseFormat::Android:
+    {
+        auto output_file = open_output(options.output_file_path);
+        write_android_sparse_image(*image, extents, output_file);
+        break;
+    }
+    }
+
+    auto & report = options.output_file_path == "-" ? std::cerr : std::cout;
+    report << fmt::format("{} of {} blocks in use, in {} extents\n",
+                          extent_blocks(extents),
+                          image->block_count(),
+                          extents.size());
+}
+
+// Blocks the sparse image does not hold come out erased. The output is written
+// in one pass, so it may go to a pipe.
+void import_image(CommandLineOptions const & options)
+{
+    auto input_file = options.input_file_path == "-" ? CFile::standard_input()
+                                                     : CFile(options.input_file_path, "rb");
+    SparseImageReader reader(input_file);
+    auto output_file = open_output(options.output_file_path);
+
+    auto const block_size = reader.block_size();
+    std::vector<std::byte> const erased(block_size, MemoryBlockDevice::ERASED_VALUE);
+
+    auto const write = [&output_file](gsl::span<std::byte const> const data) {
+        if (output_file.write(data) != static_cast<std::size_t>(data.size()))
+        {
+            throw std::runtime_error("Failed writing image");
+        }
+    };
+
+    std::uint32_t next = 0;
+    auto const erase_until = [&](std::uint32_t const block) {
+        for (; next < block; ++next)
+        {
+            write(erased);
+        }
+    };
+
+    reader.read(
+        [&](std::uint32_t const first, gsl::span<std::byte const> const data) {
+            erase_until(first);
+            write(data);
+            next += static_cast<std::uint32_t>(static_cast<std::size_t>(data.size()) / block_size);
+        },
+        IMPORT_BUFFER_SIZE);
+    erase_until(reader.block_count());
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    if (options->import)
+    {
+        import_image(*options);
+    }
+    else
+    {
+        export_image(*options);
+    }
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
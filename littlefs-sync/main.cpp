@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <gsl/gsl>
+
+#include <FileBlockDevice.hpp>
+#include <HostDirectory.hpp>
+#include <ImageFile.hpp>
+#include <ImagePacker.hpp>
+#include <MappedFile.hpp>
+#include <MemoryInputStream.hpp>
+
+#if defined(_MSC_VER)
+    #include <Unicode.hpp>
+#endif
+
+#include <littlefs_sync_config.h>
+#include <littlefs_utils_config.h>
+
+
+struct CommandLineOptions
+{
+    std::uint32_t version;
+    std::uint32_t block_size;
+    std::optional<std::uint32_t> block_count;
+    std::uint32_t read_size;
+    std::uint32_t prog_size;
+    std::string image_file_path;
+    std::string source_directory;
+    bool dry_run;
+    bool verbose;
+};
+
+
+namespace po = boost::program_options;
+
+
+namespace {
+
+constexpr std::size_t COMPARE_BUFFER_SIZE = 64 * 1024;
+
+struct ImageEntry
+{
+    bool is_directory {};
+    std::uint32_t size {};
+};
+
+// Changes that turn the image's tree into the host's, in the order they are applied
+struct SyncPlan
+{
+    // Deepest first, so that directories are empty when they are removed
+    std::vector<std::string> removals {};
+    std::vector<HostEntry> directories {};
+    std::vector<HostEntry> writes {};
+    std::uint64_t write_bytes {};
+    std::uint64_t unchanged_files {};
+};
+
+}  // namespace
+
+
+std::optional<CommandLineOptions> parse_command_line(std::string const & executable,
+                                                     std::vector<std::string> const & args)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("version,v", "show version")
+        ("littlefs-version,l", po::value<std::uint32_t>()->default_value(LITTLEFS_SYNC_DEFAULT_VERSION), "littlefs version to use")
+        ("block-size,b", po::value<std::uint32_t>()->default_value(LITTLEFS_SYNC_DEFAULT_BLOCK_SIZE), "filesystem block size")
+        ("block-count,c", po::value<std::uint32_t>(), "filesystem block count")
+        ("read-size,r", po::value<std::uint32_t>()->default_value(LITTLEFS_SYNC_DEFAULT_READ_SIZE), "filesystem read size")
+        ("prog-size,p", po::value<std::uint32_t>()->default_value(LITTLEFS_SYNC_DEFAULT_PROG_SIZE), "filesystem prog size")
+        ("image-file,i", po::value<std::string>()->required(), "littlefs image file to update in place")
+        ("source,s", po::value<std::string>()->required(), "host directory the image should mirror")
+        ("dry-run,n", "print the planned changes without writing them")
+        ("verbose", "also print the changes when writing them")
+    ;
+
+    po::variables_map vm {};
+    po::store(po::basic_command_line_parser(args).options(desc).run(), vm);
+
+    if (args.empty() || 0 != vm.count("help"))
+    {
+        auto const & usage =
+            fmt::format("Usage: {} -i IMAGE_FILE -s SOURCE [-l LITTLEFS_VERSION] [-b BLOCK_SIZE] "
+                        "[-c BLOCK_COUNT] [-r READ_SIZE] [-p PROG_SIZE] [-n] [--verbose]\n",
+                        executable);
+
+#if _MSC_VER
+        std::wcout << utf8_to_wide_char(usage);
+#else
+        std::cout << usage;
+#endif
+
+        std::cout << desc << "\n";
+        return {};
+    }
+    if (0 != vm.count("version"))
+    {
+        std::cout << fmt::format("littlefs-sync {}\n", LITTLEFS_UTILS_VERSION);
+        return {};
+    }
+
+    po::notify(vm);
+
+    CommandLineOptions options {};
+
+    options.version = vm["littlefs-version"].as<std::uint32_t>();
+    options.block_size = vm["block-size"].as<std::uint32_t>();
+    options.read_size = vm["read-size"].as<std::uint32_t>();
+    options.prog_size = vm["prog-size"].as<std::uint32_t>();
+    options.image_file_path = vm["image-file"].as<std::string>();
+    options.source_directory = vm["source"].as<std::string>();
+    options.dry_run = (0 != vm.count("dry-run"));
+    options.verbose = (0 != vm.count("verbose"));
+
+    if (0 != vm.count("block-count"))
+    {
+        options.block_count = vm["block-count"].as<std::uint32_t>();
+    }
+
+    if (!is_host_directory(options.source_directory))
+    {
+        throw std::runtime_error(fmt::format("{} is not a directory", options.source_directory));
+    }
+
+    return options;
+}
+
+// The image is updated in place, so only the blocks littlefs rewrites are
+// read and written. A dry run opens it read-only.
+std::unique_ptr<FileBlockDevice> open_image(CommandLineOptions & options)
+{
+    options.block_count =
+        image_block_count(options.image_file_path, options.block_size, options.block_count);
+
+    return std::make_unique<FileBlockDevice>(options.image_file_path,
+                                             !options.dry_run,
+                                             options.block_size,
+                                             options.block_count.value());
+}
+
+// Stops at the first difference, so changed files usually cost a single read
+bool same_contents(LittleFS & filesystem, std::string const & path, std::string const & host_path)
+{
+    MappedFile const host_file(host_path);
+    auto remaining = host_file.data();
+
+    auto const file = filesystem.open_file(path, LittleFS::OpenFlags::Read);
+    std::vector<std::byte> buffer(COMPARE_BUFFER_SIZE);
+    for (;;)
+    {
+        auto const count = file->read(buffer);
+        if (0 == count)
+        {
+            return remaining.empty();
+        }
+
+        if (count > static_cast<std::size_t>(remaining.size())
+            || !std::equal(buffer.cbegin(),
+                           buffer.cbegin() + static_cast<std::ptrdiff_t>(count),
+                           remaining.cbegin()))
+        {
+            return false;
+        }
+        remaining = remaining.subspan(static_cast<std::ptrdiff_t>(count));
+    }
+}
+
+SyncPlan plan_sync(LittleFS & filesystem, std::vector<HostEntry> const & host_entries)
+{
+    std::unordered_map<std::string, ImageEntry> image_entries {};
+
+    auto const tree = filesystem.file_tree("/");
+    auto const nodes = tree.nodes();
+    std::string path {};
+    for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(nodes.size()); ++index)
+    {
+        image_entries.emplace(tree.path(index, path),
+                              ImageEntry {0 != nodes[index].is_directory, nodes[index].size});
+    }
+
+    SyncPlan plan {};
+    for (auto const & entry : host_entries)
+    {
+        auto const image_path = ImagePacker::normalize_path(entry.path);
+        auto const image_entry = image_entries.find(image_path);
+
+        auto const exists = image_entry != image_entries.cend()
+                            && image_entry->second.is_directory == entry.is_directory;
+        if (exists)
+        {
+            // Whatever is left in the map at the end is removed
+            auto const image_size = image_entry->second.size;
+            image_entries.erase(image_entry);
+
+            if (entry.is_directory)
+            {
+                continue;
+            }
+            if (image_size == entry.size && same_contents(filesystem, image_path, entry.host_path))
+            {
+                ++plan.unchanged_files;
+                continue;
+            }
+        }
+
+        if (entry.is_directory)
+        {
+            plan.directories.push_back(entry);
+        }
+        else
+        {
+            plan.writes.push_back(entry);
+            plan.write_bytes += entry.size;
+        }
+    }
+
+    for (auto const & [image_path, image_entry] : image_entries)
+    {
+        plan.removals.push_back(image_path);
+    }
+    // Contents sort after their directory
+    std::sort(plan.removals.rbegin(), plan.removals.rend());
+
+    return plan;
+}
+
+void print_plan(SyncPlan const & plan)
+{
+    for (auto const & path : plan.removals)
+    {
+        std::cout << fmt::format("remove {}\n", path);
+    }
+    for (auto const & entry : plan.directories)
+    {
+        std::cout << fmt::format("create {}/\n", ImagePacker::normalize_path(entry.path));
+    }
+    for (auto const & entry : plan.writes)
+    {
+        std::cout << fmt::format(
+            "write {} ({} bytes)\n", ImagePacker::normalize_path(entry.path), entry.size);
+    }
+}
+
+// The packer closes every file explicitly, so a write whose final commit
+// fails stops the sync. The image is updated in place, so the error says how
+// far it got.
+void apply_plan(CommandLineOptions const & options, LittleFS & filesystem, SyncPlan const & plan)
+{
+    // Removals come first, to free the space the writes may need
+    for (auto const & path : plan.removals)
+    {
+        filesystem.remove(path);
+    }
+
+    ImagePacker packer(filesystem, {options.block_size, options.block_count.value(), 0, 0});
+    for (auto const & entry : plan.directories)
+    {
+        packer.add_directory(entry.path);
+    }
+
+    std::size_t written = 0;
+    try
+    {
+        for (auto const & entry : plan.writes)
+        {
+            MappedFile const contents(entry.host_path);
+            MemoryInputStream stream(contents.data());
+            packer.add_file(entry.path, stream);
+            ++written;
+        }
+    }
+    catch (std::exception const & error)
+    {
+        throw std::runtime_error(fmt::format("Sync stopped after writing {} of {} files: {}",
+                                             written,
+                                             plan.writes.size(),
+                                             error.what()));
+    }
+}
+
+int entry_point(std::string const & executable, std::vector<std::string> const & args)
+{
+    auto options = parse_command_line(executable, args);
+    if (!options)
+    {
+        return 1;
+    }
+
+    auto const host_entries = list_host_directory(options->source_directory);
+    auto const filesystem = open_filesystem(
+        options->version, open_image(*options), options->read_size, options->prog_size);
+
+    auto const plan = plan_sync(*filesystem, host_entries);
+
+    if (options->dry_run || options->verbose)
+    {
+        print_plan(plan);
+    }
+    if (!options->dry_run)
+    {
+        apply_plan(*options, *filesystem, plan);
+    }
+
+    std::cout << fmt::format("{} {} files ({} bytes), {} {} entries, {} files unchanged\n",
+                             options->dry_run ? "Would write" : "Wrote",
+                             plan.writes.size(),
+                             plan.write_bytes,
+                             options->dry_run ? "would remove" : "removed",
+                             plan.removals.size(),
+                             plan.unchanged_files);
+
+    return 0;
+}
+
+#if defined(_MSC_VER)
+int wmain(int argc, wchar_t ** argv) noexcept
+#else
+int main(int argc, char ** argv) noexcept
+#endif
+{
+    try
+    {
+#if defined(_MSC_VER)
+        gsl::span<wchar_t *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+
+        std::vector<std::string> arguments {};
+        arguments.reserve(arguments_span.size());
+        std::transform(std::begin(arguments_span),
+                       std::end(arguments_span),
+                       std::back_inserter(arguments),
+                       wide_char_to_utf8);
+
+        std::string const executable(wide_char_to_utf8(argv_span.at(0)));
+#else
+        gsl::span<char *> argv_span(argv, argc);
+
+        auto const arguments_span = argv_span.subspan(1);
+        std::vector<std::string> const arguments(arguments_span.cbegin(), arguments_span.cend());
+
+        std::string const executable(argv_span.at(0));
+#endif
+
+        return entry_point(executable, arguments);
+    }
+    catch (std::exception const & exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return -1;
+    }
+}
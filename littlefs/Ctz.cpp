@@ -0,0 +1,109 @@
+#include "Ctz.hpp"
+
+#include <bitset>
+#include <cstddef>
+#include <stdexcept>
+
+
+namespace {
+
+constexpr std::uint32_t POINTER_SIZE = sizeof(std::uint32_t);
+
+std::uint32_t popcount(std::uint32_t const value) noexcept
+{
+    return static_cast<std::uint32_t>(std::bitset<32>(value).count());
+}
+
+std::uint32_t count_trailing_zeros(std::uint32_t value) noexcept
+{
+    std::uint32_t count = 0;
+    while (0 == (value & 1U) && count < 32)
+    {
+        value >>= 1U;
+        ++count;
+    }
+    return count;
+}
+
+std::uint32_t read_pointer(IBlockDevice & block_device, std::uint32_t const block)
+{
+    if (block >= block_device.block_count())
+    {
+        throw std::range_error("CTZ pointer out of range");
+    }
+
+    std::byte raw[POINTER_SIZE] {};
+    block_device.read(block, 0, raw, POINTER_SIZE);
+
+    return static_cast<std::uint32_t>(raw[0]) | (static_cast<std::uint32_t>(raw[1]) << 8U)
+           | (static_cast<std::uint32_t>(raw[2]) << 16U)
+           | (static_cast<std::uint32_t>(raw[3]) << 24U);
+}
+
+}  // namespace
+
+
+std::uint32_t ctz_index(std::uint32_t const block_size, std::uint32_t & offset) noexcept
+{
+    auto const size = offset;
+    auto const data_per_block = block_size - 2 * POINTER_SIZE;
+
+    auto index = size / data_per_block;
+    if (0 == index)
+    {
+        return 0;
+    }
+
+    index = (size - POINTER_SIZE * (popcount(index - 1) + 2)) / data_per_block;
+    offset = size - data_per_block * index - POINTER_SIZE * popcount(index);
+    return index;
+}
+
+std::uint32_t ctz_block_count(std::uint32_t const block_size, std::uint32_t const size) noexcept
+{
+    if (0 == size)
+    {
+        return 0;
+    }
+
+    auto last_offset = size - 1;
+    return ctz_index(block_size, last_offset) + 1;
+}
+
+std::uint32_t ctz_data_offset(std::uint32_t const index) noexcept
+{
+    if (0 == index)
+    {
+        return 0;
+    }
+
+    return POINTER_SIZE * (count_trailing_zeros(index) + 1);
+}
+
+std::vector<std::uint32_t>
+    ctz_blocks(IBlockDevice & block_device, std::uint32_t head, std::uint32_t const size)
+{
+    if (0 == size)
+    {
+        return {};
+    }
+
+    auto last_offset = size - 1;
+    auto index = ctz_index(block_device.block_size(), last_offset);
+
+    std::vector<std::uint32_t> blocks(static_cast<std::size_t>(index) + 1);
+    blocks[index] = head;
+    while (index > 0)
+    {
+        head = read_pointer(block_device, head);
+        --index;
+        blocks[index] = head;
+    }
+
+    if (head >= block_device.block_count())
+    {
+        throw std::range_error("CTZ pointer out of range");
+    }
+
+    return blocks;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "IBlockDevice.hpp"
+
+
+// Helpers for the CTZ skip-lists that hold file data. The layout is shared by
+// littlefs v1 and v2: block N of a file starts with ctz(N) + 1 little-endian
+// pointers, the first of which points at block N - 1.
+
+// Translates a file offset into the index of the block holding it, replacing
+// the offset with the position inside that block.
+[[nodiscard]] std::uint32_t ctz_index(std::uint32_t block_size, std::uint32_t & offset) noexcept;
+
+// Number of blocks in the skip-list of a file with the given size.
+[[nodiscard]] std::uint32_t ctz_block_count(std::uint32_t block_size, std::uint32_t size) noexcept;
+
+// Offset at which file data starts inside the block with the given index.
+[[nodiscard]] std::uint32_t ctz_data_offset(std::uint32_t index) noexcept;
+
+// Lists the blocks of a skip-list in file order by following the back pointers
+// from its head.
+[[nodiscard]] std::vector<std::uint32_t>
+    ctz_blocks(IBlockDevice & block_device, std::uint32_t head, std::uint32_t size);
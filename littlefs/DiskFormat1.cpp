@@ -0,0 +1,59 @@
+#include "DiskFormat1.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include <lfs1_util.h>
+
+
+namespace {
+
+constexpr std::size_t DIRECTORY_HEADER_SIZE = 4 * sizeof(std::uint32_t);
+constexpr std::uint32_t DIRECTORY_SIZE_MASK = 0x7fffffff;
+
+std::uint32_t read_le32(gsl::span<std::byte const> const data, std::size_t const offset) noexcept
+{
+    std::uint32_t value = 0;
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return lfs1_fromle32(value);
+}
+
+}  // namespace
+
+
+bool is_metadata_block1(gsl::span<std::byte const> const block) noexcept
+{
+    auto const block_size = static_cast<std::size_t>(block.size());
+    if (block_size < DIRECTORY_HEADER_SIZE + sizeof(std::uint32_t))
+    {
+        return false;
+    }
+
+    auto const directory_size =
+        static_cast<std::size_t>(read_le32(block, sizeof(std::uint32_t)) & DIRECTORY_SIZE_MASK);
+    if (directory_size < DIRECTORY_HEADER_SIZE + sizeof(std::uint32_t)
+        || directory_size > block_size)
+    {
+        return false;
+    }
+
+    // The stored CRC is included, so an intact directory sums to zero.
+    std::uint32_t crc = 0xffffffff;
+    lfs1_crc(&crc, block.data(), directory_size);
+
+    return 0 == crc;
+}
+
+MetadataLog read_metadata_log1(gsl::span<std::byte const> const block) noexcept
+{
+    if (!is_metadata_block1(block))
+    {
+        return {};
+    }
+
+    MetadataLog log {};
+    log.revision = read_le32(block, 0);
+    log.commits = 1;
+    log.size = read_le32(block, sizeof(std::uint32_t)) & DIRECTORY_SIZE_MASK;
+    return log;
+}
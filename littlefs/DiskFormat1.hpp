@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+#include <gsl/gsl>
+
+#include "MetadataLog.hpp"
+
+
+// Checks whether a raw block holds a littlefs v1 directory block with a valid CRC.
+[[nodiscard]] bool is_metadata_block1(gsl::span<std::byte const> block) noexcept;
+
+// A littlefs v1 directory block holds a single commit, rewritten as a whole on
+// every change.
+[[nodiscard]] MetadataLog read_metadata_log1(gsl::span<std::byte const> block) noexcept;
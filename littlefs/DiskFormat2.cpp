@@ -0,0 +1,107 @@
+#include "DiskFormat2.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include <lfs2_util.h>
+
+
+namespace {
+
+constexpr std::uint32_t TAG_INVALID = 0x80000000;
+constexpr std::uint32_t TAG_TYPE1_MASK = 0x70000000;
+constexpr std::uint32_t TAG_TYPE_CRC = 0x500;
+constexpr std::uint32_t TAG_SIZE_MASK = 0x3ff;
+
+std::uint32_t read_le32(gsl::span<std::byte const> const data, std::size_t const offset) noexcept
+{
+    std::uint32_t value = 0;
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return lfs2_fromle32(value);
+}
+
+std::uint32_t tag_type1(std::uint32_t const tag) noexcept
+{
+    return (tag & TAG_TYPE1_MASK) >> 20U;
+}
+
+std::uint32_t tag_chunk_lsb(std::uint32_t const tag) noexcept
+{
+    return (tag >> 20U) & 1U;
+}
+
+std::size_t tag_disk_size(std::uint32_t const tag) noexcept
+{
+    // A size of 0x3ff marks a deleted tag, which carries no data
+    auto const size = tag & TAG_SIZE_MASK;
+    return sizeof(tag) + ((TAG_SIZE_MASK == size) ? 0 : size);
+}
+
+}  // namespace
+
+
+bool is_metadata_block2(gsl::span<std::byte const> const block) noexcept
+{
+    return read_metadata_log2(block).commits > 0;
+}
+
+MetadataLog read_metadata_log2(gsl::span<std::byte const> const block) noexcept
+{
+    auto const block_size = static_cast<std::size_t>(block.size());
+    if (block_size < 4 * sizeof(std::uint32_t))
+    {
+        return {};
+    }
+
+    MetadataLog log {};
+    log.revision = read_le32(block, 0);
+
+    // The revision count is covered by the first commit's CRC
+    auto crc = lfs2_crc(0xffffffff, block.data(), sizeof(std::uint32_t));
+
+    std::uint32_t previous_tag = 0xffffffff;
+    std::size_t offset = sizeof(std::uint32_t);
+    while (offset + sizeof(std::uint32_t) <= block_size)
+    {
+        std::uint32_t raw_tag = 0;
+        std::memcpy(&raw_tag, block.data() + offset, sizeof(raw_tag));
+        crc = lfs2_crc(crc, &raw_tag, sizeof(raw_tag));
+
+        auto const tag = lfs2_frombe32(raw_tag) ^ previous_tag;
+        if (0 != (tag & TAG_INVALID))
+        {
+            break;
+        }
+
+        auto const disk_size = tag_disk_size(tag);
+        if (offset + disk_size > block_size)
+        {
+            break;
+        }
+
+        if (TAG_TYPE_CRC == tag_type1(tag))
+        {
+            if (disk_size < 2 * sizeof(std::uint32_t)
+                || crc != read_le32(block, offset + sizeof(std::uint32_t)))
+            {
+                break;
+            }
+
+            // Each commit starts a new CRC, and the CRC tag's low type bit
+            // flips the valid bit expected of the next commit's first tag
+            offset += disk_size;
+            ++log.commits;
+            log.size = static_cast<std::uint32_t>(offset);
+            previous_tag = tag ^ (tag_chunk_lsb(tag) << 31U);
+            crc = 0xffffffff;
+            continue;
+        }
+
+        crc = lfs2_crc(crc, block.data() + offset + sizeof(std::uint32_t), disk_size - sizeof(tag));
+
+        previous_tag = tag;
+        offset += disk_size;
+    }
+
+    return log;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+#include <gsl/gsl>
+
+#include "MetadataLog.hpp"
+
+
+// Checks whether a raw block holds a littlefs v2 metadata block whose
+// first commit has a valid CRC.
+[[nodiscard]] bool is_metadata_block2(gsl::span<std::byte const> block) noexcept;
+
+// Follows the log of commits in a raw littlefs v2 metadata block for as long as
+// their CRCs are valid.
+[[nodiscard]] MetadataLog read_metadata_log2(gsl::span<std::byte const> block) noexcept;
@@ -0,0 +1,52 @@
+#include "FileTree.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+
+std::uint32_t FileTree::add(std::uint32_t const parent,
+                            std::string_view const name,
+                            bool const is_directory,
+                            std::uint32_t const size)
+{
+    if (parent != NO_PARENT && parent >= _nodes.size())
+    {
+        throw std::out_of_range("Invalid parent node");
+    }
+
+    if (name.size() > std::numeric_limits<std::uint16_t>::max()
+        || _names.size() + name.size() > std::numeric_limits<std::uint32_t>::max()
+        || _nodes.size() >= NO_PARENT)
+    {
+        throw std::length_error("File tree too large");
+    }
+
+    _nodes.push_back({parent,
+                      static_cast<std::uint32_t>(_names.size()),
+                      static_cast<std::uint16_t>(name.size()),
+                      static_cast<std::uint16_t>(is_directory ? 1 : 0),
+                      size});
+    _names.append(name);
+
+    return static_cast<std::uint32_t>(_nodes.size() - 1);
+}
+
+std::string const & FileTree::path(std::uint32_t const index, std::string & buffer) const
+{
+    return rebuild_path(
+        index,
+        buffer,
+        [this](std::uint32_t const node) { return _nodes.at(node).parent; },
+        [this](std::uint32_t const node) { return name(_nodes.at(node)); });
+}
+
+std::size_t FileTree::memory_usage() const noexcept
+{
+    return sizeof(*this) + _nodes.capacity() * sizeof(Node) + _names.capacity();
+}
+
+void FileTree::shrink_to_fit()
+{
+    _nodes.shrink_to_fit();
+    _names.shrink_to_fit();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/gsl>
+
+
+// A directory tree stored as a flat array of nodes. Each node refers to its
+// parent by index and to its name by a slice of a single shared string arena.
+// Full paths are only materialized on demand, into a caller-provided buffer.
+class FileTree
+{
+public:
+    struct Node
+    {
+        std::uint32_t parent;
+        std::uint32_t name_offset;
+        std::uint16_t name_size;
+        std::uint16_t is_directory;
+        std::uint32_t size;
+    };
+
+    static constexpr std::uint32_t NO_PARENT = 0xffffffff;
+
+private:
+    std::vector<Node> _nodes;
+    std::string _names;
+
+public:
+    // Parents must be added before their children
+    std::uint32_t
+        add(std::uint32_t parent, std::string_view name, bool is_directory, std::uint32_t size);
+
+    [[nodiscard]] gsl::span<Node const> nodes() const noexcept
+    {
+        return _nodes;
+    }
+
+    [[nodiscard]] std::string_view name(Node const & node) const noexcept
+    {
+        return std::string_view(_names).substr(node.name_offset, node.name_size);
+    }
+
+    // Rebuilds the absolute path of a node into `buffer`, reusing its storage.
+    std::string const & path(std::uint32_t index, std::string & buffer) const;
+
+    [[nodiscard]] std::size_t memory_usage() const noexcept;
+
+    void shrink_to_fit();
+};
+
+// Rebuilds the absolute path of node `index` of a flat tree into `buffer`,
+// reusing its storage. `parent` and `name` look up a node by index, so that
+// other parent-indexed trees can share this with FileTree.
+template <typename Parent, typename Name>
+std::string const & rebuild_path(std::uint32_t index,
+                                 std::string & buffer,
+                                 Parent const & parent,
+                                 Name const & name)
+{
+    buffer.clear();
+
+    // Collect the components leaf-first, then reverse them in place
+    while (FileTree::NO_PARENT != index)
+    {
+        std::string_view const component = name(index);
+
+        buffer.append(component.crbegin(), component.crend());
+        buffer.push_back('/');
+
+        index = parent(index);
+    }
+    std::reverse(buffer.begin(), buffer.end());
+
+    return buffer;
+}
@@ -1,8 +1,19 @@
 #include "LittleFS.hpp"
 
+#include <algorithm>
+#include <exception>
 #include <utility>
 
 
+void LittleFS::read_directory(std::string const & path,
+                              std::function<void(DirectoryEntry const &)> const & callback)
+{
+    for (auto const & entry : list_directory(path))
+    {
+        callback(entry);
+    }
+}
+
 std::vector<LittleFS::FileInfo> LittleFS::recursive_dirlist(std::string const & path)
 {
     std::vector<FileInfo> result {};
@@ -35,3 +46,71 @@ std::vector<LittleFS::FileInfo> LittleFS::recursive_dirlist(std::string const &
 
     return result;
 }
+
+FileTree LittleFS::file_tree(std::string const & path, WalkErrorHandler const & on_error)
+{
+    FileTree tree {};
+
+    auto const root = path == "/" ? std::string() : path;
+    std::string current_path {};
+
+    std::vector<std::uint32_t> to_visit {FileTree::NO_PARENT};
+    while (!to_visit.empty())
+    {
+        auto const current = to_visit.back();
+        to_visit.pop_back();
+
+        if (FileTree::NO_PARENT == current)
+        {
+            current_path = root;
+        }
+        else
+        {
+            tree.path(current, current_path);
+            current_path.insert(0, root);
+        }
+
+        std::vector<DirectoryEntry> entries {};
+        try
+        {
+            entries = list_directory(current_path);
+        }
+        catch (std::exception const & error)
+        {
+            if (!on_error)
+            {
+                throw;
+            }
+            on_error(current_path, error);
+            continue;
+        }
+
+        for (auto const & entry : entries)
+        {
+            if (entry.name == "." || entry.name == "..")
+            {
+                continue;
+            }
+
+            auto const index = tree.add(current, entry.name, entry.is_directory, entry.size);
+            if (entry.is_directory)
+            {
+                to_visit.push_back(index);
+            }
+        }
+    }
+
+    tree.shrink_to_fit();
+    return tree;
+}
+
+std::uint32_t LittleFS::used_blocks()
+{
+    std::vector<std::uint32_t> blocks {};
+    traverse([&blocks](std::uint32_t const block) { blocks.push_back(block); });
+
+    std::sort(blocks.begin(), blocks.end());
+    auto const end = std::unique(blocks.begin(), blocks.end());
+
+    return static_cast<std::uint32_t>(end - blocks.begin());
+}
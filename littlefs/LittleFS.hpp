@@ -2,6 +2,8 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -9,6 +11,7 @@
 
 #include "IBlockDevice.hpp"
 
+#include "FileTree.hpp"
 #include "LittleFSErrorCategory.hpp"
 #include "LittleFile.hpp"
 
@@ -39,13 +42,41 @@ class LittleFS
         Append = 0x0800,
     };
 
+    using WalkErrorHandler =
+        std::function<void(std::string const & path, std::exception const & error)>;
+
 public:
     virtual ~LittleFS() = default;
 
     virtual std::vector<DirectoryEntry> list_directory(std::string const & path) = 0;
+
+    // Calls `callback` for each entry of a directory as it is read, instead of
+    // collecting them first. The entry is only valid during the call. The
+    // default implementation goes through list_directory.
+    virtual void read_directory(std::string const & path,
+                                std::function<void(DirectoryEntry const &)> const & callback);
+
     virtual std::unique_ptr<LittleFile> open_file(std::string const & path, OpenFlags flags) = 0;
+    virtual void make_directory(std::string const & path) = 0;
+    virtual void remove(std::string const & path) = 0;
+
+    // Calls `callback` for every block in use. A block may be reported more than once.
+    virtual void traverse(std::function<void(std::uint32_t)> const & callback) = 0;
+
+    // Blocks of the metadata pairs holding a directory's entries, two per pair,
+    // in the order the pairs are chained.
+    virtual std::vector<std::uint32_t> directory_blocks(std::string const & path) = 0;
+
+    // Number of distinct blocks in use
+    std::uint32_t used_blocks();
 
     std::vector<FileInfo> recursive_dirlist(std::string const & path);
+
+    // Same walk as recursive_dirlist, but keeps directories too and stores
+    // the result compactly. Paths are relative to `path`. A directory that
+    // cannot be listed ends the walk, unless `on_error` is given: it is then
+    // called with the directory's full path, and the directory is kept empty.
+    FileTree file_tree(std::string const & path, WalkErrorHandler const & on_error = {});
 };
 
 constexpr LittleFS::OpenFlags operator|(LittleFS::OpenFlags const first,
@@ -1,6 +1,8 @@
 #include "LittleFS1.hpp"
 
 #include <cstddef>
+#include <exception>
+#include <functional>
 #include <system_error>
 #include <utility>
 
@@ -50,7 +52,13 @@ LittleFS1::~LittleFS1()
 std::vector<LittleFS::DirectoryEntry> LittleFS1::list_directory(std::string const & path)
 {
     std::vector<LittleFS::DirectoryEntry> output {};
+    read_directory(path, [&output](DirectoryEntry const & entry) { output.push_back(entry); });
+    return output;
+}
 
+void LittleFS1::read_directory(std::string const & path,
+                               std::function<void(DirectoryEntry const &)> const & callback)
+{
     lfs1_dir_t directory {};
     auto result = lfs1_dir_open(&_filesystem, &directory, path.c_str());
     if (result < 0)
@@ -59,6 +67,8 @@ std::vector<LittleFS::DirectoryEntry> LittleFS1::list_directory(std::string cons
     }
     try
     {
+        // Reused, so that its name keeps its storage from one entry to the next
+        DirectoryEntry entry {};
         for (;;)
         {
             lfs1_info info {};
@@ -72,8 +82,10 @@ std::vector<LittleFS::DirectoryEntry> LittleFS1::list_directory(std::string cons
                 break;
             }
 
-            output.push_back(
-                {gsl::span<char>(info.name).data(), info.type == LFS1_TYPE_DIR, info.size});
+            entry.name.assign(gsl::span<char>(info.name).data());
+            entry.is_directory = info.type == LFS1_TYPE_DIR;
+            entry.size = info.size;
+            callback(entry);
         }
     }
     catch (...)
@@ -82,8 +94,6 @@ std::vector<LittleFS::DirectoryEntry> LittleFS1::list_directory(std::string cons
         throw;
     }
     lfs1_dir_close(&_filesystem, &directory);
-
-    return output;
 }
 
 std::unique_ptr<LittleFile> LittleFS1::open_file(std::string const & path,
@@ -92,6 +102,97 @@ std::unique_ptr<LittleFile> LittleFS1::open_file(std::string const & path,
     return std::make_unique<LittleFile1>(_filesystem, path, static_cast<int>(flags));
 }
 
+void LittleFS1::make_directory(std::string const & path)
+{
+    auto const result = lfs1_mkdir(&_filesystem, path.c_str());
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs1_mkdir");
+    }
+}
+
+void LittleFS1::remove(std::string const & path)
+{
+    auto const result = lfs1_remove(&_filesystem, path.c_str());
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs1_remove");
+    }
+}
+
+namespace {
+
+struct TraverseContext
+{
+    std::function<void(std::uint32_t)> const & callback;
+    std::exception_ptr exception;
+};
+
+}  // namespace
+
+void LittleFS1::traverse(std::function<void(std::uint32_t)> const & callback)
+{
+    TraverseContext context {callback, {}};
+
+    auto const result = lfs1_traverse(&_filesystem, &_traverse, &context);
+    if (context.exception)
+    {
+        std::rethrow_exception(context.exception);
+    }
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs1_traverse");
+    }
+}
+
+std::vector<std::uint32_t> LittleFS1::directory_blocks(std::string const & path)
+{
+    std::vector<std::uint32_t> blocks {};
+
+    lfs1_dir_t directory {};
+    auto result = lfs1_dir_open(&_filesystem, &directory, path.c_str());
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs1_dir_open");
+    }
+
+    // Reading moves the directory along its chain of pairs, so note every pair it visits
+    auto const record_pair = [&blocks, &directory]() {
+        if (blocks.empty() || blocks[blocks.size() - 2] != directory.pair[0])
+        {
+            blocks.push_back(directory.pair[0]);
+            blocks.push_back(directory.pair[1]);
+        }
+    };
+
+    try
+    {
+        record_pair();
+        for (;;)
+        {
+            lfs1_info info {};
+            result = lfs1_dir_read(&_filesystem, &directory, &info);
+            if (result < 0)
+            {
+                throw std::system_error(result, littlefs_category(), "lfs1_dir_read");
+            }
+            if (0 == result)
+            {
+                break;
+            }
+            record_pair();
+        }
+    }
+    catch (...)
+    {
+        lfs1_dir_close(&_filesystem, &directory);
+        throw;
+    }
+    lfs1_dir_close(&_filesystem, &directory);
+
+    return blocks;
+}
+
 void LittleFS1::format(IBlockDevice & block_device,
                        lfs1_size_t const read_size,
                        lfs1_size_t const program_size,
@@ -189,3 +290,20 @@ int LittleFS1::_sync(lfs1_config const * config) noexcept
 
     return LFS1_ERR_OK;
 }
+
+int LittleFS1::_traverse(void * context, lfs1_block_t block) noexcept
+{
+    auto * traverse_context = static_cast<TraverseContext *>(context);
+
+    try
+    {
+        traverse_context->callback(block);
+    }
+    catch (...)
+    {
+        traverse_context->exception = std::current_exception();
+        return LFS1_ERR_IO;
+    }
+
+    return LFS1_ERR_OK;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -30,7 +31,13 @@ class LittleFS1 : public LittleFS
     LittleFS1 & operator=(LittleFS1 const &) = delete;
 
     std::vector<LittleFS::DirectoryEntry> list_directory(std::string const & path) override;
+    void read_directory(std::string const & path,
+                        std::function<void(DirectoryEntry const &)> const & callback) override;
     std::unique_ptr<LittleFile> open_file(std::string const & path, OpenFlags flags) override;
+    void make_directory(std::string const & path) override;
+    void remove(std::string const & path) override;
+    void traverse(std::function<void(std::uint32_t)> const & callback) override;
+    std::vector<std::uint32_t> directory_blocks(std::string const & path) override;
 
     static void format(IBlockDevice & block_device,
                        lfs1_size_t read_size,
@@ -53,4 +60,6 @@ class LittleFS1 : public LittleFS
     static int _erase(lfs1_config const * config, lfs1_block_t block) noexcept;
 
     static int _sync(lfs1_config const * config) noexcept;
+
+    static int _traverse(void * context, lfs1_block_t block) noexcept;
 };
@@ -1,6 +1,8 @@
 #include "LittleFS2.hpp"
 
 #include <cstddef>
+#include <exception>
+#include <functional>
 #include <system_error>
 #include <utility>
 
@@ -20,26 +22,18 @@ LittleFS2::LittleFS2(std::unique_ptr<IBlockDevice> block_device,
                      lfs2_size_t const file_max,
                      lfs2_size_t const attr_max) :
     _block_device(std::move(block_device)),
-    _config(),
+    _config(make_config(*_block_device,
+                        read_size,
+                        program_size,
+                        block_cycles,
+                        cache_size,
+                        lookahead_size,
+                        name_max,
+                        file_max,
+                        attr_max)),
     _filesystem(),
     _mounted(false)
 {
-    _config.context = _block_device.get();
-    _config.read = &_read;
-    _config.prog = &_prog;
-    _config.erase = &_erase;
-    _config.sync = &_sync;
-    _config.read_size = read_size;
-    _config.prog_size = program_size;
-    _config.block_size = _block_device->block_size();
-    _config.block_count = _block_device->block_count();
-    _config.block_cycles = block_cycles;
-    _config.cache_size = ((0 == cache_size) ? _config.block_size : cache_size);
-    _config.lookahead_size = lookahead_size;
-    _config.name_max = name_max;
-    _config.file_max = file_max;
-    _config.attr_max = attr_max;
-
     auto const result = lfs2_mount(&_filesystem, &_config);
     if (result < 0)
     {
@@ -60,7 +54,13 @@ LittleFS2::~LittleFS2()
 std::vector<LittleFS::DirectoryEntry> LittleFS2::list_directory(std::string const & path)
 {
     std::vector<LittleFS::DirectoryEntry> output {};
+    read_directory(path, [&output](DirectoryEntry const & entry) { output.push_back(entry); });
+    return output;
+}
 
+void LittleFS2::read_directory(std::string const & path,
+                               std::function<void(DirectoryEntry const &)> const & callback)
+{
     lfs2_dir_t directory {};
     auto result = lfs2_dir_open(&_filesystem, &directory, path.c_str());
     if (result < 0)
@@ -69,6 +69,8 @@ std::vector<LittleFS::DirectoryEntry> LittleFS2::list_directory(std::string cons
     }
     try
     {
+        // Reused, so that its name keeps its storage from one entry to the next
+        DirectoryEntry entry {};
         for (;;)
         {
             lfs2_info info {};
@@ -82,8 +84,10 @@ std::vector<LittleFS::DirectoryEntry> LittleFS2::list_directory(std::string cons
                 break;
             }
 
-            output.push_back(
-                {gsl::span<char>(info.name).data(), info.type == LFS2_TYPE_DIR, info.size});
+            entry.name.assign(gsl::span<char>(info.name).data());
+            entry.is_directory = info.type == LFS2_TYPE_DIR;
+            entry.size = info.size;
+            callback(entry);
         }
     }
     catch (...)
@@ -92,8 +96,6 @@ std::vector<LittleFS::DirectoryEntry> LittleFS2::list_directory(std::string cons
         throw;
     }
     lfs2_dir_close(&_filesystem, &directory);
-
-    return output;
 }
 
 std::unique_ptr<LittleFile> LittleFS2::open_file(std::string const & path,
@@ -102,6 +104,97 @@ std::unique_ptr<LittleFile> LittleFS2::open_file(std::string const & path,
     return std::make_unique<LittleFile2>(_filesystem, path, static_cast<int>(flags));
 }
 
+void LittleFS2::make_directory(std::string const & path)
+{
+    auto const result = lfs2_mkdir(&_filesystem, path.c_str());
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_mkdir");
+    }
+}
+
+void LittleFS2::remove(std::string const & path)
+{
+    auto const result = lfs2_remove(&_filesystem, path.c_str());
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_remove");
+    }
+}
+
+namespace {
+
+struct TraverseContext
+{
+    std::function<void(std::uint32_t)> const & callback;
+    std::exception_ptr exception;
+};
+
+}  // namespace
+
+void LittleFS2::traverse(std::function<void(std::uint32_t)> const & callback)
+{
+    TraverseContext context {callback, {}};
+
+    auto const result = lfs2_fs_traverse(&_filesystem, &_traverse, &context);
+    if (context.exception)
+    {
+        std::rethrow_exception(context.exception);
+    }
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_fs_traverse");
+    }
+}
+
+std::vector<std::uint32_t> LittleFS2::directory_blocks(std::string const & path)
+{
+    std::vector<std::uint32_t> blocks {};
+
+    lfs2_dir_t directory {};
+    auto result = lfs2_dir_open(&_filesystem, &directory, path.c_str());
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_dir_open");
+    }
+
+    // Reading moves the directory along its chain of pairs, so note every pair it visits
+    auto const record_pair = [&blocks, &directory]() {
+        if (blocks.empty() || blocks[blocks.size() - 2] != directory.m.pair[0])
+        {
+            blocks.push_back(directory.m.pair[0]);
+            blocks.push_back(directory.m.pair[1]);
+        }
+    };
+
+    try
+    {
+        record_pair();
+        for (;;)
+        {
+            lfs2_info info {};
+            result = lfs2_dir_read(&_filesystem, &directory, &info);
+            if (result < 0)
+            {
+                throw std::system_error(result, littlefs_category(), "lfs2_dir_read");
+            }
+            if (0 == result)
+            {
+                break;
+            }
+            record_pair();
+        }
+    }
+    catch (...)
+    {
+        lfs2_dir_close(&_filesystem, &directory);
+        throw;
+    }
+    lfs2_dir_close(&_filesystem, &directory);
+
+    return blocks;
+}
+
 void LittleFS2::format(IBlockDevice & block_device,
                        lfs2_size_t const read_size,
                        lfs2_size_t const program_size,
@@ -111,6 +204,66 @@ void LittleFS2::format(IBlockDevice & block_device,
                        lfs2_size_t const name_max,
                        lfs2_size_t const file_max,
                        lfs2_size_t const attr_max)
+{
+    auto const config = make_config(block_device,
+                                    read_size,
+                                    program_size,
+                                    block_cycles,
+                                    cache_size,
+                                    lookahead_size,
+                                    name_max,
+                                    file_max,
+                                    attr_max);
+
+    lfs2_t filesystem {};
+
+    auto const result = lfs2_format(&filesystem, &config);
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_format");
+    }
+}
+
+#if defined(LFS2_MIGRATE)
+void LittleFS2::migrate(IBlockDevice & block_device,
+                        lfs2_size_t const read_size,
+                        lfs2_size_t const program_size,
+                        std::int32_t const block_cycles,
+                        lfs2_size_t const cache_size,
+                        lfs2_size_t const lookahead_size,
+                        lfs2_size_t const name_max,
+                        lfs2_size_t const file_max,
+                        lfs2_size_t const attr_max)
+{
+    auto const config = make_config(block_device,
+                                    read_size,
+                                    program_size,
+                                    block_cycles,
+                                    cache_size,
+                                    lookahead_size,
+                                    name_max,
+                                    file_max,
+                                    attr_max);
+
+    lfs2_t filesystem {};
+
+    auto const result = lfs2_migrate(&filesystem, &config);
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_migrate");
+    }
+}
+#endif
+
+lfs2_config LittleFS2::make_config(IBlockDevice & block_device,
+                                   lfs2_size_t const read_size,
+                                   lfs2_size_t const program_size,
+                                   std::int32_t const block_cycles,
+                                   lfs2_size_t const cache_size,
+                                   lfs2_size_t const lookahead_size,
+                                   lfs2_size_t const name_max,
+                                   lfs2_size_t const file_max,
+                                   lfs2_size_t const attr_max) noexcept
 {
     lfs2_config config {};
     config.context = &block_device;
@@ -129,13 +282,7 @@ void LittleFS2::format(IBlockDevice & block_device,
     config.file_max = file_max;
     config.attr_max = attr_max;
 
-    lfs2_t filesystem {};
-
-    auto const result = lfs2_format(&filesystem, &config);
-    if (result < 0)
-    {
-        throw std::system_error(result, littlefs_category(), "lfs2_format");
-    }
+    return config;
 }
 
 int LittleFS2::_read(lfs2_config const * config,
@@ -209,3 +356,20 @@ int LittleFS2::_sync(lfs2_config const * config) noexcept
 
     return LFS2_ERR_OK;
 }
+
+int LittleFS2::_traverse(void * context, lfs2_block_t block) noexcept
+{
+    auto * traverse_context = static_cast<TraverseContext *>(context);
+
+    try
+    {
+        traverse_context->callback(block);
+    }
+    catch (...)
+    {
+        traverse_context->exception = std::current_exception();
+        return LFS2_ERR_IO;
+    }
+
+    return LFS2_ERR_OK;
+}
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -36,7 +37,13 @@ class LittleFS2 : public LittleFS
     LittleFS2 & operator=(LittleFS2 const &) = delete;
 
     std::vector<LittleFS::DirectoryEntry> list_directory(std::string const & path) override;
+    void read_directory(std::string const & path,
+                        std::function<void(DirectoryEntry const &)> const & callback) override;
     std::unique_ptr<LittleFile> open_file(std::string const & path, OpenFlags flags) override;
+    void make_directory(std::string const & path) override;
+    void remove(std::string const & path) override;
+    void traverse(std::function<void(std::uint32_t)> const & callback) override;
+    std::vector<std::uint32_t> directory_blocks(std::string const & path) override;
 
     static void format(IBlockDevice & block_device,
                        lfs2_size_t read_size,
@@ -48,7 +55,31 @@ class LittleFS2 : public LittleFS
                        lfs2_size_t file_max = LFS2_FILE_MAX,
                        lfs2_size_t attr_max = LFS2_ATTR_MAX);
 
+#if defined(LFS2_MIGRATE)
+    // Converts a littlefs 1 image to littlefs 2 in place. The geometry and
+    // configuration must match the ones the image was formatted with.
+    static void migrate(IBlockDevice & block_device,
+                        lfs2_size_t read_size,
+                        lfs2_size_t program_size,
+                        std::int32_t block_cycles = 100,
+                        lfs2_size_t cache_size = 0,
+                        lfs2_size_t lookahead_size = 128,
+                        lfs2_size_t name_max = LFS2_NAME_MAX,
+                        lfs2_size_t file_max = LFS2_FILE_MAX,
+                        lfs2_size_t attr_max = LFS2_ATTR_MAX);
+#endif
+
 private:
+    static lfs2_config make_config(IBlockDevice & block_device,
+                                   lfs2_size_t read_size,
+                                   lfs2_size_t program_size,
+                                   std::int32_t block_cycles,
+                                   lfs2_size_t cache_size,
+                                   lfs2_size_t lookahead_size,
+                                   lfs2_size_t name_max,
+                                   lfs2_size_t file_max,
+                                   lfs2_size_t attr_max) noexcept;
+
     static int _read(lfs2_config const * config,
                      lfs2_block_t block,
                      lfs2_off_t offset,
@@ -64,4 +95,6 @@ class LittleFS2 : public LittleFS
     static int _erase(lfs2_config const * config, lfs2_block_t block) noexcept;
 
     static int _sync(lfs2_config const * config) noexcept;
+
+    static int _traverse(void * context, lfs2_block_t block) noexcept;
 };
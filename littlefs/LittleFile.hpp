@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include <gsl/gsl>
@@ -8,12 +9,30 @@
 
 class LittleFile
 {
+public:
+    // Where the file's contents live on disk: either inline in its metadata
+    // pair, or in a CTZ skip-list whose last block is `head`.
+    struct Layout
+    {
+        bool is_inline {};
+        std::uint32_t head {};
+        std::uint32_t size {};
+    };
+
 public:
     virtual ~LittleFile() = default;
 
     virtual std::size_t read(gsl::span<std::byte> buffer) = 0;
     virtual std::size_t write(gsl::span<std::byte const> buffer) = 0;
 
+    // Moves the position to `position` bytes from the start of the file
+    virtual void seek(std::size_t position) = 0;
+
+    // Writes out any pending data and closes the file. A file that is not
+    // closed explicitly is closed on destruction, where errors go unreported.
+    virtual void close() = 0;
+
     [[nodiscard]] virtual std::size_t size() const = 0;
     [[nodiscard]] virtual std::size_t position() const = 0;
+    [[nodiscard]] virtual Layout layout() const = 0;
 };
@@ -63,6 +63,37 @@ std::size_t LittleFile1::write(gsl::span<std::byte const> buffer)
     return static_cast<std::size_t>(read);
 }
 
+void LittleFile1::seek(std::size_t const position)
+{
+    if (position > static_cast<std::size_t>(std::numeric_limits<lfs1_soff_t>::max()))
+    {
+        throw std::length_error("Seek position too large");
+    }
+
+    auto const result = lfs1_file_seek(
+        _filesystem, &_file, static_cast<lfs1_soff_t>(position), LFS1_SEEK_SET);
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs1_file_seek");
+    }
+}
+
+void LittleFile1::close()
+{
+    if (!_open)
+    {
+        return;
+    }
+
+    // littlefs releases the file even when the final commit fails
+    _open = false;
+    auto const result = lfs1_file_close(_filesystem, &_file);
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs1_file_close");
+    }
+}
+
 std::size_t LittleFile1::size() const
 {
     auto const file_size = lfs1_file_size(_filesystem, &_file);
@@ -84,3 +115,9 @@ std::size_t LittleFile1::position() const
 
     return static_cast<std::size_t>(file_position);
 }
+
+LittleFile::Layout LittleFile1::layout() const
+{
+    // littlefs v1 has no inline files
+    return {false, _file.head, _file.size};
+}
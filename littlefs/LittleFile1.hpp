@@ -28,7 +28,10 @@ class LittleFile1 : public LittleFile
 
     std::size_t read(gsl::span<std::byte> buffer) override;
     std::size_t write(gsl::span<std::byte const> buffer) override;
+    void seek(std::size_t position) override;
+    void close() override;
 
     [[nodiscard]] std::size_t size() const override;
     [[nodiscard]] std::size_t position() const override;
+    [[nodiscard]] Layout layout() const override;
 };
@@ -63,6 +63,37 @@ std::size_t LittleFile2::write(gsl::span<std::byte const> buffer)
     return static_cast<std::size_t>(read);
 }
 
+void LittleFile2::seek(std::size_t const position)
+{
+    if (position > static_cast<std::size_t>(std::numeric_limits<lfs2_soff_t>::max()))
+    {
+        throw std::length_error("Seek position too large");
+    }
+
+    auto const result = lfs2_file_seek(
+        _filesystem, &_file, static_cast<lfs2_soff_t>(position), LFS2_SEEK_SET);
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_file_seek");
+    }
+}
+
+void LittleFile2::close()
+{
+    if (!_open)
+    {
+        return;
+    }
+
+    // littlefs releases the file even when the final commit fails
+    _open = false;
+    auto const result = lfs2_file_close(_filesystem, &_file);
+    if (result < 0)
+    {
+        throw std::system_error(result, littlefs_category(), "lfs2_file_close");
+    }
+}
+
 std::size_t LittleFile2::size() const
 {
     auto const file_size = lfs2_file_size(_filesystem, &_file);
@@ -84,3 +115,8 @@ std::size_t LittleFile2::position() const
 
     return static_cast<std::size_t>(file_position);
 }
+
+LittleFile::Layout LittleFile2::layout() const
+{
+    return {0 != (_file.flags & LFS2_F_INLINE), _file.ctz.head, _file.ctz.size};
+}
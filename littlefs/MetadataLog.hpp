@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+
+// What a raw metadata block holds: its revision count and the commits with a
+// valid CRC, in order from the start of the block.
+struct MetadataLog
+{
+    std::uint32_t revision {};
+    std::uint32_t commits {};
+    // Bytes from the start of the block up to the end of the last valid commit
+    std::uint32_t size {};
+};